@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "bcl.h"
+
+/* Largest prime smaller than 65536 */
+#define ADLER_MODULO            65521
+/* Largest number of bytes before the sums have to be reduced */
+#define ADLER_BLOCK_SIZE        5552
+
+static uint32_t
+_be32_read(const uint8_t *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+int32_t
+bcl_header_parse(const void *in, bcl_header_t *header)
+{
+        const uint8_t * const p = in;
+
+        header->magic = _be32_read(&p[0]);
+        header->codec = p[4];
+        header->param = p[5];
+        header->reserved = (p[6] << 8) | p[7];
+        header->compressed_size = _be32_read(&p[8]);
+        header->uncompressed_size = _be32_read(&p[12]);
+        header->checksum = _be32_read(&p[16]);
+
+        if (header->magic != BCL_HEADER_MAGIC) {
+                return -1;
+        }
+
+        if (header->codec >= BCL_CODEC_COUNT) {
+                return -1;
+        }
+
+        return 0;
+}
+
+uint32_t
+bcl_checksum(const void *in, uint32_t size)
+{
+        const uint8_t *p = in;
+
+        uint32_t a;
+        uint32_t b;
+
+        a = 1;
+        b = 0;
+
+        while (size > 0) {
+                uint32_t block_size;
+                block_size = (size < ADLER_BLOCK_SIZE) ? size : ADLER_BLOCK_SIZE;
+
+                size -= block_size;
+
+                for (; block_size > 0; block_size--) {
+                        a += *p++;
+                        b += a;
+                }
+
+                a %= ADLER_MODULO;
+                b %= ADLER_MODULO;
+        }
+
+        return (b << 16) | a;
+}
+
+int32_t
+bcl_uncompress(const void *in, void *out, uint32_t out_size)
+{
+        bcl_header_t header;
+
+        if ((bcl_header_parse(in, &header)) < 0) {
+                return -1;
+        }
+
+        if (header.uncompressed_size > out_size) {
+                return -1;
+        }
+
+        uint8_t * const data = (uint8_t *)in + BCL_HEADER_SIZE;
+
+        switch (header.codec) {
+        case BCL_CODEC_NONE:
+                (void)memcpy(out, data, header.uncompressed_size);
+                break;
+        case BCL_CODEC_HUFFMAN:
+                Huffman_Uncompress(data, out, header.compressed_size,
+                    header.uncompressed_size);
+                break;
+        case BCL_CODEC_LZ:
+                LZ_Uncompress(data, out, header.compressed_size);
+                break;
+        case BCL_CODEC_LZB:
+                if ((lzb_decompress(data, header.compressed_size, out,
+                            header.uncompressed_size)) < 0) {
+                        return -1;
+                }
+                break;
+        case BCL_CODEC_PRS:
+                if ((prs_decompress_bounded(data, header.compressed_size, out,
+                            header.uncompressed_size)) < 0) {
+                        return -1;
+                }
+                break;
+        case BCL_CODEC_RICE:
+                Rice_Uncompress(data, out, header.compressed_size,
+                    header.uncompressed_size, header.param);
+                break;
+        case BCL_CODEC_RLE:
+                RLE_Uncompress(data, out, header.compressed_size);
+                break;
+        case BCL_CODEC_SF:
+                SF_Uncompress(data, out, header.compressed_size,
+                    header.uncompressed_size);
+                break;
+        }
+
+        return header.uncompressed_size;
+}
@@ -9,12 +9,93 @@
 #define BCL_H_
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
-uint32_t prs_decompress_size(void *);
+/* Header written by the bcl tool, stored in big-endian */
+#define BCL_HEADER_MAGIC        0x42434C31 /* "BCL1" */
+#define BCL_HEADER_SIZE         20
+
+#define BCL_CODEC_NONE          0
+#define BCL_CODEC_HUFFMAN       1
+#define BCL_CODEC_LZ            2
+#define BCL_CODEC_PRS           3
+#define BCL_CODEC_RICE          4
+#define BCL_CODEC_RLE           5
+#define BCL_CODEC_SF            6
+#define BCL_CODEC_LZB           7
+#define BCL_CODEC_COUNT         8
+
+typedef struct bcl_header {
+        uint32_t magic;
+        uint8_t codec;
+        /* Codec specific parameter (Rice format) */
+        uint8_t param;
+        uint16_t reserved;
+        uint32_t compressed_size;
+        uint32_t uncompressed_size;
+        /* Adler-32 of the uncompressed data */
+        uint32_t checksum;
+} bcl_header_t;
+
+/* State of an incremental decoder. The fields are private */
+typedef struct bcl_stream {
+        uint8_t codec;
+        uint8_t state;
+        uint8_t next_state;
+        uint8_t marker;
+        uint8_t token;
+        uint32_t control;
+        uint32_t value;
+        uint32_t count;
+        uint32_t distance;
+        uint8_t *window;
+        uint32_t window_mask;
+        uint32_t in_total;
+        uint32_t in_size;
+        uint32_t out_total;
+        uint32_t out_read;
+        uint32_t out_size;
+} bcl_stream_t;
+
+int32_t bcl_header_parse(const void *, bcl_header_t *);
+uint32_t bcl_checksum(const void *, uint32_t);
+int32_t bcl_uncompress(const void *, void *, uint32_t);
+
+/*
+ * Incremental decompression of the data that follows a header. Only the
+ * none, LZ, LZB, PRS and RLE codecs are supported.
+ *
+ * The window is a ring buffer (its size a power of 2) that receives the
+ * decoded bytes. It must be at least as large as the largest match
+ * distance in the data: 8 KiB for PRS, 64 KiB for LZB and 128 KiB for LZ,
+ * whose matches reach up to 100000 bytes back. bcl_stream_init() rejects
+ * smaller windows, unless the window holds all of the uncompressed data.
+ *
+ * bcl_stream_decompress() returns the number of bytes it consumed out of
+ * the chunk, or -1 if the data is corrupt. It stops early when the window
+ * is full, in which case the output has to be consumed with
+ * bcl_stream_output_get() and bcl_stream_output_consume(), and the rest
+ * of the chunk passed in again.
+ */
+#define BCL_STREAM_WINDOW_SIZE_PRS      (8192)
+#define BCL_STREAM_WINDOW_SIZE_LZB      (65536)
+#define BCL_STREAM_WINDOW_SIZE_LZ       (131072)
+
+bool bcl_stream_codec_supported(uint8_t);
+int32_t bcl_stream_init(bcl_stream_t *, const bcl_header_t *, void *, uint32_t);
+int32_t bcl_stream_decompress(bcl_stream_t *, const void *, uint32_t);
+bool bcl_stream_done(const bcl_stream_t *);
+uint32_t bcl_stream_output_get(const bcl_stream_t *, const void **);
+void bcl_stream_output_consume(bcl_stream_t *, uint32_t);
+
+int32_t lzb_decompress(const void *, uint32_t, void *, uint32_t);
+uint32_t prs_decompress(const void *, void *);
+int32_t prs_decompress_bounded(const void *, uint32_t, void *, uint32_t);
+uint32_t prs_decompress_size(const void *);
 void Huffman_Uncompress(uint8_t *, uint8_t *, uint32_t, uint32_t);
 void LZ_Uncompress(uint8_t *, uint8_t *, uint32_t);
 void RLE_Uncompress(uint8_t *, uint8_t *, uint32_t);
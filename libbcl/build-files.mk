@@ -1,11 +1,18 @@
 # -*- mode: makefile -*-
 
-LIB_SRCS:= huffman.c \
+LIB_SRCS:= bcl.c \
+	huffman.c \
 	lz.c \
+	lzb.c \
 	prs.c \
 	rice.c \
 	rle.c \
-	shannonfano.c
+	romdisk.c \
+	shannonfano.c \
+	stream.c \
+	vram.c
 
 INSTALL_HEADER_FILES:= \
-	./:bcl.h:./bcl/
+	./:bcl.h:./bcl/ \
+	./:romdisk.h:./bcl/ \
+	./:vram.h:./bcl/
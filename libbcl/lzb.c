@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <cpu/instructions.h>
+
+#include "bcl.h"
+
+/*
+ * LZB is a byte-aligned LZ77 codec in the spirit of LZ4. There are no bit
+ * fields to extract, so decoding is a few byte loads followed by block
+ * copies.
+ *
+ * The stream is a sequence of:
+ *
+ *   token      Literal count (upper nibble), match length minus 4 (lower
+ *              nibble)
+ *   [count]    If the literal count is 15, bytes are added to it until a
+ *              byte other than 255 is read
+ *   literals
+ *   offset     Distance of the match, two bytes (big-endian), 1..65535
+ *   [length]   If the match length is 15, extended like the literal count
+ *
+ * The last sequence has no match, and ends the stream.
+ *
+ * Matches whose distance is a multiple of 4 are copied 32 bits at a time,
+ * so the encoder prefers them. Matches whose distance is off by 2 are also
+ * copied 32 bits at a time, by extracting each long out of two aligned ones.
+ */
+
+#define LZB_MATCH_LENGTH_MIN    4
+#define LZB_NIBBLE_MAX          15
+
+#define SOURCE_CHECK(n) do {                                                   \
+        if (__predict_false((size_t)(src_end - src) < (size_t)(n))) {          \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define DEST_CHECK(n) do {                                                     \
+        if (__predict_false((size_t)(dst_end - dst) < (size_t)(n))) {          \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define LENGTH_EXTEND(length) do {                                             \
+        if ((length) == LZB_NIBBLE_MAX) {                                      \
+                uint32_t byte;                                                 \
+                                                                               \
+                do {                                                           \
+                        SOURCE_CHECK(1);                                       \
+                        byte = *src++;                                         \
+                        (length) += byte;                                      \
+                } while (byte == 0xFF);                                        \
+        }                                                                      \
+} while (false)
+
+static inline void __always_inline
+_literals_copy(uint8_t *dst, const uint8_t *src, uint32_t count)
+{
+        if (count >= 16) {
+                (void)memcpy(dst, src, count);
+
+                return;
+        }
+
+        for (; count > 0; count--) {
+                *dst++ = *src++;
+        }
+}
+
+static inline void __always_inline
+_match_copy(uint8_t *dst, uint32_t distance, uint32_t size)
+{
+        const uint8_t *ref = dst - distance;
+
+        if (distance == 1) {
+                /* Run of a single byte */
+                (void)memset(dst, *ref, size);
+
+                return;
+        }
+
+        if ((distance >= size) && (size >= 16)) {
+                (void)memcpy(dst, ref, size);
+
+                return;
+        }
+
+        if (distance >= 4) {
+                if ((distance & 0x03) == 0) {
+                        /* Both pointers share the same alignment */
+                        for (; (((uintptr_t)dst & 0x03) != 0) && (size > 0); size--) {
+                                *dst++ = *ref++;
+                        }
+
+                        uint32_t *dst_32 = (uint32_t *)dst;
+                        const uint32_t *ref_32 = (const uint32_t *)ref;
+
+                        /* Each long only reads bytes that were written before
+                         * it, so this is safe even when overlapping */
+                        for (; size >= 4; size -= 4) {
+                                *dst_32++ = *ref_32++;
+                        }
+
+                        dst = (uint8_t *)dst_32;
+                        ref = (const uint8_t *)ref_32;
+                } else if ((distance & 0x03) == 2) {
+                        for (; (((uintptr_t)dst & 0x03) != 0) && (size > 0); size--) {
+                                *dst++ = *ref++;
+                        }
+
+                        if (size >= 4) {
+                                /* The reference is now 2 bytes past a long
+                                 * boundary. The first aligned long may start
+                                 * before the destination buffer, but within
+                                 * the same long, and those bytes are
+                                 * discarded */
+                                uint32_t *dst_32 = (uint32_t *)dst;
+                                const uint32_t *ref_32 =
+                                    (const uint32_t *)(ref - 2);
+
+                                uint32_t hi;
+                                hi = *ref_32++;
+
+                                /* The distance is at least 6, so each aligned
+                                 * long read ahead was written before */
+                                for (; size >= 4; size -= 4) {
+                                        const uint32_t lo = *ref_32++;
+
+                                        *dst_32++ = cpu_instr_xtrct(hi, lo);
+
+                                        hi = lo;
+                                }
+
+                                ref += (uint8_t *)dst_32 - dst;
+                                dst = (uint8_t *)dst_32;
+                        }
+                } else {
+                        for (; size >= 4; size -= 4) {
+                                dst[0] = ref[0];
+                                dst[1] = ref[1];
+                                dst[2] = ref[2];
+                                dst[3] = ref[3];
+
+                                dst += 4;
+                                ref += 4;
+                        }
+                }
+        }
+
+        for (; size > 0; size--) {
+                *dst++ = *ref++;
+        }
+}
+
+int32_t
+lzb_decompress(const void *source, uint32_t source_size, void *dest,
+    uint32_t dest_size)
+{
+        const uint8_t *src = source;
+        const uint8_t * const src_end = &src[source_size];
+        uint8_t *dst = dest;
+        uint8_t * const dst_start = dst;
+        const uint8_t * const dst_end = &dst[dest_size];
+
+        for (;;) {
+                SOURCE_CHECK(1);
+
+                const uint32_t token = *src++;
+
+                uint32_t count;
+                count = token >> 4;
+
+                LENGTH_EXTEND(count);
+
+                SOURCE_CHECK(count);
+                DEST_CHECK(count);
+
+                _literals_copy(dst, src, count);
+
+                src += count;
+                dst += count;
+
+                if (src == src_end) {
+                        return (dst - dst_start);
+                }
+
+                SOURCE_CHECK(2);
+
+                const uint32_t distance = (src[0] << 8) | src[1];
+
+                src += 2;
+
+                if ((distance == 0) || ((uint32_t)(dst - dst_start) < distance)) {
+                        return -1;
+                }
+
+                uint32_t length;
+                length = token & LZB_NIBBLE_MAX;
+
+                LENGTH_EXTEND(length);
+
+                length += LZB_MATCH_LENGTH_MIN;
+
+                DEST_CHECK(length);
+
+                _match_copy(dst, distance, length);
+
+                dst += length;
+        }
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include <fs/romdisk/romdisk.h>
+
+#include "bcl.h"
+#include "romdisk.h"
+
+struct romdisk_stream {
+        bcl_stream_t stream;
+        const uint8_t *src;
+        uint32_t src_left;
+        uint8_t window[];
+};
+
+static uint32_t _window_size_get(uint8_t);
+
+static ssize_t _size_get(const void *, size_t);
+static ssize_t _decompress(const void *, void *, size_t);
+static void *_stream_open(const void *, size_t);
+static ssize_t _stream_read(void *, void *, size_t);
+static void _stream_close(void *);
+
+static const romdisk_decompressor_t _decompressor = {
+        .size_get = _size_get,
+        .decompress = _decompress,
+        .stream_open = _stream_open,
+        .stream_read = _stream_read,
+        .stream_close = _stream_close
+};
+
+void
+bcl_romdisk_init(void)
+{
+        romdisk_decompressor_set(&_decompressor);
+}
+
+/* Size of the window needed to decode each codec incrementally, or zero if
+ * it can't be */
+static uint32_t
+_window_size_get(uint8_t codec)
+{
+        switch (codec) {
+        case BCL_CODEC_NONE:
+        case BCL_CODEC_RLE:
+                return 4096;
+        case BCL_CODEC_PRS:
+                return BCL_STREAM_WINDOW_SIZE_PRS;
+        case BCL_CODEC_LZB:
+                return BCL_STREAM_WINDOW_SIZE_LZB;
+        default:
+                /* LZ can reference data further back than is worth
+                 * keeping around */
+                return 0;
+        }
+}
+
+static ssize_t
+_size_get(const void *data, size_t size)
+{
+        bcl_header_t header;
+
+        if (size < BCL_HEADER_SIZE) {
+                return -1;
+        }
+
+        if ((bcl_header_parse(data, &header)) < 0) {
+                return -1;
+        }
+
+        if (header.compressed_size > (size - BCL_HEADER_SIZE)) {
+                return -1;
+        }
+
+        return header.uncompressed_size;
+}
+
+static ssize_t
+_decompress(const void *data, void *buffer, size_t size)
+{
+        return bcl_uncompress(data, buffer, size);
+}
+
+static void *
+_stream_open(const void *data, size_t size __unused)
+{
+        bcl_header_t header;
+
+        if ((bcl_header_parse(data, &header)) < 0) {
+                return NULL;
+        }
+
+        const uint32_t window_size = _window_size_get(header.codec);
+
+        /* Unless the file is larger than the window, it's as cheap to decode
+         * all of it */
+        if ((window_size == 0) || (window_size >= header.uncompressed_size)) {
+                return NULL;
+        }
+
+        struct romdisk_stream * const s =
+            malloc(sizeof(struct romdisk_stream) + window_size);
+
+        if (s == NULL) {
+                return NULL;
+        }
+
+        if ((bcl_stream_init(&s->stream, &header, s->window, window_size)) < 0) {
+                free(s);
+
+                return NULL;
+        }
+
+        s->src = (const uint8_t *)data + BCL_HEADER_SIZE;
+        s->src_left = header.compressed_size;
+
+        return s;
+}
+
+static ssize_t
+_stream_read(void *p, void *buffer, size_t size)
+{
+        struct romdisk_stream * const s = p;
+
+        uint8_t * const dst = buffer;
+
+        size_t count;
+        count = 0;
+
+        while (count < size) {
+                const void *out;
+                uint32_t out_size;
+                out_size = bcl_stream_output_get(&s->stream, &out);
+
+                if (out_size > 0) {
+                        if (out_size > (size - count)) {
+                                out_size = size - count;
+                        }
+
+                        (void)memcpy(&dst[count], out, out_size);
+
+                        bcl_stream_output_consume(&s->stream, out_size);
+
+                        count += out_size;
+
+                        continue;
+                }
+
+                if (bcl_stream_done(&s->stream)) {
+                        break;
+                }
+
+                const int32_t used =
+                    bcl_stream_decompress(&s->stream, s->src, s->src_left);
+
+                if (used < 0) {
+                        return -1;
+                }
+
+                s->src += used;
+                s->src_left -= used;
+
+                /* The window is empty, so nothing being decoded means the
+                 * data is truncated */
+                if ((s->stream.out_total == s->stream.out_read) &&
+                    !bcl_stream_done(&s->stream)) {
+                        return -1;
+                }
+        }
+
+        return count;
+}
+
+static void
+_stream_close(void *p)
+{
+        free(p);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef BCL_ROMDISK_H_
+#define BCL_ROMDISK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Let the romdisk open files that genromfs compressed (see its -c option).
+ *
+ * Files compressed with a codec that can be decoded incrementally, and that
+ * are larger than the window the codec needs, are decoded as they're read
+ * in order. The rest are decoded when they're opened.
+ */
+void bcl_romdisk_init(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* BCL_ROMDISK_H_ */
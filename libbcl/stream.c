@@ -0,0 +1,828 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/cdefs.h>
+
+#include "bcl.h"
+
+/*
+ * Incremental decoders. The compressed data may be passed in chunks of
+ * any size, and the decoders stop wherever a chunk ends, or when the
+ * window is full. All state is kept in bcl_stream_t.
+ *
+ * Decoded bytes go into the window, a ring buffer supplied by the caller.
+ * Bytes handed back to the caller stay in the window until they are
+ * overwritten, so they double as the history that matches copy from.
+ *
+ * Each state reads at most one byte of input before moving on to the
+ * next, so there is never a partially read field to save.
+ */
+
+enum {
+        STATE_DONE,
+
+        /* None */
+        STATE_NONE_LITERALS,
+
+        /* LZ and RLE */
+        STATE_MARKER_GET,
+        STATE_SYMBOL,
+        STATE_MARKER,
+        STATE_LZ_LENGTH,
+        STATE_LZ_OFFSET,
+        STATE_RLE_COUNT,
+        STATE_RLE_SYMBOL,
+
+        /* LZB */
+        STATE_LZB_TOKEN,
+        STATE_LZB_LITERAL_COUNT,
+        STATE_LZB_LITERALS,
+        STATE_LZB_DISTANCE_HI,
+        STATE_LZB_DISTANCE_LO,
+        STATE_LZB_MATCH_LENGTH,
+
+        /* PRS */
+        STATE_PRS_FLAG,
+        STATE_PRS_LITERAL,
+        STATE_PRS_TYPE,
+        STATE_PRS_SHORT_SIZE_HI,
+        STATE_PRS_SHORT_SIZE_LO,
+        STATE_PRS_SHORT_OFFSET,
+        STATE_PRS_LONG_LO,
+        STATE_PRS_LONG_HI,
+        STATE_PRS_LONG_SIZE,
+
+        /* Copy of stream->count bytes from stream->distance bytes back, then
+         * on to stream->next_state */
+        STATE_MATCH
+};
+
+#define CONTROL_GUARD           (0x100)
+#define CONTROL_EMPTY           (0x001)
+
+#define LZB_MATCH_LENGTH_MIN    4
+#define LZB_NIBBLE_MAX          15
+
+#define BYTE_GET(byte) do {                                                    \
+        if (src == src_end) {                                                  \
+                goto suspend;                                                  \
+        }                                                                      \
+        (byte) = *src++;                                                       \
+} while (false)
+
+#define CONTROL_BIT_GET(bit) do {                                              \
+        if (stream->control == CONTROL_EMPTY) {                                \
+                uint32_t control_byte;                                         \
+                BYTE_GET(control_byte);                                        \
+                stream->control = control_byte | CONTROL_GUARD;                \
+        }                                                                      \
+        (bit) = stream->control & 0x01;                                        \
+        stream->control >>= 1;                                                 \
+} while (false)
+
+/* Make sure there is room in the window for one byte */
+#define WINDOW_CHECK() do {                                                    \
+        if ((_window_free(stream)) == 0) {                                     \
+                goto suspend;                                                  \
+        }                                                                      \
+} while (false)
+
+#define OUTPUT_CHECK(n) do {                                                   \
+        if ((stream->out_size - stream->out_total) < (uint32_t)(n)) {          \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+static inline uint32_t __always_inline
+_window_free(const bcl_stream_t *stream)
+{
+        return (stream->window_mask + 1) - (stream->out_total - stream->out_read);
+}
+
+static inline void __always_inline
+_window_byte_put(bcl_stream_t *stream, uint8_t byte)
+{
+        stream->window[stream->out_total & stream->window_mask] = byte;
+        stream->out_total++;
+}
+
+static void
+_window_literals_put(bcl_stream_t *stream, const uint8_t *src, uint32_t count)
+{
+        while (count > 0) {
+                const uint32_t offset = stream->out_total & stream->window_mask;
+
+                uint32_t span;
+                span = (stream->window_mask + 1) - offset;
+
+                if (span > count) {
+                        span = count;
+                }
+
+                (void)memcpy(&stream->window[offset], src, span);
+
+                src += span;
+                count -= span;
+                stream->out_total += span;
+        }
+}
+
+static void
+_window_match_put(bcl_stream_t *stream, uint32_t count)
+{
+        const uint32_t window_size = stream->window_mask + 1;
+
+        while (count > 0) {
+                const uint32_t dst_offset = stream->out_total & stream->window_mask;
+                const uint32_t ref_offset =
+                    (stream->out_total - stream->distance) & stream->window_mask;
+
+                /* Neither pointer may wrap around within a span */
+                uint32_t span;
+                span = window_size - dst_offset;
+
+                if (span > (window_size - ref_offset)) {
+                        span = window_size - ref_offset;
+                }
+
+                if (span > count) {
+                        span = count;
+                }
+
+                uint8_t *dst = &stream->window[dst_offset];
+                const uint8_t *ref = &stream->window[ref_offset];
+
+                count -= span;
+                stream->out_total += span;
+
+                if (((dst_offset + span) <= ref_offset) ||
+                    ((ref_offset + span) <= dst_offset)) {
+                        (void)memcpy(dst, ref, span);
+
+                        continue;
+                }
+
+                /* Byte by byte, as the span may copy bytes it just wrote */
+                for (; span > 0; span--) {
+                        *dst++ = *ref++;
+                }
+        }
+}
+
+static int32_t
+_match_start(bcl_stream_t *stream, uint32_t next_state)
+{
+        if ((stream->count == 0) ||
+            (stream->distance == 0) ||
+            (stream->distance > stream->out_total) ||
+            (stream->distance > (stream->window_mask + 1))) {
+                return -1;
+        }
+
+        OUTPUT_CHECK(stream->count);
+
+        stream->state = STATE_MATCH;
+        stream->next_state = next_state;
+
+        return 0;
+}
+
+static int32_t
+_match_continue(bcl_stream_t *stream)
+{
+        uint32_t count;
+        count = _window_free(stream);
+
+        if (count > stream->count) {
+                count = stream->count;
+        }
+
+        _window_match_put(stream, count);
+
+        stream->count -= count;
+
+        if (stream->count == 0) {
+                stream->state = stream->next_state;
+        }
+
+        return count;
+}
+
+static int32_t
+_none_decode(bcl_stream_t *stream, const uint8_t **src_p,
+    const uint8_t *src_end, bool last __unused)
+{
+        const uint8_t *src = *src_p;
+
+        uint32_t count;
+        count = src_end - src;
+
+        if (count > stream->count) {
+                count = stream->count;
+        }
+
+        if (count > _window_free(stream)) {
+                count = _window_free(stream);
+        }
+
+        _window_literals_put(stream, src, count);
+
+        src += count;
+        stream->count -= count;
+
+        if (stream->count == 0) {
+                stream->state = STATE_DONE;
+        }
+
+        *src_p = src;
+
+        return 0;
+}
+
+static int32_t
+_lz_decode(bcl_stream_t *stream, const uint8_t **src_p,
+    const uint8_t *src_end, bool last)
+{
+        const uint8_t *src = *src_p;
+
+        uint32_t byte;
+
+        for (;;) {
+                switch (stream->state) {
+                case STATE_MARKER_GET:
+                        if ((src == src_end) && last) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        BYTE_GET(stream->marker);
+                        stream->state = STATE_SYMBOL;
+                        break;
+                case STATE_SYMBOL:
+                        if ((src == src_end) && last) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        WINDOW_CHECK();
+                        BYTE_GET(byte);
+
+                        if (byte == stream->marker) {
+                                stream->state = STATE_MARKER;
+                                break;
+                        }
+
+                        OUTPUT_CHECK(1);
+                        _window_byte_put(stream, byte);
+                        break;
+                case STATE_MARKER:
+                        BYTE_GET(byte);
+
+                        if (byte == 0) {
+                                /* Single occurrence of the marker byte */
+                                OUTPUT_CHECK(1);
+                                _window_byte_put(stream, stream->marker);
+
+                                stream->state = STATE_SYMBOL;
+                                break;
+                        }
+
+                        /* First byte of the length */
+                        stream->value = byte & 0x7F;
+                        stream->state = STATE_LZ_LENGTH;
+
+                        if ((byte & 0x80) == 0) {
+                                stream->count = stream->value;
+                                stream->value = 0;
+                                stream->state = STATE_LZ_OFFSET;
+                        }
+                        break;
+                case STATE_LZ_LENGTH:
+                        BYTE_GET(byte);
+
+                        stream->value = (stream->value << 7) | (byte & 0x7F);
+
+                        if ((byte & 0x80) == 0) {
+                                stream->count = stream->value;
+                                stream->value = 0;
+                                stream->state = STATE_LZ_OFFSET;
+                        }
+                        break;
+                case STATE_LZ_OFFSET:
+                        BYTE_GET(byte);
+
+                        stream->value = (stream->value << 7) | (byte & 0x7F);
+
+                        if ((byte & 0x80) == 0) {
+                                stream->distance = stream->value;
+
+                                if ((_match_start(stream, STATE_SYMBOL)) < 0) {
+                                        return -1;
+                                }
+                        }
+                        break;
+                case STATE_MATCH:
+                        if ((_match_continue(stream)) == 0) {
+                                goto suspend;
+                        }
+                        break;
+                default:
+                        goto suspend;
+                }
+        }
+
+suspend:
+        *src_p = src;
+
+        return 0;
+}
+
+static int32_t
+_rle_decode(bcl_stream_t *stream, const uint8_t **src_p,
+    const uint8_t *src_end, bool last)
+{
+        const uint8_t *src = *src_p;
+
+        uint32_t byte;
+
+        for (;;) {
+                switch (stream->state) {
+                case STATE_MARKER_GET:
+                        if ((src == src_end) && last) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        BYTE_GET(stream->marker);
+                        stream->state = STATE_SYMBOL;
+                        break;
+                case STATE_SYMBOL:
+                        if ((src == src_end) && last) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        WINDOW_CHECK();
+                        BYTE_GET(byte);
+
+                        if (byte == stream->marker) {
+                                stream->state = STATE_MARKER;
+                                break;
+                        }
+
+                        OUTPUT_CHECK(1);
+                        _window_byte_put(stream, byte);
+                        break;
+                case STATE_MARKER:
+                        BYTE_GET(byte);
+
+                        if (byte <= 2) {
+                                /* Counts 0, 1 and 2 are used for marker byte
+                                 * repetition only */
+                                OUTPUT_CHECK(1);
+                                _window_byte_put(stream, stream->marker);
+
+                                stream->count = byte;
+                                stream->distance = 1;
+                                stream->state = STATE_SYMBOL;
+
+                                if ((byte > 0) &&
+                                    ((_match_start(stream, STATE_SYMBOL)) < 0)) {
+                                        return -1;
+                                }
+                                break;
+                        }
+
+                        stream->count = byte;
+                        stream->state = STATE_RLE_SYMBOL;
+
+                        if ((byte & 0x80) != 0) {
+                                stream->count = (byte & 0x7F) << 8;
+                                stream->state = STATE_RLE_COUNT;
+                        }
+                        break;
+                case STATE_RLE_COUNT:
+                        BYTE_GET(byte);
+
+                        stream->count += byte;
+                        stream->state = STATE_RLE_SYMBOL;
+                        break;
+                case STATE_RLE_SYMBOL:
+                        BYTE_GET(byte);
+
+                        /* The run is the symbol, then a copy of the previous
+                         * byte */
+                        OUTPUT_CHECK(1);
+                        _window_byte_put(stream, byte);
+
+                        stream->distance = 1;
+
+                        if ((_match_start(stream, STATE_SYMBOL)) < 0) {
+                                return -1;
+                        }
+                        break;
+                case STATE_MATCH:
+                        if ((_match_continue(stream)) == 0) {
+                                goto suspend;
+                        }
+                        break;
+                default:
+                        goto suspend;
+                }
+        }
+
+suspend:
+        *src_p = src;
+
+        return 0;
+}
+
+static int32_t
+_lzb_decode(bcl_stream_t *stream, const uint8_t **src_p,
+    const uint8_t *src_end, bool last)
+{
+        const uint8_t *src = *src_p;
+
+        uint32_t byte;
+
+        for (;;) {
+                switch (stream->state) {
+                case STATE_LZB_TOKEN:
+                        BYTE_GET(stream->token);
+
+                        stream->count = stream->token >> 4;
+                        stream->state = STATE_LZB_LITERALS;
+
+                        if (stream->count == LZB_NIBBLE_MAX) {
+                                stream->state = STATE_LZB_LITERAL_COUNT;
+                        }
+                        break;
+                case STATE_LZB_LITERAL_COUNT:
+                        BYTE_GET(byte);
+
+                        stream->count += byte;
+
+                        if (byte != 0xFF) {
+                                stream->state = STATE_LZB_LITERALS;
+                        }
+                        break;
+                case STATE_LZB_LITERALS:
+                        if (stream->count > 0) {
+                                OUTPUT_CHECK(stream->count);
+
+                                uint32_t count;
+                                count = src_end - src;
+
+                                if (count > stream->count) {
+                                        count = stream->count;
+                                }
+
+                                if (count > _window_free(stream)) {
+                                        count = _window_free(stream);
+                                }
+
+                                if (count == 0) {
+                                        goto suspend;
+                                }
+
+                                _window_literals_put(stream, src, count);
+
+                                src += count;
+                                stream->count -= count;
+
+                                break;
+                        }
+
+                        /* The last sequence has no match */
+                        if ((src == src_end) && last) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        stream->state = STATE_LZB_DISTANCE_HI;
+                        break;
+                case STATE_LZB_DISTANCE_HI:
+                        BYTE_GET(byte);
+
+                        stream->distance = byte << 8;
+                        stream->state = STATE_LZB_DISTANCE_LO;
+                        break;
+                case STATE_LZB_DISTANCE_LO:
+                        BYTE_GET(byte);
+
+                        stream->distance |= byte;
+                        stream->count = stream->token & LZB_NIBBLE_MAX;
+
+                        if (stream->count == LZB_NIBBLE_MAX) {
+                                stream->state = STATE_LZB_MATCH_LENGTH;
+                                break;
+                        }
+
+                        stream->count += LZB_MATCH_LENGTH_MIN;
+
+                        if ((_match_start(stream, STATE_LZB_TOKEN)) < 0) {
+                                return -1;
+                        }
+                        break;
+                case STATE_LZB_MATCH_LENGTH:
+                        BYTE_GET(byte);
+
+                        stream->count += byte;
+
+                        if (byte != 0xFF) {
+                                stream->count += LZB_MATCH_LENGTH_MIN;
+
+                                if ((_match_start(stream, STATE_LZB_TOKEN)) < 0) {
+                                        return -1;
+                                }
+                        }
+                        break;
+                case STATE_MATCH:
+                        if ((_match_continue(stream)) == 0) {
+                                goto suspend;
+                        }
+                        break;
+                default:
+                        goto suspend;
+                }
+        }
+
+suspend:
+        *src_p = src;
+
+        return 0;
+}
+
+static int32_t
+_prs_decode(bcl_stream_t *stream, const uint8_t **src_p,
+    const uint8_t *src_end, bool last __unused)
+{
+        const uint8_t *src = *src_p;
+
+        uint32_t bit;
+        uint32_t byte;
+
+        for (;;) {
+                switch (stream->state) {
+                case STATE_PRS_FLAG:
+                        CONTROL_BIT_GET(bit);
+
+                        stream->state = (bit != 0) ? STATE_PRS_LITERAL : STATE_PRS_TYPE;
+                        break;
+                case STATE_PRS_LITERAL:
+                        WINDOW_CHECK();
+                        BYTE_GET(byte);
+
+                        OUTPUT_CHECK(1);
+                        _window_byte_put(stream, byte);
+
+                        stream->state = STATE_PRS_FLAG;
+                        break;
+                case STATE_PRS_TYPE:
+                        CONTROL_BIT_GET(bit);
+
+                        stream->state = (bit != 0) ? STATE_PRS_LONG_LO : STATE_PRS_SHORT_SIZE_HI;
+                        break;
+                case STATE_PRS_SHORT_SIZE_HI:
+                        CONTROL_BIT_GET(bit);
+
+                        stream->count = bit << 1;
+                        stream->state = STATE_PRS_SHORT_SIZE_LO;
+                        break;
+                case STATE_PRS_SHORT_SIZE_LO:
+                        CONTROL_BIT_GET(bit);
+
+                        stream->count = (stream->count | bit) + 2;
+                        stream->state = STATE_PRS_SHORT_OFFSET;
+                        break;
+                case STATE_PRS_SHORT_OFFSET:
+                        BYTE_GET(byte);
+
+                        stream->distance = 0x100 - byte;
+
+                        if ((_match_start(stream, STATE_PRS_FLAG)) < 0) {
+                                return -1;
+                        }
+                        break;
+                case STATE_PRS_LONG_LO:
+                        BYTE_GET(stream->value);
+
+                        stream->state = STATE_PRS_LONG_HI;
+                        break;
+                case STATE_PRS_LONG_HI:
+                        BYTE_GET(byte);
+
+                        const uint32_t word = stream->value | (byte << 8);
+
+                        if (word == 0) {
+                                stream->state = STATE_DONE;
+                                goto suspend;
+                        }
+
+                        stream->distance = 0x2000 - (word >> 3);
+                        stream->count = stream->value & 0x07;
+
+                        if (stream->count == 0) {
+                                stream->state = STATE_PRS_LONG_SIZE;
+                                break;
+                        }
+
+                        stream->count += 2;
+
+                        if ((_match_start(stream, STATE_PRS_FLAG)) < 0) {
+                                return -1;
+                        }
+                        break;
+                case STATE_PRS_LONG_SIZE:
+                        BYTE_GET(byte);
+
+                        stream->count = byte + 1;
+
+                        if ((_match_start(stream, STATE_PRS_FLAG)) < 0) {
+                                return -1;
+                        }
+                        break;
+                case STATE_MATCH:
+                        if ((_match_continue(stream)) == 0) {
+                                goto suspend;
+                        }
+                        break;
+                default:
+                        goto suspend;
+                }
+        }
+
+suspend:
+        *src_p = src;
+
+        return 0;
+}
+
+bool
+bcl_stream_codec_supported(uint8_t codec)
+{
+        switch (codec) {
+        case BCL_CODEC_NONE:
+        case BCL_CODEC_LZ:
+        case BCL_CODEC_RLE:
+        case BCL_CODEC_LZB:
+        case BCL_CODEC_PRS:
+                return true;
+        default:
+                /* The entropy coders need all of their input at once */
+                return false;
+        }
+}
+
+int32_t
+bcl_stream_init(bcl_stream_t *stream, const bcl_header_t *header,
+    void *window, uint32_t window_size)
+{
+        /* The window size must be a power of 2 */
+        if ((window_size == 0) || ((window_size & (window_size - 1)) != 0)) {
+                return -1;
+        }
+
+        stream->codec = header->codec;
+        stream->marker = 0;
+        stream->token = 0;
+        stream->control = CONTROL_EMPTY;
+        stream->value = 0;
+        stream->count = 0;
+        stream->distance = 0;
+        stream->next_state = STATE_DONE;
+        stream->window = window;
+        stream->window_mask = window_size - 1;
+        stream->in_total = 0;
+        stream->in_size = header->compressed_size;
+        stream->out_total = 0;
+        stream->out_read = 0;
+        stream->out_size = header->uncompressed_size;
+
+        uint32_t window_size_min;
+        window_size_min = 0;
+
+        switch (header->codec) {
+        case BCL_CODEC_NONE:
+                stream->count = header->uncompressed_size;
+                stream->state = STATE_NONE_LITERALS;
+                break;
+        case BCL_CODEC_LZ:
+                window_size_min = BCL_STREAM_WINDOW_SIZE_LZ;
+                stream->state = STATE_MARKER_GET;
+                break;
+        case BCL_CODEC_RLE:
+                stream->state = STATE_MARKER_GET;
+                break;
+        case BCL_CODEC_LZB:
+                window_size_min = BCL_STREAM_WINDOW_SIZE_LZB;
+                stream->state = STATE_LZB_TOKEN;
+                break;
+        case BCL_CODEC_PRS:
+                window_size_min = BCL_STREAM_WINDOW_SIZE_PRS;
+                stream->state = STATE_PRS_FLAG;
+                break;
+        default:
+                /* The entropy coders need all of their input at once */
+                return -1;
+        }
+
+        /* Matches can't reach further back than the start of the data */
+        if ((window_size < window_size_min) &&
+            (window_size < header->uncompressed_size)) {
+                return -1;
+        }
+
+        return 0;
+}
+
+int32_t
+bcl_stream_decompress(bcl_stream_t *stream, const void *in, uint32_t in_size)
+{
+        const uint8_t *src = in;
+
+        /* Never read past the end of the compressed data */
+        const uint32_t in_left = stream->in_size - stream->in_total;
+
+        if (in_size > in_left) {
+                in_size = in_left;
+        }
+
+        const bool last = (in_size == in_left);
+
+        int32_t ret;
+
+        switch (stream->codec) {
+        case BCL_CODEC_NONE:
+                ret = _none_decode(stream, &src, &src[in_size], last);
+                break;
+        case BCL_CODEC_LZ:
+                ret = _lz_decode(stream, &src, &src[in_size], last);
+                break;
+        case BCL_CODEC_RLE:
+                ret = _rle_decode(stream, &src, &src[in_size], last);
+                break;
+        case BCL_CODEC_LZB:
+                ret = _lzb_decode(stream, &src, &src[in_size], last);
+                break;
+        case BCL_CODEC_PRS:
+                ret = _prs_decode(stream, &src, &src[in_size], last);
+                break;
+        default:
+                return -1;
+        }
+
+        if (ret < 0) {
+                return -1;
+        }
+
+        if ((stream->state == STATE_DONE) &&
+            (stream->out_total != stream->out_size)) {
+                return -1;
+        }
+
+        const uint32_t used = src - (const uint8_t *)in;
+
+        stream->in_total += used;
+
+        return used;
+}
+
+bool
+bcl_stream_done(const bcl_stream_t *stream)
+{
+        return (stream->state == STATE_DONE);
+}
+
+uint32_t
+bcl_stream_output_get(const bcl_stream_t *stream, const void **out)
+{
+        const uint32_t offset = stream->out_read & stream->window_mask;
+
+        uint32_t size;
+        size = stream->out_total - stream->out_read;
+
+        /* Only up to the end of the window */
+        if (size > ((stream->window_mask + 1) - offset)) {
+                size = (stream->window_mask + 1) - offset;
+        }
+
+        *out = &stream->window[offset];
+
+        return size;
+}
+
+void
+bcl_stream_output_consume(bcl_stream_t *stream, uint32_t size)
+{
+        stream->out_read += size;
+}
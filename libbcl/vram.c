@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <cpu/cache.h>
+
+#include <sys/dma-queue.h>
+
+#include "bcl.h"
+#include "vram.h"
+
+static void _dma_handler(const dma_queue_transfer_t *);
+static void _dma_enqueue(void *, const void *, uint32_t, volatile uint32_t *);
+
+static int32_t _buffer_decompress(const void *, const bcl_header_t *, void *);
+
+int32_t
+bcl_vram_decompress(const void *in, void *vram, void *staging,
+    uint32_t staging_size)
+{
+        assert(in != NULL);
+        assert(vram != NULL);
+        assert(staging != NULL);
+        assert((((uintptr_t)vram) & 0x03) == 0);
+        assert(staging_size >= 8);
+        assert((staging_size & (staging_size - 1)) == 0);
+
+        bcl_header_t header;
+
+        if ((bcl_header_parse(in, &header)) < 0) {
+                return -1;
+        }
+
+        assert((header.uncompressed_size & 0x03) == 0);
+
+        if (!(bcl_stream_codec_supported(header.codec))) {
+                return _buffer_decompress(in, &header, vram);
+        }
+
+        bcl_stream_t stream;
+
+        /* The staging buffer is too small for the match distances of the
+         * codec */
+        if ((bcl_stream_init(&stream, &header, staging, staging_size)) < 0) {
+                return -1;
+        }
+
+        const uint32_t half_size = staging_size >> 1;
+
+        const uint8_t *src = (const uint8_t *)in + BCL_HEADER_SIZE;
+
+        uint32_t src_left;
+        src_left = header.compressed_size;
+
+        uint8_t * const dst = vram;
+
+        /* Number of bytes handed to the DMA queue */
+        uint32_t out_queued;
+        out_queued = 0;
+
+        /* Number of halves transferred, updated from the DMA handler */
+        volatile uint32_t halves_complete;
+        halves_complete = 0;
+
+        int32_t ret;
+        ret = header.uncompressed_size;
+
+        while (true) {
+                /* Give back to the decoder the halves that are in VRAM */
+                uint32_t out_complete;
+                out_complete = halves_complete * half_size;
+
+                if (out_complete > stream.out_total) {
+                        out_complete = stream.out_total;
+                }
+
+                bcl_stream_output_consume(&stream, out_complete - stream.out_read);
+
+                const uint32_t out_total = stream.out_total;
+
+                const int32_t used = bcl_stream_decompress(&stream, src, src_left);
+
+                if (used < 0) {
+                        ret = -1;
+
+                        break;
+                }
+
+                /* Nothing was decoded, and not for lack of room: the data is
+                 * truncated */
+                if ((used == 0) && (stream.out_total == out_total) &&
+                    !bcl_stream_done(&stream) &&
+                    ((stream.out_total - stream.out_read) < staging_size)) {
+                        ret = -1;
+
+                        break;
+                }
+
+                src += used;
+                src_left -= used;
+
+                const bool done = bcl_stream_done(&stream);
+
+                /* Transfer every half that is full, and what is left of the
+                 * last one at the end */
+                while (((stream.out_total - out_queued) >= half_size) ||
+                    (done && (stream.out_total > out_queued))) {
+                        uint32_t size;
+                        size = stream.out_total - out_queued;
+
+                        if (size > half_size) {
+                                size = half_size;
+                        }
+
+                        const uint32_t offset = out_queued & stream.window_mask;
+
+                        _dma_enqueue(&dst[out_queued], &stream.window[offset],
+                            size, &halves_complete);
+
+                        out_queued += size;
+                }
+
+                if (done) {
+                        break;
+                }
+
+                if ((stream.out_total - stream.out_read) == staging_size) {
+                        /* Both halves are waiting on the DMA queue */
+                        dma_queue_flush_wait();
+                }
+        }
+
+        dma_queue_flush_wait();
+
+        return ret;
+}
+
+static void
+_dma_handler(const dma_queue_transfer_t *transfer)
+{
+        if ((transfer->status & DMA_QUEUE_STATUS_COMPLETE) == 0x00) {
+                return;
+        }
+
+        volatile uint32_t * const halves_complete = transfer->work;
+
+        (*halves_complete)++;
+}
+
+static void
+_dma_enqueue(void *dst, const void *src, uint32_t size,
+    volatile uint32_t *halves_complete)
+{
+        const scu_dma_level_cfg_t dma_cfg = {
+                .mode = SCU_DMA_MODE_DIRECT,
+                .xfer.direct.len = size,
+                .xfer.direct.dst = (uint32_t)dst,
+                .xfer.direct.src = CPU_CACHE_THROUGH | (uint32_t)src,
+                .stride = SCU_DMA_STRIDE_2_BYTES,
+                .update = SCU_DMA_UPDATE_NONE
+        };
+
+        scu_dma_handle_t handle;
+
+        scu_dma_config_buffer(&handle, &dma_cfg);
+
+        int8_t ret __unused;
+        ret = dma_queue_enqueue(&handle, DMA_QUEUE_TAG_IMMEDIATE, _dma_handler,
+            (void *)halves_complete);
+        assert(ret == 0);
+
+        /* Waits for the previous transfer to complete, then starts this one
+         * without waiting for it */
+        ret = dma_queue_flush(DMA_QUEUE_TAG_IMMEDIATE);
+        assert(ret >= 0);
+}
+
+static int32_t
+_buffer_decompress(const void *in, const bcl_header_t *header, void *vram)
+{
+        void * const buffer = malloc(header->uncompressed_size);
+        assert(buffer != NULL);
+
+        int32_t ret;
+        ret = bcl_uncompress(in, buffer, header->uncompressed_size);
+
+        if ((ret > 0) && (ret == (int32_t)header->uncompressed_size)) {
+                volatile uint32_t halves_complete;
+                halves_complete = 0;
+
+                _dma_enqueue(vram, buffer, header->uncompressed_size,
+                    &halves_complete);
+
+                dma_queue_flush_wait();
+        }
+
+        free(buffer);
+
+        return ret;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef BCL_VRAM_H_
+#define BCL_VRAM_H_
+
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * Decompress data (starting with its header) straight into VRAM.
+ *
+ * The data is decoded into the staging buffer, and each half of it is
+ * transferred with the DMA queue as soon as it fills up, while the other
+ * half is being decoded. The staging buffer must be in high work RAM, and
+ * its size a power of 2, at least as large as the largest match distance
+ * (see bcl_stream_init()). The uncompressed size and the VRAM address
+ * must be multiples of 4.
+ *
+ * Codecs that can't be decoded incrementally are decoded into a temporary
+ * buffer the size of the uncompressed data instead.
+ *
+ * Returns the uncompressed size once every transfer has completed, or -1
+ * if the data is corrupt, or if the staging buffer is too small for the
+ * codec.
+ */
+int32_t bcl_vram_decompress(const void *, void *, void *, uint32_t);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* BCL_VRAM_H_ */
@@ -7,6 +7,8 @@ LIB_SRCS:= \
 	plist.c \
 	tlist.c \
 	transform.c \
+	dsp_transform.c \
+	particle.c \
 	sort.c \
 	matrix_stack.c \
 	fog.c \
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2020
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+
+#include <cpu/cache.h>
+
+#include <scu/dsp.h>
+#include <scu/map.h>
+
+#include "sega3d.h"
+#include "sega3d-internal.h"
+
+/* Offsets in DSP data RAM page #3. See dsp_transform.dsp */
+#define PARAM_ONE_OFFSET        (3)
+#define PARAM_COUNT             (4)
+
+#define CACHE_LINE_SIZE         (16)
+
+/* Strip the cache bits, and convert to a DSP DMA address (in longs) */
+#define DSP_DMA_ADDRESS(x)      (((uint32_t)(x) & 0x07FFFFFFUL) >> 2)
+
+/* Assembled from dsp_transform.dsp */
+static const uint32_t _program[] = {
+        0x00001F05, /* 00: MOV #5,CT3 */
+        0x00003607, /* 01: MOV MC3,RA0 */
+        0x00003707, /* 02: MOV MC3,WA0 */
+        0x00001D00, /* 03: MOV #0,CT1 */
+        0xC0012103, /* 04: DMA D0,MC1,M3 */
+        0xD3400005, /* 05: JMP T0,dma_in_wait */
+        0x00000000, /* 06: NOP */
+        0x00001F04, /* 07: MOV #4,CT3 */
+        0x00003A03, /* 08: MOV M3,LOP */
+        0x00001B0D, /* 09: MOV #vertex_loop,TOP */
+        0x00001D00, /* 0A: MOV #0,CT1 */
+        0x00001E00, /* 0B: MOV #0,CT2 */
+        0x00001F00, /* 0C: MOV #0,CT3 */
+        0x00003305, /* 0D: MOV MC1,MC3 */
+        0x00003305, /* 0E: MOV MC1,MC3 */
+        0x00003305, /* 0F: MOV MC1,MC3 */
+        0x00001F00, /* 10: MOV #0,CT3 */
+        0x00001C00, /* 11: MOV #0,CT0 */
+        0x0249C000, /* 12: MOV MC0,X MOV MC3,Y */
+        0x034BC000, /* 13: MOV MC0,X MOV MUL,P MOV MC3,Y CLR A */
+        0x1B4DC000, /* 14: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x1B4DC000, /* 15: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x19041F00, /* 16: AD2 MOV MUL,P MOV ALU,A MOV #0,CT3 */
+        0x1A49F20A, /* 17: AD2 MOV MC0,X MOV MC3,Y MOV ALH,MC2 */
+        0x034BC000, /* 18: MOV MC0,X MOV MUL,P MOV MC3,Y CLR A */
+        0x1B4DC000, /* 19: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x1B4DC000, /* 1A: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x19041F00, /* 1B: AD2 MOV MUL,P MOV ALU,A MOV #0,CT3 */
+        0x1A49F20A, /* 1C: AD2 MOV MC0,X MOV MC3,Y MOV ALH,MC2 */
+        0x034BC000, /* 1D: MOV MC0,X MOV MUL,P MOV MC3,Y CLR A */
+        0x1B4DC000, /* 1E: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x1B4DC000, /* 1F: AD2 MOV MC0,X MOV MUL,P MOV MC3,Y MOV ALU,A */
+        0x19041F00, /* 20: AD2 MOV MUL,P MOV ALU,A MOV #0,CT3 */
+        0x1800320A, /* 21: AD2 MOV ALH,MC2 */
+        0xE0000000, /* 22: BTM */
+        0x00000000, /* 23: NOP */
+        0x00001F07, /* 24: MOV #7,CT3 */
+        0x00001E00, /* 25: MOV #0,CT2 */
+        0xC0013203, /* 26: DMA MC2,D0,M3 */
+        0xD3400027, /* 27: JMP T0,dma_out_wait */
+        0x00000000, /* 28: NOP */
+        0xF8000000  /* 29: ENDI */
+};
+
+static void _program_load(void);
+
+void
+sega3d_transform_mode_set(sega3d_transform_mode_t mode)
+{
+        if (mode == SEGA3D_TRANSFORM_MODE_DSP) {
+                /* The program stays loaded for as long as the DSP mode is
+                 * set. Anything else running on the DSP clobbers it */
+                _program_load();
+
+                _internal_state->flags |= FLAGS_DSP_TRANSFORM;
+        } else {
+                _internal_state->flags &= ~FLAGS_DSP_TRANSFORM;
+        }
+}
+
+void
+sega3d_dsp_transform(const MATRIX *matrix, const POINT *points,
+    POINT *out_points, uint16_t count)
+{
+        assert((_internal_state->flags & FLAGS_DSP_TRANSFORM) != FLAGS_NONE);
+        assert(matrix != NULL);
+        assert(points != NULL);
+        assert(out_points != NULL);
+        assert(_internal_dsp_transform_reachable(points, count * sizeof(POINT)));
+        assert(_internal_dsp_transform_reachable(out_points, count * sizeof(POINT)));
+
+        _internal_dsp_transform_matrix_set((const FIXED *)matrix);
+
+        while (count > 0) {
+                const uint16_t batch_count = (count < DSP_TRANSFORM_BATCH_COUNT)
+                    ? count
+                    : DSP_TRANSFORM_BATCH_COUNT;
+
+                _internal_dsp_transform_start(points, out_points, batch_count);
+                _internal_dsp_transform_wait();
+
+                /* The output was written by DMA behind the back of the cache */
+                uint8_t *line;
+                line = (uint8_t *)((uintptr_t)out_points & ~(CACHE_LINE_SIZE - 1));
+
+                const uint8_t * const end = (const uint8_t *)&out_points[batch_count];
+
+                for (; line < end; line += CACHE_LINE_SIZE) {
+                        cpu_cache_purge_line(line);
+                }
+
+                points += batch_count;
+                out_points += batch_count;
+                count -= batch_count;
+        }
+}
+
+/* The DSP can only transfer to and from HWRAM. LWRAM isn't reachable */
+bool
+_internal_dsp_transform_reachable(const void *p, uint32_t size)
+{
+        const uint32_t address = (uint32_t)p & 0x07FFFFFFUL;
+
+        return ((address >= HWRAM(0)) &&
+                (address < HWRAM(HWRAM_SIZE)) &&
+                (size <= (HWRAM(HWRAM_SIZE) - address)));
+}
+
+void
+_internal_dsp_transform_matrix_set(const FIXED *matrix)
+{
+        uint32_t one;
+        one = toFIXED(1.0f);
+
+        scu_dsp_data_write(DSP_RAM_PAGE_0, 0, (void *)matrix, MTRX);
+        scu_dsp_data_write(DSP_RAM_PAGE_3, PARAM_ONE_OFFSET, &one, 1);
+}
+
+void
+_internal_dsp_transform_start(const POINT *points, POINT *out_points,
+    uint16_t count)
+{
+        assert((count > 0) && (count <= DSP_TRANSFORM_BATCH_COUNT));
+
+        uint32_t params[PARAM_COUNT];
+
+        params[0] = count - 1;
+        params[1] = DSP_DMA_ADDRESS(points);
+        params[2] = DSP_DMA_ADDRESS(out_points);
+        params[3] = count * XYZ;
+
+        scu_dsp_data_write(DSP_RAM_PAGE_3, PARAM_ONE_OFFSET + 1, params,
+            PARAM_COUNT);
+
+        scu_dsp_program_pc_set(0);
+        scu_dsp_program_start();
+}
+
+void
+_internal_dsp_transform_wait(void)
+{
+        scu_dsp_program_end_wait();
+}
+
+static void
+_program_load(void)
+{
+        scu_dsp_program_stop();
+        scu_dsp_program_load(&_program[0], sizeof(_program) / sizeof(*_program));
+}
@@ -0,0 +1,71 @@
+; Copyright (c) 2020
+; See LICENSE for details.
+;
+; Israel Jacquez <mrkotfw@gmail.com>
+;
+; Transform a batch of vertices by a 3x4 matrix
+;
+; The assembled program is in dsp_transform.c. Keep both in sync.
+;
+; Data RAM layout:
+;   M0[0..11]  Matrix (16.16), in row order M00 M01 M02 M03 M10 ... M23
+;   M1[0..62]  Input vertices (X, Y, Z), up to 21
+;   M2[0..62]  Output vertices (X, Y, Z)
+;   M3[0..2]   Scratch copy of the current vertex
+;   M3[3]      1.0 (16.16), so that the translation is a fourth product
+;   M3[4]      Vertex count - 1
+;   M3[5]      Source address (in longs)
+;   M3[6]      Destination address (in longs)
+;   M3[7]      Vertex count * 3
+;
+; Each row is a multiply-accumulate of four 16.16 products in the 48-bit
+; accumulator. ALH (bits 47..16) is then the 16.16 result.
+
+                MOV     #5,CT3
+                MOV     MC3,RA0
+                MOV     MC3,WA0
+                MOV     #0,CT1
+                DMA     D0,MC1,M3
+dma_in_wait:
+                JMP     T0,dma_in_wait
+                NOP
+                MOV     #4,CT3
+                MOV     M3,LOP
+                MOV     #vertex_loop,TOP
+                MOV     #0,CT1
+                MOV     #0,CT2
+                MOV     #0,CT3
+vertex_loop:
+                MOV     MC1,MC3
+                MOV     MC1,MC3
+                MOV     MC1,MC3
+                MOV     #0,CT3
+                MOV     #0,CT0
+                        MOV MC0,X                  MOV MC3,Y
+                ; Row 0
+                        MOV MC0,X      MOV MUL,P   MOV MC3,Y  CLR A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2                    MOV MUL,P              MOV ALU,A  MOV #0,CT3
+                AD2     MOV MC0,X                  MOV MC3,Y             MOV ALH,MC2
+                ; Row 1
+                        MOV MC0,X      MOV MUL,P   MOV MC3,Y  CLR A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2                    MOV MUL,P              MOV ALU,A  MOV #0,CT3
+                AD2     MOV MC0,X                  MOV MC3,Y             MOV ALH,MC2
+                ; Row 2
+                        MOV MC0,X      MOV MUL,P   MOV MC3,Y  CLR A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2     MOV MC0,X      MOV MUL,P   MOV MC3,Y  MOV ALU,A
+                AD2                    MOV MUL,P              MOV ALU,A  MOV #0,CT3
+                AD2                                                      MOV ALH,MC2
+                BTM
+                NOP
+                MOV     #7,CT3
+                MOV     #0,CT2
+                DMA     MC2,D0,M3
+dma_out_wait:
+                JMP     T0,dma_out_wait
+                NOP
+                ENDI
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2020
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <cpu/divu.h>
+
+#include <mm/memb.h>
+
+#include <vdp1/cmdt.h>
+
+#include "sega3d.h"
+#include "sega3d-internal.h"
+
+/* Scaled sprite, zooming from the center */
+#define CMDT_CTRL_SCALED_SPRITE_CENTER                                         \
+        ((VDP1_CMDT_ZOOM_POINT_CENTER << 8) | 0x0001)
+
+extern void _internal_sort_add(void *packet, int32_t pz);
+
+MEMB(_emitter_pool, sega3d_particle_emitter_t, SEGA3D_PARTICLE_EMITTER_COUNT, 4);
+
+static void _particle_kill(sega3d_particle_emitter_t *emitter, uint16_t index);
+
+void
+_internal_particle_init(void)
+{
+        memb_init(&_emitter_pool);
+}
+
+sega3d_particle_emitter_t *
+sega3d_particle_emitter_alloc(uint16_t count_max)
+{
+        assert(count_max > 0);
+
+        sega3d_particle_emitter_t * const emitter = memb_alloc(&_emitter_pool);
+
+        if (emitter == NULL) {
+                return NULL;
+        }
+
+        /* All arrays are carved out of a single block */
+        const size_t array_size = count_max * sizeof(FIXED);
+
+        uint8_t * const arrays = malloc((6 * array_size) +
+            (count_max * sizeof(uint16_t)));
+
+        if (arrays == NULL) {
+                int ret __unused;
+                ret = memb_free(&_emitter_pool, emitter);
+                assert(ret == 0);
+
+                return NULL;
+        }
+
+        for (uint32_t i = 0; i < XYZ; i++) {
+                emitter->positions[i] = (FIXED *)&arrays[i * array_size];
+                emitter->velocities[i] = (FIXED *)&arrays[(XYZ + i) * array_size];
+                emitter->acceleration[i] = toFIXED(0.0f);
+        }
+
+        emitter->lives = (uint16_t *)&arrays[6 * array_size];
+        emitter->count = 0;
+        emitter->count_max = count_max;
+        emitter->size = toFIXED(1.0f);
+        emitter->char_base = 0x0000;
+        emitter->char_size = 0x0000;
+        emitter->color = 0x0000;
+        emitter->draw_mode = 0x0000;
+
+        return emitter;
+}
+
+void
+sega3d_particle_emitter_free(sega3d_particle_emitter_t *emitter)
+{
+        assert(emitter != NULL);
+
+        free(emitter->positions[X]);
+
+        int ret __unused;
+        ret = memb_free(&_emitter_pool, emitter);
+        assert(ret == 0);
+}
+
+void
+sega3d_particle_emitter_clear(sega3d_particle_emitter_t *emitter)
+{
+        assert(emitter != NULL);
+
+        emitter->count = 0;
+}
+
+bool
+sega3d_particle_emit(sega3d_particle_emitter_t *emitter, const POINT position,
+    const VECTOR velocity, uint16_t life)
+{
+        assert(emitter != NULL);
+
+        if ((emitter->count == emitter->count_max) || (life == 0)) {
+                return false;
+        }
+
+        const uint16_t index = emitter->count;
+
+        for (uint32_t i = 0; i < XYZ; i++) {
+                emitter->positions[i][index] = position[i];
+                emitter->velocities[i][index] = velocity[i];
+        }
+
+        emitter->lives[index] = life;
+
+        emitter->count++;
+
+        return true;
+}
+
+void
+sega3d_particle_emitter_update(sega3d_particle_emitter_t *emitter)
+{
+        assert(emitter != NULL);
+
+        /* Integrate one component at a time so that each loop only touches two
+         * arrays */
+        for (uint32_t i = 0; i < XYZ; i++) {
+                FIXED * const positions = emitter->positions[i];
+                FIXED * const velocities = emitter->velocities[i];
+                const FIXED acceleration = emitter->acceleration[i];
+
+                for (uint32_t j = 0; j < emitter->count; j++) {
+                        velocities[j] += acceleration;
+                        positions[j] += velocities[j];
+                }
+        }
+
+        uint16_t * const lives = emitter->lives;
+
+        uint32_t j;
+        j = 0;
+
+        while (j < emitter->count) {
+                lives[j]--;
+
+                if (lives[j] == 0) {
+                        /* The last particle takes this one's place, and has yet
+                         * to be aged */
+                        _particle_kill(emitter, j);
+
+                        continue;
+                }
+
+                j++;
+        }
+}
+
+void
+sega3d_particle_emitter_transform(const sega3d_particle_emitter_t *emitter)
+{
+        assert(emitter != NULL);
+
+        if (emitter->count == 0) {
+                return;
+        }
+
+        transform_t * const trans = _internal_state->transform;
+        const sega3d_info_t * const info = _internal_state->info;
+
+        const FIXED * const matrix = (const FIXED *)sega3d_matrix_top();
+        const FIXED * const camera_matrix =
+            (const FIXED *)_internal_state->clip_camera;
+
+        /* Same as the camera to world transform done for objects */
+        const FIXED tx = matrix[M03] - camera_matrix[M03];
+        const FIXED ty = matrix[M13] - camera_matrix[M13];
+        const FIXED tz = matrix[M23] - camera_matrix[M23];
+
+        const FIXED * const px = emitter->positions[X];
+        const FIXED * const py = emitter->positions[Y];
+        const FIXED * const pz = emitter->positions[Z];
+
+        const int16_t sw_2 = trans->cached_sw_2;
+        const int16_t sh_2 = trans->cached_sh_2;
+
+        for (uint32_t i = 0; i < emitter->count; i++) {
+                const FIXED z = fix16_mul(matrix[M20], px[i]) +
+                                fix16_mul(matrix[M21], py[i]) +
+                                fix16_mul(matrix[M22], pz[i]) + tz;
+
+                if ((z < info->near) || (z >= info->far)) {
+                        continue;
+                }
+
+                cpu_divu_fix16_set(info->view_distance, z);
+
+                const FIXED x = fix16_mul(matrix[M00], px[i]) +
+                                fix16_mul(matrix[M01], py[i]) +
+                                fix16_mul(matrix[M02], pz[i]) + tx;
+                const FIXED y = fix16_mul(matrix[M10], px[i]) +
+                                fix16_mul(matrix[M11], py[i]) +
+                                fix16_mul(matrix[M12], pz[i]) + ty;
+
+                const FIXED inv_z = cpu_divu_quotient_get();
+                const FIXED inv_z_y = fix16_mul(info->ratio, inv_z);
+
+                const int16_t screen_x = fix16_int16_muls(x, inv_z);
+                const int16_t screen_y = fix16_int16_muls(y, inv_z_y);
+                const int16_t half_width = fix16_int16_muls(emitter->size, inv_z);
+                const int16_t half_height = fix16_int16_muls(emitter->size, inv_z_y);
+
+                if (((screen_x + half_width) < -sw_2) ||
+                    ((screen_x - half_width) > sw_2) ||
+                    ((screen_y + half_height) < -sh_2) ||
+                    ((screen_y - half_height) > sh_2)) {
+                        continue;
+                }
+
+                vdp1_cmdt_t * const cmdt = trans->current_cmdt;
+
+                cmdt->cmd_ctrl = CMDT_CTRL_SCALED_SPRITE_CENTER;
+                cmdt->cmd_link = 0x0000;
+                cmdt->cmd_pmod = emitter->draw_mode;
+                cmdt->cmd_colr = emitter->color;
+                cmdt->cmd_srca = emitter->char_base;
+                cmdt->cmd_size = emitter->char_size;
+                /* Zoom point */
+                cmdt->cmd_xa = screen_x;
+                cmdt->cmd_ya = screen_y;
+                /* Display width and height */
+                cmdt->cmd_xb = half_width << 1;
+                cmdt->cmd_yb = half_height << 1;
+                cmdt->cmd_grda = 0x0000;
+
+                _internal_sort_add(cmdt, fix16_int32_to(z));
+
+                trans->current_cmdt++;
+        }
+}
+
+static void
+_particle_kill(sega3d_particle_emitter_t *emitter, uint16_t index)
+{
+        emitter->count--;
+
+        const uint16_t last = emitter->count;
+
+        for (uint32_t i = 0; i < XYZ; i++) {
+                emitter->positions[i][index] = emitter->positions[i][last];
+                emitter->velocities[i][index] = emitter->velocities[i][last];
+        }
+
+        emitter->lives[index] = emitter->lives[last];
+}
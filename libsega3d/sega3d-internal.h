@@ -23,10 +23,15 @@
 
 #define CLIP_PLANE_COUNT        (6)
 
+/* Number of vertices the DSP transforms in one go. Bound by the size of data
+ * RAM page #1 (and #2), 64 longs */
+#define DSP_TRANSFORM_BATCH_COUNT (21)
+
 typedef enum {
-        FLAGS_NONE        = 0,
-        FLAGS_INITIALIZED = 1 << 0,
-        FLAGS_FOG_ENABLED = 1 << 1,
+        FLAGS_NONE          = 0,
+        FLAGS_INITIALIZED   = 1 << 0,
+        FLAGS_FOG_ENABLED   = 1 << 1,
+        FLAGS_DSP_TRANSFORM = 1 << 2
 } flags_t;
 
 typedef enum {
@@ -136,4 +141,10 @@ extern void internal_list_alloc(list_t *list, uint16_t count);
 extern void internal_list_free(list_t *list);
 extern void internal_list_set(list_t *list, void *list_p, uint16_t count);
 
+extern bool _internal_dsp_transform_reachable(const void *p, uint32_t size);
+extern void _internal_dsp_transform_matrix_set(const FIXED *matrix);
+extern void _internal_dsp_transform_start(const POINT *points,
+    POINT *out_points, uint16_t count);
+extern void _internal_dsp_transform_wait(void);
+
 #endif /* SEGA3D_INTERNAL_H_ */
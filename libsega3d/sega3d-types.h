@@ -25,6 +25,17 @@ typedef enum sega3d_matrix_type {
         SEGA3D_MATRIX_TYPE_MOVE_PTR = 1
 } sega3d_matrix_type_t;
 
+typedef enum sega3d_transform_mode {
+        /// Transform vertices on the CPU
+        SEGA3D_TRANSFORM_MODE_CPU = 0,
+        /// Transform vertices on the SCU-DSP, while the CPU projects them.
+        ///
+        /// The SCU-DSP only reaches HWRAM. Objects whose vertices are
+        /// elsewhere (e.g. LWRAM) are transformed on the CPU, and the points
+        /// passed to @ref sega3d_dsp_transform must be in HWRAM.
+        SEGA3D_TRANSFORM_MODE_DSP = 1
+} sega3d_transform_mode_t;
+
 typedef enum sega3d_flags {
         SEGA3D_OBJECT_FLAGS_NONE         = 0,
         /// Display non-textured polygons
@@ -82,6 +93,40 @@ typedef struct sega3d_cull_aabb {
         FIXED length[XYZ];
 } sega3d_cull_aabb_t;
 
+/// Maximum number of particle emitters.
+#define SEGA3D_PARTICLE_EMITTER_COUNT   (16)
+
+/// @brief Particle emitter.
+///
+/// @details Particles are stored as a structure of arrays, and live particles
+/// are kept packed at the start of each array.
+typedef struct sega3d_particle_emitter {
+        /// World space position.
+        FIXED *positions[XYZ];
+        /// Velocity, in units per frame.
+        FIXED *velocities[XYZ];
+        /// Remaining number of frames to live.
+        uint16_t *lives;
+        /// Number of live particles.
+        uint16_t count;
+        /// Maximum number of particles.
+        uint16_t count_max;
+
+        /// Acceleration added to the velocity of each particle every frame.
+        FIXED acceleration[XYZ];
+        /// Half the width (and height) of a particle in world space.
+        FIXED size;
+
+        /// Character address, as in @ref TEXTURE.CGadr.
+        uint16_t char_base;
+        /// Character size, as in @ref TEXTURE.HVsize.
+        uint16_t char_size;
+        /// Color bank or lookup table address.
+        uint16_t color;
+        /// Draw mode, as in @ref vdp1_cmdt_t.cmd_pmod.
+        uint16_t draw_mode;
+} sega3d_particle_emitter_t;
+
 struct sega3d_object {
         sega3d_flags_t flags;
 
@@ -23,6 +23,7 @@
 
 extern void _internal_fog_init(void);
 extern void _internal_matrix_init(void);
+extern void _internal_particle_init(void);
 extern void _internal_plist_init(void);
 extern void _internal_sort_init(void);
 extern void _internal_tlist_init(void);
@@ -49,6 +50,7 @@ sega3d_init(void)
 
         _internal_fog_init();
         _internal_matrix_init();
+        _internal_particle_init();
         _internal_plist_init();
         _internal_sort_init();
         _internal_tlist_init();
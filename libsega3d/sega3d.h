@@ -8,6 +8,7 @@
 #ifndef SEGA3D_H_
 #define SEGA3D_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <fix16.h>
@@ -57,6 +58,18 @@ extern Uint16 sega3d_object_polycount_get(const sega3d_object_t *object);
 extern void sega3d_object_transform(const sega3d_object_t *object,
     uint16_t xpdata_index);
 
+extern void sega3d_transform_mode_set(sega3d_transform_mode_t mode);
+extern void sega3d_dsp_transform(const MATRIX *matrix, const POINT *points,
+    POINT *out_points, uint16_t count);
+
+extern sega3d_particle_emitter_t *sega3d_particle_emitter_alloc(uint16_t count_max);
+extern void sega3d_particle_emitter_free(sega3d_particle_emitter_t *emitter);
+extern void sega3d_particle_emitter_clear(sega3d_particle_emitter_t *emitter);
+extern bool sega3d_particle_emit(sega3d_particle_emitter_t *emitter,
+    const POINT position, const VECTOR velocity, uint16_t life);
+extern void sega3d_particle_emitter_update(sega3d_particle_emitter_t *emitter);
+extern void sega3d_particle_emitter_transform(const sega3d_particle_emitter_t *emitter);
+
 extern sega3d_ztp_handle_t sega3d_ztp_parse(sega3d_object_t *object,
     const sega3d_ztp_t *ztp);
 extern void sega3d_ztp_textures_parse(sega3d_ztp_handle_t *handle, void *vram,
@@ -92,7 +92,7 @@ _internal_sort_iterate(iterate_fn fn)
 
                         while (single_next->next_single != NULL) {
                                 /* Send commmand here */
-                                fn(*first_single);
+                                fn(single_next);
 
                                 single_next = single_next->next_single;
                         }
@@ -5,11 +5,14 @@
  * Israel Jacquez <mrkotfw@gmail.com>
  */
 
+#include <cpu/cache.h>
 #include <cpu/divu.h>
 #include <vdp.h>
 
 #include <dbgio.h>
 
+#include <sys/prof.h>
+
 #include "sega3d-internal.h"
 
 extern void _internal_sort_clear(void);
@@ -26,6 +29,7 @@ static void _polygon_process(transform_t * const trans, POLYGON const *polygons)
 static void _sort_iterate(const sort_single_t *single);
 static void _vertex_pool_clipping(const transform_t * const trans);
 static void _vertex_pool_transform(const transform_t * const trans, const POINT * const points);
+static void _vertex_pool_dsp_transform(const transform_t * const trans, const POINT * const points);
 static void _z_calculate(transform_t * const trans);
 
 static inline FIXED __always_inline __unused
@@ -92,6 +96,9 @@ _normal_rotate(const fix16_vec3_t *p, const FIXED *matrix)
 
 static vdp1_cmdt_t _cmdt_end;
 
+/* While the CPU projects one batch, the DSP transforms the next one */
+static POINT _dsp_points[2][DSP_TRANSFORM_BATCH_COUNT] __aligned(16);
+
 void
 _internal_transform_init(void)
 {
@@ -158,6 +165,8 @@ sega3d_start(vdp1_cmdt_orderlist_t *orderlist, uint16_t orderlist_offset, vdp1_c
 void
 sega3d_finish(sega3d_results_t *results)
 {
+        prof_zone_begin(PROF_ZONE_SEGA3D_FINISH);
+
         _internal_sort_iterate(_sort_iterate);
 
         transform_t * const trans = _internal_state->transform;
@@ -176,6 +185,8 @@ sega3d_finish(sega3d_results_t *results)
                 results->object_count = internal_results->object_count;
                 results->polygon_count = trans->current_orderlist - trans->orderlist;
         }
+
+        prof_zone_end(PROF_ZONE_SEGA3D_FINISH);
 }
 
 void
@@ -193,6 +204,8 @@ sega3d_object_transform(const sega3d_object_t *object, uint16_t xpdata_index)
                 return;
         }
 
+        prof_zone_begin(PROF_ZONE_SEGA3D_TRANSFORM);
+
         transform_t * const trans = _internal_state->transform;
 
         trans->object = object;
@@ -202,17 +215,28 @@ sega3d_object_transform(const sega3d_object_t *object, uint16_t xpdata_index)
 
         if ((object->flags & SEGA3D_OBJECT_FLAGS_CULL_AABB) != SEGA3D_OBJECT_FLAGS_NONE) {
                 if ((_object_aabb_cull_test(trans))) {
+                        prof_zone_end(PROF_ZONE_SEGA3D_TRANSFORM);
+
                         return;
                 }
         } else if ((object->flags & SEGA3D_OBJECT_FLAGS_CULL_SPHERE) != SEGA3D_OBJECT_FLAGS_NONE) {
                 if ((_object_sphere_cull_test(trans))) {
+                        prof_zone_end(PROF_ZONE_SEGA3D_TRANSFORM);
+
                         return;
                 }
         }
 
         sega3d_matrix_push(SEGA3D_MATRIX_TYPE_PUSH); {
                 _camera_world_transform();
-                _vertex_pool_transform(trans, xpdata->pntbl);
+                /* Vertices the DSP can't reach are transformed on the CPU */
+                if (((_internal_state->flags & FLAGS_DSP_TRANSFORM) != FLAGS_NONE) &&
+                    (_internal_dsp_transform_reachable(xpdata->pntbl,
+                        vertex_count * sizeof(POINT)))) {
+                        _vertex_pool_dsp_transform(trans, xpdata->pntbl);
+                } else {
+                        _vertex_pool_transform(trans, xpdata->pntbl);
+                }
                 _vertex_pool_clipping(trans);
                 _polygon_process(trans, xpdata->pltbl);
         } sega3d_matrix_pop();
@@ -220,6 +244,8 @@ sega3d_object_transform(const sega3d_object_t *object, uint16_t xpdata_index)
         sega3d_results_t * const results = _internal_state->results;
 
         results->object_count++;
+
+        prof_zone_end(PROF_ZONE_SEGA3D_TRANSFORM);
 }
 
 static void
@@ -333,6 +359,88 @@ _vertex_pool_transform(const transform_t * const trans, const POINT * const poin
         } while (current_point <= last_point);
 }
 
+static void
+_vertex_pool_dsp_transform(const transform_t * const trans, const POINT * const points)
+{
+        const sega3d_info_t * const info = _internal_state->info;
+
+        transform_proj_t *trans_proj;
+        trans_proj = &_internal_state->transform_proj_pool[0];
+
+        const FIXED view_distance = info->view_distance;
+        const FIXED z_near = info->near;
+        const FIXED ratio = info->ratio;
+
+        _internal_dsp_transform_matrix_set((const FIXED *)sega3d_matrix_top());
+
+        const POINT *current_points;
+        current_points = points;
+
+        uint16_t vertex_count;
+        vertex_count = trans->vertex_count;
+
+        uint32_t buffer;
+        buffer = 0;
+
+        uint16_t batch_count;
+        batch_count = (vertex_count < DSP_TRANSFORM_BATCH_COUNT)
+            ? vertex_count
+            : DSP_TRANSFORM_BATCH_COUNT;
+
+        _internal_dsp_transform_start(current_points, _dsp_points[buffer],
+            batch_count);
+
+        while (vertex_count > 0) {
+                _internal_dsp_transform_wait();
+
+                /* The DSP writes the transformed points via DMA, so bypass the
+                 * cache */
+                const FIXED *out_point;
+                out_point = (const FIXED *)(CPU_CACHE_THROUGH | (uintptr_t)_dsp_points[buffer]);
+
+                const uint16_t out_count = batch_count;
+
+                current_points += batch_count;
+                vertex_count -= batch_count;
+
+                if (vertex_count > 0) {
+                        batch_count = (vertex_count < DSP_TRANSFORM_BATCH_COUNT)
+                            ? vertex_count
+                            : DSP_TRANSFORM_BATCH_COUNT;
+
+                        buffer ^= 1;
+
+                        _internal_dsp_transform_start(current_points,
+                            _dsp_points[buffer], batch_count);
+                }
+
+                for (uint32_t i = 0; i < out_count; i++, out_point += XYZ) {
+                        trans_proj->clip_flags = CLIP_FLAGS_NONE;
+                        trans_proj->point_z = out_point[Z];
+
+                        /* In case the projected Z value is on or behind the
+                         * near plane */
+                        if (trans_proj->point_z < z_near) {
+                                trans_proj->clip_flags |= CLIP_FLAGS_NEAR;
+
+                                trans_proj->point_z = z_near;
+                        }
+
+                        cpu_divu_fix16_set(view_distance, trans_proj->point_z);
+
+                        const FIXED point_x = out_point[X];
+                        const FIXED point_y = out_point[Y];
+
+                        const FIXED inv_z = cpu_divu_quotient_get();
+
+                        trans_proj->screen.x = fix16_int16_muls(point_x, inv_z);
+                        trans_proj->screen.y = fix16_int16_muls(point_y, fix16_mul(ratio, inv_z));
+
+                        trans_proj++;
+                }
+        }
+}
+
 static void
 _sort_iterate(const sort_single_t *single)
 {
@@ -65,11 +65,15 @@ LIB_SRCS+= \
 	\
 	kernel/sys/dma-queue.c \
 	kernel/sys/callback-list.c \
+	kernel/sys/prof.c \
 	\
+	kernel/mm/arena.c \
 	kernel/mm/memb.c
 
 # TLSF is required
 LIB_SRCS+= \
+	kernel/mm/heap.c \
+	kernel/mm/stats.c \
 	kernel/mm/tlsf.c
 
 LIB_SRCS+= \
@@ -184,10 +188,13 @@ LIB_SRCS+= \
 	scu/bus/b/vdp/vdp_init.c \
 	scu/bus/b/vdp/vdp_sync.c \
 	scu/bus/b/vdp/vdp-internal.c \
+	scu/bus/b/vdp/vdp1_batch.c \
 	scu/bus/b/vdp/vdp1_cmdt.c \
 	scu/bus/b/vdp/vdp1_env.c \
+	scu/bus/b/vdp/vdp1_texture.c \
 	scu/bus/b/vdp/vdp1_vram.c \
 	scu/bus/b/vdp/vdp2_cram.c \
+	scu/bus/b/vdp/vdp2_palette.c \
 	scu/bus/b/vdp/vdp2_regs.c \
 	scu/bus/b/vdp/vdp2_scrn.c \
 	scu/bus/b/vdp/vdp2_scrn_back_screen.c \
@@ -201,8 +208,10 @@ LIB_SRCS+= \
 	scu/bus/b/vdp/vdp2_scrn_sf.c \
 	scu/bus/b/vdp/vdp2_scrn_vcs.c \
 	scu/bus/b/vdp/vdp2_sprite.c \
+	scu/bus/b/vdp/vdp2_tilemap.c \
 	scu/bus/b/vdp/vdp2_tvmd.c \
 	scu/bus/b/vdp/vdp2_vram.c \
+	scu/bus/b/vdp/vdp2_vram_layout.c \
 	\
 	scu/bus/cpu/cpu_cache.c \
 	scu/bus/cpu/cpu_divu.c \
@@ -285,7 +294,10 @@ INSTALL_HEADER_FILES+= \
 	./kernel/dbgio/:dbgio.h:yaul/dbgio/
 
 INSTALL_HEADER_FILES+= \
-	./kernel/mm/:memb.h:yaul/mm/
+	./kernel/mm/:arena.h:yaul/mm/ \
+	./kernel/mm/:heap.h:yaul/mm/ \
+	./kernel/mm/:memb.h:yaul/mm/ \
+	./kernel/mm/:stats.h:yaul/mm/
 
 # TLSF is required
 INSTALL_HEADER_FILES+= \
@@ -297,6 +309,9 @@ INSTALL_HEADER_FILES+= \
 INSTALL_HEADER_FILES+= \
 	./kernel/sys/:callback-list.h:yaul/sys/
 
+INSTALL_HEADER_FILES+= \
+	./kernel/sys/:prof.h:yaul/sys/
+
 INSTALL_HEADER_FILES+= \
 	./kernel/vfs/fs/romdisk/:romdisk.h:yaul/fs/romdisk/
 
@@ -340,18 +355,23 @@ INSTALL_HEADER_FILES+= \
 	\
 	./scu/bus/b/vdp/:vdp.h:yaul/scu/bus/b/vdp/ \
 	./scu/bus/b/vdp/:vdp1.h:yaul/scu/bus/b/vdp/ \
+	./scu/bus/b/vdp/vdp1/:batch.h:yaul/scu/bus/b/vdp/vdp1/ \
 	./scu/bus/b/vdp/vdp1/:cmdt.h:yaul/scu/bus/b/vdp/vdp1/ \
 	./scu/bus/b/vdp/vdp1/:env.h:yaul/scu/bus/b/vdp/vdp1/ \
 	./scu/bus/b/vdp/vdp1/:map.h:yaul/scu/bus/b/vdp/vdp1/ \
+	./scu/bus/b/vdp/vdp1/:texture.h:yaul/scu/bus/b/vdp/vdp1/ \
 	./scu/bus/b/vdp/vdp1/:vram.h:yaul/scu/bus/b/vdp/vdp1/ \
 	./scu/bus/b/vdp/:vdp2.h:yaul/scu/bus/b/vdp/ \
 	./scu/bus/b/vdp/vdp2/:cram.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:map.h:yaul/scu/bus/b/vdp/vdp2/ \
+	./scu/bus/b/vdp/vdp2/:palette.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:scrn.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:scrn_macros.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:sprite.h:yaul/scu/bus/b/vdp/vdp2/ \
+	./scu/bus/b/vdp/vdp2/:tilemap.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:tvmd.h:yaul/scu/bus/b/vdp/vdp2/ \
 	./scu/bus/b/vdp/vdp2/:vram.h:yaul/scu/bus/b/vdp/vdp2/ \
+	./scu/bus/b/vdp/vdp2/:vram_layout.h:yaul/scu/bus/b/vdp/vdp2/ \
 	\
 	./scu/bus/cpu/:cpu.h:yaul/scu/bus/cpu/ \
 	./scu/bus/cpu/cpu/:cache.h:yaul/scu/bus/cpu/cpu/ \
@@ -157,7 +157,7 @@ $2: $2.d
 
 $2.o: $2
 	@printf -- "$(V_BEGIN_YELLOW)$(strip $1).romdisk.o$(V_END)\n"
-	$(ECHO)$(YAUL_INSTALL_ROOT)/bin/bin2o $$< "$(strip $1)_romdisk" $$@
+	$(ECHO)$(YAUL_INSTALL_ROOT)/bin/bin2o $$< "$(strip $1)_romdisk" $$@ $(ROMDISK_ALIGN)
 
 -include "$2.d"
 endef
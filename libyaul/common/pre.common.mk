@@ -79,6 +79,9 @@ SH_LIBRARIES?=
 SH_CUSTOM_SPECS?=
 SH_BUILD_DIR?= build
 ROMDISK_DIRS?=
+# Alignment (in bytes) of the data of each file in a ROMDISK, and of the
+# ROMDISK itself. At least 16, and a power of 2
+ROMDISK_ALIGN?= 16
 IMAGE_DIRECTORY?= cd
 IMAGE_1ST_READ_BIN?= A.BIN
 
@@ -141,7 +144,7 @@ CDB_FILE:= compile_commands.json
 CDB_GCC?= /usr/bin/gcc
 CDB_CPP?= /usr/bin/g++
 
-ROMDISK_FLAGS:= -v -a 16 -V "ROOT"
+ROMDISK_FLAGS:= -v -a $(ROMDISK_ALIGN) -V "ROOT"
 
 SUFFIXES:= .c .cc .C .cpp .cxx .sx .o .bin .elf .romdisk .romdisk.o
 
@@ -26,7 +26,9 @@
 
 #define TLSF_POOL_PRIVATE       (0)
 #define TLSF_POOL_USER          (1)
-#define TLSF_POOL_COUNT         (2)
+#define TLSF_POOL_LWRAM         (2)
+#define TLSF_POOL_DRAM_CART     (3)
+#define TLSF_POOL_COUNT         (4)
 
 struct state {
         uint8_t which;
@@ -62,6 +64,11 @@ void *_internal_realloc(void *, size_t);
 void *_internal_memalign(size_t, size_t);
 void _internal_free(void *);
 
+size_t _internal_mm_stats_size(const void *);
+void _internal_mm_stats_alloc(uint32_t, const void *);
+void _internal_mm_stats_free(uint32_t, const void *);
+void _internal_mm_stats_realloc(uint32_t, size_t, const void *, size_t);
+
 extern void _internal_dma_queue_init(void);
 
 #endif /* !_KERNEL_INTERNAL_H_ */
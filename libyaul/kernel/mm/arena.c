@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <mm/arena.h>
+
+arena_t *_internal_frame_arena = NULL;
+
+static struct {
+        arena_t arenas[FRAME_ARENA_COUNT];
+        uint8_t index;
+} _frame;
+
+void
+arena_init(arena_t *arena, void *buffer, size_t size)
+{
+        assert(arena != NULL);
+        assert(buffer != NULL);
+        assert(((uintptr_t)buffer & (ARENA_ALIGNMENT - 1)) == 0);
+
+        arena->base = buffer;
+        arena->size = size & ~(ARENA_ALIGNMENT - 1);
+        arena->offset = 0;
+}
+
+void
+arena_reset(arena_t *arena)
+{
+        assert(arena != NULL);
+
+        arena->offset = 0;
+}
+
+size_t
+arena_used_get(const arena_t *arena)
+{
+        assert(arena != NULL);
+
+        return arena->offset;
+}
+
+size_t
+arena_free_get(const arena_t *arena)
+{
+        assert(arena != NULL);
+
+        return (arena->size - arena->offset);
+}
+
+void *
+arena_memalign(arena_t *arena, size_t size, size_t alignment)
+{
+        assert(arena != NULL);
+        assert(alignment > 0);
+        assert((alignment & (alignment - 1)) == 0);
+
+        const uint32_t address = (uint32_t)arena->base + arena->offset;
+        const uint32_t aligned_address =
+            (address + (alignment - 1)) & ~(alignment - 1);
+        const uint32_t offset = aligned_address - (uint32_t)arena->base;
+
+        if ((offset > arena->size) || (size > (arena->size - offset))) {
+                return NULL;
+        }
+
+        arena->offset = offset;
+
+        return arena_alloc(arena, size);
+}
+
+void
+frame_arena_init(size_t size)
+{
+        assert(size > 0);
+
+        frame_arena_deinit();
+
+        for (uint32_t i = 0; i < FRAME_ARENA_COUNT; i++) {
+                void * const buffer = malloc(size);
+                assert(buffer != NULL);
+
+                arena_init(&_frame.arenas[i], buffer, size);
+        }
+
+        _frame.index = 0;
+
+        _internal_frame_arena = &_frame.arenas[0];
+}
+
+void
+frame_arena_deinit(void)
+{
+        if (_internal_frame_arena == NULL) {
+                return;
+        }
+
+        for (uint32_t i = 0; i < FRAME_ARENA_COUNT; i++) {
+                free(_frame.arenas[i].base);
+
+                _frame.arenas[i].base = NULL;
+        }
+
+        _internal_frame_arena = NULL;
+}
+
+void
+frame_arena_swap(void)
+{
+        if (_internal_frame_arena == NULL) {
+                return;
+        }
+
+        _frame.index++;
+
+        if (_frame.index == FRAME_ARENA_COUNT) {
+                _frame.index = 0;
+        }
+
+        _internal_frame_arena = &_frame.arenas[_frame.index];
+
+        arena_reset(_internal_frame_arena);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <sys/cdefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+__BEGIN_DECLS
+
+/// Default alignment (in bytes) of allocations.
+#define ARENA_ALIGNMENT         (4)
+
+/// Number of frame arenas. Data allocated during a frame stays valid until the
+/// end of the following frame, so that it can be referenced by transfers still
+/// in flight.
+#define FRAME_ARENA_COUNT       (2)
+
+/// @brief Linear (bump) allocator.
+///
+/// @details Allocations can't be freed individually. Instead, the entire arena
+/// is reset at once.
+typedef struct arena {
+        uint8_t *base;
+        uint32_t size;
+        uint32_t offset;
+} arena_t;
+
+extern void arena_init(arena_t *, void *, size_t);
+extern void arena_reset(arena_t *);
+extern size_t arena_used_get(const arena_t *);
+extern size_t arena_free_get(const arena_t *);
+
+/// @brief Allocate @p size bytes aligned to @ref ARENA_ALIGNMENT.
+///
+/// @returns `NULL` if the arena is exhausted.
+static inline void * __always_inline
+arena_alloc(arena_t *arena, size_t size)
+{
+        const uint32_t offset = arena->offset;
+
+        /* Compare against what's left so that a large size can't wrap the
+         * offset around. The size of the arena is a multiple of the
+         * alignment, so rounding up can't exceed it either */
+        if (size > (arena->size - offset)) {
+                return NULL;
+        }
+
+        const uint32_t next_offset =
+            (offset + size + (ARENA_ALIGNMENT - 1)) & ~(ARENA_ALIGNMENT - 1);
+
+        arena->offset = next_offset;
+
+        return &arena->base[offset];
+}
+
+extern void *arena_memalign(arena_t *, size_t, size_t);
+
+/// @brief Allocate the frame arenas, @p size bytes each, from the user pool.
+extern void frame_arena_init(size_t);
+extern void frame_arena_deinit(void);
+
+/// @brief Returns the frame arena of the current frame, or `NULL` if the frame
+/// arenas haven't been initialized.
+static inline arena_t * __always_inline
+frame_arena_get(void)
+{
+        extern arena_t *_internal_frame_arena;
+
+        return _internal_frame_arena;
+}
+
+/// @brief Switch to the next frame arena, and reset it.
+///
+/// @details Called at the end of @ref vdp_sync.
+extern void frame_arena_swap(void);
+
+/// @brief Allocate @p size bytes from the frame arena of the current frame.
+///
+/// @returns `NULL` if the frame arenas haven't been initialized, or if the
+/// frame arena is exhausted.
+static inline void * __always_inline
+frame_alloc(size_t size)
+{
+        arena_t * const arena = frame_arena_get();
+
+        if (arena == NULL) {
+                return NULL;
+        }
+
+        return arena_alloc(arena, size);
+}
+
+__END_DECLS
+
+#endif /* !_ARENA_H_ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <dram-cart.h>
+
+#include <mm/heap.h>
+#include <mm/tlsf.h>
+
+#include <internal.h>
+
+/* Strip the cache-through and purge bits so that any of the mirrors of an
+ * address fall within the same range */
+#define ADDRESS_STRIP(x)        ((uint32_t)(x) & 0x07FFFFFFUL)
+
+static struct {
+        uint32_t start;
+        uint32_t end;
+} _regions[MM_HEAP_COUNT];
+
+static inline uint32_t __always_inline
+_pool_index_get(mm_heap_t heap)
+{
+        return (heap == MM_HEAP_LWRAM) ? TLSF_POOL_LWRAM : TLSF_POOL_DRAM_CART;
+}
+
+static inline tlsf_t * __always_inline
+_pool_get(mm_heap_t heap)
+{
+        switch (heap) {
+        case MM_HEAP_LWRAM:
+        case MM_HEAP_DRAM_CART:
+                return &master_state()->tlsf_pools[_pool_index_get(heap)];
+        default:
+                return NULL;
+        }
+}
+
+bool
+mm_heap_init(mm_heap_t heap, void *base, size_t size)
+{
+        tlsf_t * const pool = _pool_get(heap);
+
+        if (pool == NULL) {
+                return false;
+        }
+
+        if (*pool != NULL) {
+                return false;
+        }
+
+        const void * const dram_cart_area = dram_cart_area_get();
+
+        uint32_t region_base;
+        uint32_t region_size;
+
+        switch (heap) {
+        case MM_HEAP_LWRAM:
+                region_base = LWRAM(0x00000000);
+                region_size = LWRAM_SIZE;
+                break;
+        case MM_HEAP_DRAM_CART:
+                region_base = (uint32_t)dram_cart_area;
+                region_size = dram_cart_size_get();
+                break;
+        default:
+                return false;
+        }
+
+        if (region_size == 0) {
+                return false;
+        }
+
+        if (base == NULL) {
+                base = (void *)region_base;
+                size = region_size;
+        }
+
+#ifdef DEBUG
+        assert(ADDRESS_STRIP(base) >= ADDRESS_STRIP(region_base));
+        assert((ADDRESS_STRIP(base) + size) <=
+               (ADDRESS_STRIP(region_base) + region_size));
+#endif /* DEBUG */
+
+        *pool = tlsf_create_with_pool(base, size);
+
+        if (*pool == NULL) {
+                return false;
+        }
+
+        _regions[heap].start = ADDRESS_STRIP(base);
+        _regions[heap].end = ADDRESS_STRIP(base) + size;
+
+        return true;
+}
+
+bool
+mm_heap_available(mm_heap_t heap)
+{
+        if (heap == MM_HEAP_HWRAM) {
+                return true;
+        }
+
+        tlsf_t * const pool = _pool_get(heap);
+
+        return ((pool != NULL) && (*pool != NULL));
+}
+
+mm_heap_t
+mm_heap_get(const void *ptr)
+{
+        const uint32_t address = ADDRESS_STRIP(ptr);
+
+        for (uint32_t heap = MM_HEAP_LWRAM; heap < MM_HEAP_COUNT; heap++) {
+                if ((address >= _regions[heap].start) &&
+                    (address < _regions[heap].end)) {
+                        return heap;
+                }
+        }
+
+        return MM_HEAP_HWRAM;
+}
+
+void *
+mm_heap_malloc(mm_heap_t heap, size_t n)
+{
+        if (heap == MM_HEAP_HWRAM) {
+                return malloc(n);
+        }
+
+        assert(mm_heap_available(heap));
+
+        void *ret;
+        ret = tlsf_malloc(*_pool_get(heap), n);
+
+        _internal_mm_stats_alloc(_pool_index_get(heap), ret);
+
+        return ret;
+}
+
+void *
+mm_heap_memalign(mm_heap_t heap, size_t n, size_t align)
+{
+        if (heap == MM_HEAP_HWRAM) {
+                return memalign(n, align);
+        }
+
+        assert(mm_heap_available(heap));
+
+        void *ret;
+        ret = tlsf_memalign(*_pool_get(heap), align, n);
+
+        _internal_mm_stats_alloc(_pool_index_get(heap), ret);
+
+        return ret;
+}
+
+void *
+mm_heap_realloc(mm_heap_t heap, void *old, size_t new_len)
+{
+        if (heap == MM_HEAP_HWRAM) {
+                return realloc(old, new_len);
+        }
+
+        assert(mm_heap_available(heap));
+        assert((old == NULL) || (mm_heap_get(old) == heap));
+
+        const size_t old_size = _internal_mm_stats_size(old);
+
+        void *ret;
+        ret = tlsf_realloc(*_pool_get(heap), old, new_len);
+
+        _internal_mm_stats_realloc(_pool_index_get(heap), old_size, ret,
+            new_len);
+
+        return ret;
+}
+
+void
+mm_heap_free(void *addr)
+{
+        if (addr == NULL) {
+                return;
+        }
+
+        const mm_heap_t heap = mm_heap_get(addr);
+
+        if (heap == MM_HEAP_HWRAM) {
+                free(addr);
+
+                return;
+        }
+
+        _internal_mm_stats_free(_pool_index_get(heap), addr);
+
+        tlsf_free(*_pool_get(heap), addr);
+}
+
+void *
+mm_malloc(size_t n, mm_hint_t hint)
+{
+        if (hint == MM_HINT_BULK) {
+                static const mm_heap_t heaps[] = {
+                        MM_HEAP_DRAM_CART,
+                        MM_HEAP_LWRAM
+                };
+
+                for (uint32_t i = 0; i < (sizeof(heaps) / sizeof(*heaps)); i++) {
+                        if (!(mm_heap_available(heaps[i]))) {
+                                continue;
+                        }
+
+                        void * const ptr = mm_heap_malloc(heaps[i], n);
+
+                        if (ptr != NULL) {
+                                return ptr;
+                        }
+                }
+        }
+
+        return malloc(n);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _HEAP_H_
+#define _HEAP_H_
+
+#include <sys/cdefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+__BEGIN_DECLS
+
+/// @brief Named heaps.
+typedef enum mm_heap {
+        /// User pool in HWRAM, managed by @ref malloc.
+        MM_HEAP_HWRAM,
+        /// Low work RAM (1MiB).
+        MM_HEAP_LWRAM,
+        /// DRAM cartridge (1MiB or 4MiB).
+        MM_HEAP_DRAM_CART
+} mm_heap_t;
+
+#define MM_HEAP_COUNT           (3)
+
+/// @brief Placement hints.
+typedef enum mm_hint {
+        /// Frequently accessed data. Always placed in HWRAM.
+        MM_HINT_HOT,
+        /// Bulk data, such as assets that are copied elsewhere before use.
+        /// Placed in the DRAM cartridge heap, then the LWRAM heap, then HWRAM,
+        /// in order of availability.
+        MM_HINT_BULK
+} mm_hint_t;
+
+/// @brief Create a heap over a memory region.
+///
+/// @details If @p base is `NULL`, the heap spans the entire region. The HWRAM
+/// heap is always available and can't be initialized.
+///
+/// @returns `false` if the region isn't present (no DRAM cartridge was
+/// detected), or if the heap was already initialized.
+extern bool mm_heap_init(mm_heap_t, void *, size_t);
+
+/// @brief Returns `true` if the heap can be allocated from.
+extern bool mm_heap_available(mm_heap_t);
+
+/// @brief Determine which heap @p ptr was allocated from.
+extern mm_heap_t mm_heap_get(const void *);
+
+extern void *mm_heap_malloc(mm_heap_t, size_t);
+extern void *mm_heap_memalign(mm_heap_t, size_t, size_t);
+extern void *mm_heap_realloc(mm_heap_t, void *, size_t);
+
+/// @brief Free a block allocated from any heap.
+extern void mm_heap_free(void *);
+
+/// @brief Allocate from the heap that best matches the placement hint.
+extern void *mm_malloc(size_t, mm_hint_t);
+
+__END_DECLS
+
+#endif /* !_HEAP_H_ */
@@ -36,6 +36,10 @@ _internal_mm_init(void)
 #else
         master_state()->tlsf_pools[TLSF_POOL_USER] = NULL;
 #endif /* MALLOC_IMPL_TLSF */
+
+        /* Created on demand by mm_heap_init() */
+        master_state()->tlsf_pools[TLSF_POOL_LWRAM] = NULL;
+        master_state()->tlsf_pools[TLSF_POOL_DRAM_CART] = NULL;
 }
 
 void *
@@ -47,6 +51,8 @@ _internal_malloc(size_t n)
         void *ret;
         ret = tlsf_malloc(pool, n);
 
+        _internal_mm_stats_alloc(TLSF_POOL_PRIVATE, ret);
+
         return ret;
 }
 
@@ -56,9 +62,13 @@ _internal_realloc(void *old, size_t new_len)
         tlsf_t pool;
         pool = master_state()->tlsf_pools[TLSF_POOL_PRIVATE];
 
+        const size_t old_size = _internal_mm_stats_size(old);
+
         void *ret;
         ret = tlsf_realloc(pool, old, new_len);
 
+        _internal_mm_stats_realloc(TLSF_POOL_PRIVATE, old_size, ret, new_len);
+
         return ret;
 }
 
@@ -71,6 +81,8 @@ _internal_memalign(size_t n, size_t align)
         void *ret;
         ret = tlsf_memalign(pool, n, align);
 
+        _internal_mm_stats_alloc(TLSF_POOL_PRIVATE, ret);
+
         return ret;
 }
 
@@ -80,5 +92,7 @@ _internal_free(void *addr)
         tlsf_t pool;
         pool = master_state()->tlsf_pools[TLSF_POOL_PRIVATE];
 
+        _internal_mm_stats_free(TLSF_POOL_PRIVATE, addr);
+
         tlsf_free(pool, addr);
 }
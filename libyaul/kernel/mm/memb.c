@@ -41,7 +41,12 @@
          ((int8_t *)(ptr) < ((int8_t *)(name)->m_bpool +                       \
              ((name)->m_bnum * (name)->m_bsize))))
 
-static void _incr_block_index(memb_t *);
+/*
+ * Freed unit blocks are linked together through their first word.
+ */
+struct memb_free_block {
+        struct memb_free_block *next;
+};
 
 /*
  * Initialize a block pool MB.
@@ -49,13 +54,7 @@ static void _incr_block_index(memb_t *);
 void
 memb_init(memb_t *mb)
 {
-        uint32_t bidx;
-
-        for (bidx = 0; bidx < mb->m_bnum; bidx++) {
-                mb->m_breftype[bidx] = MEMB_REF_AVAILABLE;
-        }
-
-        mb->m_size = 0;
+        memb_free_all(mb);
 
         (void)memset(mb->m_bpool, 0x00, mb->m_bsize * mb->m_bnum);
 }
@@ -63,6 +62,10 @@ memb_init(memb_t *mb)
 /*-
  * Allocate a unit block from the block pool MB.
  *
+ * Recently freed blocks are allocated first. Otherwise, the next block
+ * that has never been allocated since the last call to memb_free_all()
+ * is used.
+ *
  * If successful, pointer to block is returned. Otherwise NULL is
  * returned for the following cases:
  *
@@ -73,47 +76,31 @@ void *
 memb_alloc(memb_t *mb)
 {
         uint32_t bidx;
-        uint32_t cur_bidx;
         int8_t *block;
 
         if (mb == NULL) {
                 return NULL;
         }
 
-        /* Are we full? */
-        if (mb->m_bidx >= mb->m_bnum) {
-                return NULL;
-        }
-
-        /* Try next-fit method */
-        bidx = mb->m_bidx;
-
-        if (mb->m_breftype[bidx] == MEMB_REF_AVAILABLE) {
-                goto allocate;
-        }
-
-        /* Try first-fit method */
-        cur_bidx = mb->m_bidx;
+        if (mb->m_bfree != NULL) {
+                struct memb_free_block * const free_block = mb->m_bfree;
 
-        do {
-                _incr_block_index(mb);
-                bidx = mb->m_bidx;
+                mb->m_bfree = free_block->next;
 
-                if (mb->m_breftype[bidx] == MEMB_REF_AVAILABLE) {
-                        goto allocate;
-                }
-        } while (cur_bidx != bidx);
+                block = (int8_t *)free_block;
+                bidx = ((uint32_t)block - (uint32_t)mb->m_bpool) / mb->m_bsize;
+        } else if (mb->m_bnext < mb->m_bnum) {
+                bidx = mb->m_bnext;
+                block = (int8_t *)mb->m_bpool + (bidx * mb->m_bsize);
 
-        /* No free block was found, so we return NULL to indicate
-         * failure to allocate block. */
-        return NULL;
+                mb->m_bnext++;
+        } else {
+                /* No free block was found, so we return NULL to
+                 * indicate failure to allocate block. */
+                return NULL;
+        }
 
-allocate:
-        block = (int8_t *)mb->m_bpool + (bidx * mb->m_bsize);
         mb->m_breftype[bidx] = MEMB_REF_RESERVED;
-        /* Increase to next block index */
-        _incr_block_index(mb);
-
         mb->m_size++;
 
         return (void *)block;
@@ -123,47 +110,50 @@ allocate:
  * Free the unit block as dirty.
  *
  * If successful, 0 is returned. Otherwise -1 is returned if the
- * address is not within the bounds of the block pool MB.
+ * address does not point to an allocated block of the block pool MB.
  */
 int
 memb_free(memb_t *mb, void *addr)
 {
-        if (mb == NULL) {
+        int32_t bidx;
+        bidx = memb_index(mb, addr);
+
+        if (bidx < 0) {
                 return -1;
         }
 
-        /* Not within bounds. */
-        if (!MEMB_PTR_BOUND(mb, addr)) {
+        if (mb->m_breftype[bidx] == MEMB_REF_AVAILABLE) {
                 return -1;
         }
 
-        int8_t *block;
-        block = (int8_t *)mb->m_bpool;
-
-        /* Walk through the list of blocks and try to find the block to
-         * which the pointer address points to. */
-        uint32_t bidx;
-
-        for (bidx = 0; bidx < mb->m_bnum; bidx++) {
-                if (block == (int8_t *)addr) {
-                        if (mb->m_breftype[bidx] == MEMB_REF_AVAILABLE) {
-                                break;
-                        }
+        mb->m_breftype[bidx] = MEMB_REF_AVAILABLE;
+        mb->m_size--;
 
-                        mb->m_breftype[bidx] = MEMB_REF_AVAILABLE;
-                        mb->m_size--;
+        struct memb_free_block * const free_block = addr;
 
-                        /* Set recently freed block to next block
-                         * index */
-                        mb->m_bidx = (mb->m_size == 0) ? 0 : bidx;
+        free_block->next = mb->m_bfree;
+        mb->m_bfree = free_block;
 
-                        return 0;
-                }
+        return 0;
+}
 
-                block += mb->m_bsize;
+/*
+ * Free all unit blocks of the block pool MB at once. The contents of
+ * the blocks are left as is.
+ */
+void
+memb_free_all(memb_t *mb)
+{
+        if (mb == NULL) {
+                return;
         }
 
-        return -1;
+        (void)memset(mb->m_breftype, MEMB_REF_AVAILABLE,
+            mb->m_bnum * sizeof(memb_ref_type_t));
+
+        mb->m_bfree = NULL;
+        mb->m_bnext = 0;
+        mb->m_size = 0;
 }
 
 /*
@@ -182,6 +172,35 @@ memb_size(memb_t *mb)
         return mb->m_size;
 }
 
+/*
+ * Return the index of the unit block ADDR in the block pool MB.
+ *
+ * If successful, the index is returned. Otherwise -1 is returned if
+ * ADDR does not point to the start of a unit block.
+ */
+int32_t
+memb_index(memb_t *mb, void *addr)
+{
+        if (mb == NULL) {
+                return -1;
+        }
+
+        /* Not within bounds. */
+        if (!MEMB_PTR_BOUND(mb, addr)) {
+                return -1;
+        }
+
+        const uint32_t offset = (uint32_t)addr - (uint32_t)mb->m_bpool;
+        const uint32_t bidx = offset / mb->m_bsize;
+
+        /* Not at the start of a unit block */
+        if ((bidx * mb->m_bsize) != offset) {
+                return -1;
+        }
+
+        return bidx;
+}
+
 /*
  * Determine if ADDR is within bounds of the block pool MB. Otherwise 0
  * is returned.
@@ -192,13 +211,3 @@ memb_bounds(memb_t *mb, void *addr)
 {
         return MEMB_PTR_BOUND(mb, addr);
 }
-
-static inline void __always_inline
-_incr_block_index(memb_t *mb)
-{
-        if (mb->m_bidx >= (mb->m_bnum - 1)) {
-                mb->m_bidx = 0;
-        }
-
-        mb->m_bidx++;
-}
@@ -33,6 +33,7 @@
 
 #include <sys/cdefs.h>
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -40,8 +41,14 @@ __BEGIN_DECLS
 
 /*
  * Statically declare a block pool.
+ *
+ * Free blocks are linked together through their first word, so the size of
+ * STRUCTURE must be a non-zero multiple of the size of a pointer.
  */
 #define MEMB(name, structure, num, align)                                      \
+static_assert((sizeof(structure) >= sizeof(void *)) &&                         \
+              ((sizeof(structure) % sizeof(void *)) == 0));                    \
+                                                                               \
 static enum memb_ref_type __CONCAT(name, _memb_refcnt)[(num)] __unused;        \
                                                                                \
 static __aligned(((align) <= 0) ? 4 : (align))                                 \
@@ -51,6 +58,7 @@ static memb_t name __unused = {                                                \
         sizeof(structure),                                                     \
         num,                                                                   \
         &__CONCAT(name, _memb_refcnt)[0],                                      \
+        NULL,                                                                  \
         0,                                                                     \
         0,                                                                     \
         (void *)&__CONCAT(name, _memb_mem)[0]                                  \
@@ -65,7 +73,8 @@ typedef struct memb {
         uint32_t m_bsize; /* Size (in bytes) of a unit block */
         uint32_t m_bnum; /* Number of unit blocks in the block pool */
         memb_ref_type_t *m_breftype; /* Reference type array */
-        uint32_t m_bidx; /* Index to next unreferenced block */
+        void *m_bfree; /* Head of the list of freed unit blocks */
+        uint32_t m_bnext; /* Index to the first never allocated block */
         uint32_t m_size; /* Number of allocated unit blocks */
         void *m_bpool;
 } memb_t;
@@ -73,7 +82,9 @@ typedef struct memb {
 void memb_init(memb_t *);
 void *memb_alloc(memb_t *);
 int memb_free(memb_t *, void *);
+void memb_free_all(memb_t *);
 int32_t memb_size(memb_t *);
+int32_t memb_index(memb_t *, void *);
 bool memb_bounds(memb_t *, void *);
 
 __END_DECLS
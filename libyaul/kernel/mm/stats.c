@@ -0,0 +1,300 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <cpu/intc.h>
+
+#include <dbgio.h>
+
+#include <mm/stats.h>
+#include <mm/tlsf.h>
+
+#include <internal.h>
+
+static_assert(MM_STATS_POOL_PRIVATE == TLSF_POOL_PRIVATE);
+static_assert(MM_STATS_POOL_USER == TLSF_POOL_USER);
+static_assert(MM_STATS_POOL_LWRAM == TLSF_POOL_LWRAM);
+static_assert(MM_STATS_POOL_DRAM_CART == TLSF_POOL_DRAM_CART);
+static_assert(MM_STATS_POOL_COUNT == TLSF_POOL_COUNT);
+
+struct pool_counters {
+        size_t used_size;
+        size_t peak_used_size;
+        uint32_t alloc_calls;
+        uint32_t free_calls;
+        uint32_t fail_calls;
+};
+
+static struct {
+        struct pool_counters pools[MM_STATS_POOL_COUNT];
+
+        mm_stats_tag_t tags[MM_STATS_TAG_COUNT];
+        uint32_t tag_count;
+        mm_stats_tag_t *tag;
+} _state;
+
+static const char *_pool_names[] = {
+        "private",
+        "user",
+        "lwram",
+        "dram-cart"
+};
+
+static void _alloc_count(struct pool_counters *, const void *);
+static void _free_count(struct pool_counters *, size_t);
+static void _walker(void *, size_t, int, void *);
+
+bool
+mm_stats_get(mm_stats_pool_t pool_index, mm_stats_t *stats)
+{
+        assert(pool_index < MM_STATS_POOL_COUNT);
+        assert(stats != NULL);
+
+        const tlsf_t pool = master_state()->tlsf_pools[pool_index];
+
+        if (pool == NULL) {
+                return false;
+        }
+
+        (void)memset(stats, 0x00, sizeof(mm_stats_t));
+
+        tlsf_walk_pool(tlsf_get_pool(pool), _walker, stats);
+
+        const struct pool_counters * const counters =
+            &_state.pools[pool_index];
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        stats->peak_used_size = counters->peak_used_size;
+        stats->alloc_calls = counters->alloc_calls;
+        stats->free_calls = counters->free_calls;
+        stats->fail_calls = counters->fail_calls;
+
+        cpu_intc_mask_set(intc_mask);
+
+        return true;
+}
+
+void
+mm_stats_reset(mm_stats_pool_t pool_index)
+{
+        assert(pool_index < MM_STATS_POOL_COUNT);
+
+        struct pool_counters * const counters = &_state.pools[pool_index];
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        counters->peak_used_size = counters->used_size;
+        counters->alloc_calls = 0;
+        counters->free_calls = 0;
+        counters->fail_calls = 0;
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+void
+mm_stats_tag_set(const char *name)
+{
+        if (name == NULL) {
+                _state.tag = NULL;
+
+                return;
+        }
+
+        for (uint32_t i = 0; i < _state.tag_count; i++) {
+                if (_state.tags[i].name == name) {
+                        _state.tag = &_state.tags[i];
+
+                        return;
+                }
+        }
+
+        /* Silently stop tagging when out of tags */
+        if (_state.tag_count == MM_STATS_TAG_COUNT) {
+                _state.tag = NULL;
+
+                return;
+        }
+
+        _state.tag = &_state.tags[_state.tag_count];
+        _state.tag_count++;
+
+        _state.tag->name = name;
+        _state.tag->alloc_calls = 0;
+        _state.tag->alloc_size = 0;
+}
+
+uint32_t
+mm_stats_tags_get(const mm_stats_tag_t **tags)
+{
+        assert(tags != NULL);
+
+        *tags = &_state.tags[0];
+
+        return _state.tag_count;
+}
+
+void
+mm_stats_dump(void)
+{
+        for (uint32_t i = 0; i < MM_STATS_POOL_COUNT; i++) {
+                mm_stats_t stats;
+
+                if (!(mm_stats_get(i, &stats))) {
+                        continue;
+                }
+
+                /* Fragmentation is how much of the free space can't be
+                 * allocated in one block */
+                const uint32_t fragmentation = (stats.free_size == 0)
+                    ? 0
+                    : (100 - ((stats.largest_free_size * 100) / stats.free_size));
+
+                dbgio_printf("%s: used %lu (peak %lu), free %lu "
+                             "(largest %lu, %lu%% frag.)\n"
+                             "  blocks %lu used, %lu free; "
+                             "calls %lu alloc, %lu free, %lu failed\n",
+                    _pool_names[i],
+                    (unsigned long)stats.used_size,
+                    (unsigned long)stats.peak_used_size,
+                    (unsigned long)stats.free_size,
+                    (unsigned long)stats.largest_free_size,
+                    (unsigned long)fragmentation,
+                    (unsigned long)stats.used_count,
+                    (unsigned long)stats.free_count,
+                    (unsigned long)stats.alloc_calls,
+                    (unsigned long)stats.free_calls,
+                    (unsigned long)stats.fail_calls);
+        }
+
+        for (uint32_t i = 0; i < _state.tag_count; i++) {
+                const mm_stats_tag_t * const tag = &_state.tags[i];
+
+                dbgio_printf("  tag %s: %lu allocs, %lu bytes\n",
+                    tag->name,
+                    (unsigned long)tag->alloc_calls,
+                    (unsigned long)tag->alloc_size);
+        }
+}
+
+size_t
+_internal_mm_stats_size(const void *ptr)
+{
+        return (ptr == NULL) ? 0 : tlsf_block_size((void *)ptr);
+}
+
+void
+_internal_mm_stats_alloc(uint32_t pool_index, const void *ptr)
+{
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        _alloc_count(&_state.pools[pool_index], ptr);
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+void
+_internal_mm_stats_free(uint32_t pool_index, const void *ptr)
+{
+        if (ptr == NULL) {
+                return;
+        }
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        _free_count(&_state.pools[pool_index], tlsf_block_size((void *)ptr));
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+/* The old size is zero only when the old pointer is NULL */
+void
+_internal_mm_stats_realloc(uint32_t pool_index, size_t old_size,
+    const void *ptr, size_t new_len)
+{
+        struct pool_counters * const counters = &_state.pools[pool_index];
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        if (old_size == 0) {
+                /* Behaves like malloc(), except that a zero length allocates
+                 * nothing and isn't a failure */
+                if ((ptr != NULL) || (new_len > 0)) {
+                        _alloc_count(counters, ptr);
+                }
+        } else if (new_len == 0) {
+                /* Behaves like free() */
+                _free_count(counters, old_size);
+        } else if (ptr == NULL) {
+                /* The old block is left untouched */
+                counters->fail_calls++;
+        } else {
+                counters->used_size -= old_size;
+
+                _alloc_count(counters, ptr);
+        }
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+static void
+_alloc_count(struct pool_counters *counters, const void *ptr)
+{
+        if (ptr == NULL) {
+                counters->fail_calls++;
+
+                return;
+        }
+
+        const size_t size = tlsf_block_size((void *)ptr);
+
+        counters->alloc_calls++;
+        counters->used_size += size;
+
+        if (counters->used_size > counters->peak_used_size) {
+                counters->peak_used_size = counters->used_size;
+        }
+
+        if (_state.tag != NULL) {
+                _state.tag->alloc_calls++;
+                _state.tag->alloc_size += size;
+        }
+}
+
+static void
+_free_count(struct pool_counters *counters, size_t size)
+{
+        counters->free_calls++;
+        counters->used_size -= size;
+}
+
+static void
+_walker(void *ptr __unused, size_t size, int used, void *work)
+{
+        mm_stats_t * const stats = work;
+
+        if (used) {
+                stats->used_size += size;
+                stats->used_count++;
+
+                return;
+        }
+
+        stats->free_size += size;
+        stats->free_count++;
+
+        if (size > stats->largest_free_size) {
+                stats->largest_free_size = size;
+        }
+}
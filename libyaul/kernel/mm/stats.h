@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _MM_STATS_H_
+#define _MM_STATS_H_
+
+#include <sys/cdefs.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+__BEGIN_DECLS
+
+/// @brief TLSF pools.
+typedef enum mm_stats_pool {
+        /// Private pool used by libyaul.
+        MM_STATS_POOL_PRIVATE,
+        /// User pool in HWRAM, managed by @ref malloc.
+        MM_STATS_POOL_USER,
+        /// LWRAM heap.
+        MM_STATS_POOL_LWRAM,
+        /// DRAM cartridge heap.
+        MM_STATS_POOL_DRAM_CART
+} mm_stats_pool_t;
+
+#define MM_STATS_POOL_COUNT     (4)
+
+/// Maximum number of distinct allocation tags.
+#define MM_STATS_TAG_COUNT      (16)
+
+typedef struct mm_stats {
+        /// Number of bytes in used blocks.
+        size_t used_size;
+        /// Number of bytes in free blocks.
+        size_t free_size;
+        /// Size of the largest free block.
+        size_t largest_free_size;
+        /// Highest number of bytes in used blocks since the last reset.
+        size_t peak_used_size;
+        /// Number of used blocks.
+        uint32_t used_count;
+        /// Number of free blocks.
+        uint32_t free_count;
+        /// Number of successful allocations.
+        uint32_t alloc_calls;
+        /// Number of frees.
+        uint32_t free_calls;
+        /// Number of failed allocations.
+        uint32_t fail_calls;
+} mm_stats_t;
+
+typedef struct mm_stats_tag {
+        /// Tag name. Tags are compared by address.
+        const char *name;
+        /// Number of allocations made with this tag.
+        uint32_t alloc_calls;
+        /// Number of bytes allocated with this tag.
+        size_t alloc_size;
+} mm_stats_tag_t;
+
+/// @brief Obtain the statistics of a pool.
+///
+/// @details The pool is walked to count used and free blocks.
+///
+/// @returns `false` if the pool doesn't exist.
+extern bool mm_stats_get(mm_stats_pool_t, mm_stats_t *);
+
+/// @brief Reset the peak usage and call counters of a pool.
+extern void mm_stats_reset(mm_stats_pool_t);
+
+/// @brief Tag the allocations that follow, in any pool.
+///
+/// @details Pass `NULL` to stop tagging. The tag must be a string literal, or
+/// at least outlive the statistics.
+extern void mm_stats_tag_set(const char *);
+
+/// @brief Obtain the allocation tags. Returns the number of tags.
+extern uint32_t mm_stats_tags_get(const mm_stats_tag_t **);
+
+/// @brief Print the statistics of each pool and tag via @ref dbgio_printf.
+extern void mm_stats_dump(void);
+
+__END_DECLS
+
+#endif /* !_MM_STATS_H_ */
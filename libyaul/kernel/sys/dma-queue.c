@@ -13,6 +13,7 @@
 #include <cpu/registers.h>
 
 #include <sys/dma-queue.h>
+#include <sys/prof.h>
 
 #include <scu-internal.h>
 
@@ -53,6 +54,8 @@ static inline void _queue_request_start(const struct dma_queue_request *) __alwa
 
 static void _dma_illegal_handler(void);
 
+static void _queue_flush_wait(void);
+
 static void _default_handler(const dma_queue_transfer_t *);
 
 static struct dma_queue_request _dma_queue_request_pools[DMA_QUEUE_TAG_COUNT][DMA_QUEUE_REQUESTS_MAX_COUNT];
@@ -329,6 +332,16 @@ exit:
 
 void
 dma_queue_flush_wait(void)
+{
+        prof_zone_begin(PROF_ZONE_DMA_QUEUE);
+
+        _queue_flush_wait();
+
+        prof_zone_end(PROF_ZONE_DMA_QUEUE);
+}
+
+static void
+_queue_flush_wait(void)
 {
         while (true) {
                 if (_state.current_tag == DMA_QUEUE_TAG_INVALID) {
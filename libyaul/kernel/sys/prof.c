@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <dbgio.h>
+
+#include <sys/prof.h>
+
+/* Width of the bar graph (in characters) for a whole frame */
+#define BAR_WIDTH       (24)
+
+struct prof_aggregate {
+        uint32_t min_ticks;
+        uint32_t max_ticks;
+        uint32_t sum_ticks;
+        uint32_t sum_calls;
+};
+
+bool _internal_prof_enabled = false;
+volatile uint16_t _internal_prof_overflow_count = 0;
+prof_counter_t _internal_prof_counters[PROF_ZONE_COUNT_MAX];
+
+static struct {
+        uint16_t count_1ms;
+        uint16_t frame_count;
+        uint32_t frame_start;
+
+        struct prof_aggregate aggregates[PROF_ZONE_COUNT_MAX];
+        prof_zone_t zones[PROF_ZONE_COUNT_MAX];
+} _state;
+
+static const char *_builtin_zone_names[] = {
+        "frame",
+        "vdp-sync",
+        "dma-queue",
+        "s3d-xform",
+        "s3d-finish"
+};
+
+static_assert((sizeof(_builtin_zone_names) / sizeof(*_builtin_zone_names)) ==
+    PROF_ZONE_USER);
+
+static void _aggregates_reset(void);
+static void _frt_ovi_handler(void);
+static uint32_t _ticks_convert(uint32_t ticks);
+
+void
+prof_init(uint16_t count_1ms)
+{
+        assert(count_1ms > 0);
+
+        _internal_prof_enabled = false;
+
+        (void)memset(&_internal_prof_counters[0], 0x00,
+            sizeof(_internal_prof_counters));
+        (void)memset(&_state.zones[0], 0x00, sizeof(_state.zones));
+
+        for (uint32_t i = 0; i < PROF_ZONE_USER; i++) {
+                _state.zones[i].name = _builtin_zone_names[i];
+        }
+
+        _aggregates_reset();
+
+        _state.count_1ms = count_1ms;
+
+        _internal_prof_overflow_count = 0;
+
+        cpu_frt_ovi_set(_frt_ovi_handler);
+
+        _state.frame_start = prof_ticks_get();
+
+        _internal_prof_enabled = true;
+}
+
+void
+prof_deinit(void)
+{
+        _internal_prof_enabled = false;
+
+        cpu_frt_ovi_clear();
+}
+
+void
+prof_zone_name_set(prof_zone_id_t id, const char *name)
+{
+        assert(id < PROF_ZONE_COUNT_MAX);
+
+        _state.zones[id].name = name;
+}
+
+void
+prof_frame_end(void)
+{
+        if (!_internal_prof_enabled) {
+                return;
+        }
+
+        const uint32_t frame_end = prof_ticks_get();
+
+        prof_counter_t * const frame_counter =
+            &_internal_prof_counters[PROF_ZONE_FRAME];
+
+        frame_counter->ticks = frame_end - _state.frame_start;
+        frame_counter->calls = 1;
+
+        _state.frame_start = frame_end;
+
+        for (uint32_t i = 0; i < PROF_ZONE_COUNT_MAX; i++) {
+                prof_counter_t * const counter = &_internal_prof_counters[i];
+                struct prof_aggregate * const aggregate = &_state.aggregates[i];
+
+                if (counter->ticks < aggregate->min_ticks) {
+                        aggregate->min_ticks = counter->ticks;
+                }
+
+                if (counter->ticks > aggregate->max_ticks) {
+                        aggregate->max_ticks = counter->ticks;
+                }
+
+                aggregate->sum_ticks += counter->ticks;
+                aggregate->sum_calls += counter->calls;
+
+                counter->ticks = 0;
+                counter->calls = 0;
+        }
+
+        _state.frame_count++;
+
+        if (_state.frame_count < PROF_FRAME_COUNT) {
+                return;
+        }
+
+        for (uint32_t i = 0; i < PROF_ZONE_COUNT_MAX; i++) {
+                const struct prof_aggregate * const aggregate =
+                    &_state.aggregates[i];
+                prof_zone_t * const zone = &_state.zones[i];
+
+                zone->min = _ticks_convert(aggregate->min_ticks);
+                zone->avg = _ticks_convert(aggregate->sum_ticks / PROF_FRAME_COUNT);
+                zone->max = _ticks_convert(aggregate->max_ticks);
+                zone->calls = aggregate->sum_calls / PROF_FRAME_COUNT;
+        }
+
+        _aggregates_reset();
+}
+
+uint32_t
+prof_zones_get(const prof_zone_t **zones)
+{
+        assert(zones != NULL);
+
+        *zones = &_state.zones[0];
+
+        return PROF_ZONE_COUNT_MAX;
+}
+
+void
+prof_dump(void)
+{
+        const uint32_t frame_avg = _state.zones[PROF_ZONE_FRAME].avg;
+
+        dbgio_printf("zone          min   avg   max (us)\n");
+
+        for (uint32_t i = 0; i < PROF_ZONE_COUNT_MAX; i++) {
+                const prof_zone_t * const zone = &_state.zones[i];
+
+                if (zone->name == NULL) {
+                        continue;
+                }
+
+                char bar[BAR_WIDTH + 1];
+
+                uint32_t bar_length;
+                bar_length = 0;
+
+                if (frame_avg > 0) {
+                        bar_length = (zone->avg * BAR_WIDTH) / frame_avg;
+                }
+
+                if (bar_length > BAR_WIDTH) {
+                        bar_length = BAR_WIDTH;
+                }
+
+                (void)memset(&bar[0], '#', bar_length);
+                (void)memset(&bar[bar_length], '.', BAR_WIDTH - bar_length);
+                bar[BAR_WIDTH] = '\0';
+
+                dbgio_printf("%-10s %6lu%6lu%6lu x%lu\n"
+                             "  [%s]\n",
+                    zone->name,
+                    (unsigned long)zone->min,
+                    (unsigned long)zone->avg,
+                    (unsigned long)zone->max,
+                    (unsigned long)zone->calls,
+                    bar);
+        }
+}
+
+static void
+_aggregates_reset(void)
+{
+        _state.frame_count = 0;
+
+        for (uint32_t i = 0; i < PROF_ZONE_COUNT_MAX; i++) {
+                struct prof_aggregate * const aggregate = &_state.aggregates[i];
+
+                aggregate->min_ticks = UINT32_MAX;
+                aggregate->max_ticks = 0;
+                aggregate->sum_ticks = 0;
+                aggregate->sum_calls = 0;
+        }
+}
+
+static void
+_frt_ovi_handler(void)
+{
+        _internal_prof_overflow_count++;
+}
+
+static uint32_t
+_ticks_convert(uint32_t ticks)
+{
+        const uint32_t ms = ticks / _state.count_1ms;
+        const uint32_t remainder = ticks % _state.count_1ms;
+
+        /* Avoid overflowing when converting long zones */
+        return (ms * 1000) + ((remainder * 1000) / _state.count_1ms);
+}
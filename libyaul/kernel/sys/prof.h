@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _PROF_H_
+#define _PROF_H_
+
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <cpu/frt.h>
+#include <cpu/intc.h>
+#include <cpu/map.h>
+
+__BEGIN_DECLS
+
+/// Maximum number of zones, including the built-in zones.
+#define PROF_ZONE_COUNT_MAX     (16)
+
+/// Number of frames the zone timings are aggregated over.
+#define PROF_FRAME_COUNT        (60)
+
+/// @brief Built-in zones.
+///
+/// @details User zones start at @ref PROF_ZONE_USER.
+typedef enum prof_zone_id {
+        /// Time between two calls to @ref prof_frame_end.
+        PROF_ZONE_FRAME,
+        /// Time spent in @ref vdp_sync.
+        PROF_ZONE_VDP_SYNC,
+        /// Time spent waiting for the DMA queue to flush.
+        PROF_ZONE_DMA_QUEUE,
+        /// Time spent in @ref sega3d_object_transform.
+        PROF_ZONE_SEGA3D_TRANSFORM,
+        /// Time spent in @ref sega3d_finish.
+        PROF_ZONE_SEGA3D_FINISH,
+        /// First user zone.
+        PROF_ZONE_USER
+} prof_zone_id_t;
+
+/// @brief Zone timings, in microseconds per frame.
+typedef struct prof_zone {
+        const char *name;
+        uint32_t min;
+        uint32_t avg;
+        uint32_t max;
+        /// Average number of times the zone was entered per frame.
+        uint16_t calls;
+} prof_zone_t;
+
+/// @brief Per-frame zone counters.
+///
+/// @details Only to be accessed by @ref prof_zone_begin and
+/// @ref prof_zone_end.
+typedef struct prof_counter {
+        uint32_t ticks;
+        uint32_t start;
+        uint16_t calls;
+} prof_counter_t;
+
+/// @brief Start profiling.
+///
+/// @details The CPU FRT is left running with the clock divisor in effect
+/// (@ref CPU_FRT_CLOCK_DIV_8 by default), as other timings, such as the
+/// @ref vdp_sync statistics, depend on it. In turn, @p count_1ms is the number
+/// of FRT ticks in 1ms for that divisor and the current resolution, e.g.
+/// @ref CPU_FRT_NTSC_320_8_COUNT_1MS.
+///
+/// The profiler takes over the CPU FRT OVI interrupt to count the number of
+/// times the FRT wraps around, so zones may last longer than a wrap.
+extern void prof_init(uint16_t count_1ms);
+
+/// @brief Stop profiling.
+extern void prof_deinit(void);
+
+/// @brief Set the name of a zone.
+///
+/// @details The name must be a string literal, or at least outlive the
+/// profiler.
+extern void prof_zone_name_set(prof_zone_id_t id, const char *name);
+
+/// @brief Returns `true` if profiling.
+static inline bool __always_inline
+prof_enabled(void)
+{
+        extern bool _internal_prof_enabled;
+
+        return _internal_prof_enabled;
+}
+
+/// @brief Returns the FRT tick count, extended to 32 bits by the number of
+/// times the FRT wrapped around.
+static inline uint32_t __always_inline
+prof_ticks_get(void)
+{
+        extern volatile uint16_t _internal_prof_overflow_count;
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        uint32_t overflow_count;
+        overflow_count = _internal_prof_overflow_count;
+
+        const uint16_t count = cpu_frt_count_get();
+
+        /* The FRT may have wrapped around after interrupts were masked, but
+         * before the count was read */
+        if (((MEMORY_READ(8, CPU(FTCSR)) & 0x02) != 0x00) && (count < 0x8000)) {
+                overflow_count++;
+        }
+
+        cpu_intc_mask_set(intc_mask);
+
+        return (overflow_count << 16) | count;
+}
+
+/// @brief Enter a zone.
+///
+/// @details A zone can be entered more than once per frame, but it can't be
+/// nested within itself.
+static inline void __always_inline
+prof_zone_begin(prof_zone_id_t id)
+{
+        extern prof_counter_t _internal_prof_counters[];
+
+        if (!(prof_enabled())) {
+                return;
+        }
+
+        _internal_prof_counters[id].start = prof_ticks_get();
+}
+
+/// @brief Leave a zone.
+static inline void __always_inline
+prof_zone_end(prof_zone_id_t id)
+{
+        extern prof_counter_t _internal_prof_counters[];
+
+        if (!(prof_enabled())) {
+                return;
+        }
+
+        prof_counter_t * const counter = &_internal_prof_counters[id];
+
+        counter->ticks += prof_ticks_get() - counter->start;
+        counter->calls++;
+}
+
+/// @brief Accumulate the timings of the frame.
+///
+/// @details Called at the end of @ref vdp_sync. Every @ref PROF_FRAME_COUNT
+/// frames, the minimum, average, and maximum timings of each zone are
+/// published.
+extern void prof_frame_end(void);
+
+/// @brief Obtain the last published timings. Returns the number of zones.
+extern uint32_t prof_zones_get(const prof_zone_t **zones);
+
+/// @brief Print the last published timings via @ref dbgio_printf.
+///
+/// @details Each zone is drawn as a bar relative to the length of a frame.
+/// The output goes to whichever dbgio device is set, either the VDP2 overlay or
+/// the USB cartridge.
+extern void prof_dump(void);
+
+__END_DECLS
+
+#endif /* !_PROF_H_ */
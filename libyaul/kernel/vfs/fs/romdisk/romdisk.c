@@ -11,6 +11,8 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include <mm/memb.h>
+
 #include "romdisk.h"
 
 #include <internal.h>
@@ -25,24 +27,30 @@
 #define TYPE_BLOCK_DEVICE       4
 #define TYPE_CHAR_DEVICE        5
 
+/* Path index written by genromfs -i */
+#define INDEX_NAME              ".romfs-index"
+#define INDEX_MAGIC             "-rom1ix-"
+
+/* 32-bit FNV-1a */
+#define FNV_OFFSET              0x811C9DC5
+#define FNV_PRIME               0x01000193
+
 #define IS_TYPE(x)              ((x) & 0x03)
 #define TYPE_GET(x)             ((x) & 0x0F)
 
 #define HEADER
 
-struct rd_file_handle;
-
-TAILQ_HEAD(rd_file, rd_file_handle);
-
 struct rd_file_handle {
-        struct rd_file *rdh;
         uint32_t index;         /* ROMFS image index */
         bool dir;               /* If a directory */
         int32_t ptr;            /* Current read position in bytes */
         size_t len;             /* Length of file in bytes */
         void *mnt;              /* Which mount instance are we using? */
-
-        TAILQ_ENTRY(rd_file_handle) handles;
+        size_t size;            /* Size of the file data in the image */
+        const uint8_t *data;    /* Uncompressed data, NULL while decoding */
+        uint8_t *cache;         /* Decompressed copy of the file */
+        void *stream;           /* Decoder, while reading in order */
+        int32_t stream_ptr;     /* Bytes read out of the decoder */
 };
 
 struct romdisk_hdr {
@@ -63,26 +71,56 @@ struct romdisk_file {
         char filename[16];      /* File name (zero-terminated) */
 };
 
+struct romdisk_index_entry {
+        uint32_t hash;          /* Hash of the path */
+        uint32_t offset;        /* Offset of the file header, or zero */
+        uint32_t path;          /* Offset of the path in the index */
+};
+
+/* Hash table of the paths of all regular files, followed by the paths */
+struct romdisk_index {
+        char magic[8];          /* Should be "-rom1ix-" */
+        uint32_t count;         /* Number of entries (a power of 2) */
+        uint32_t reserved;
+        struct romdisk_index_entry entries[];
+};
+
 struct rd_image {
         const uint8_t *image;   /* The actual image */
         const struct romdisk_hdr *hdr; /* Pointer to the header */
         uint32_t files;         /* Offset in the image to the files area */
+        const struct romdisk_index *index; /* Path index, if any */
 };
 
+static int romdisk_compressed_open(struct rd_file_handle *);
+static int romdisk_cache_fill(struct rd_file_handle *);
+
+static const struct romdisk_index *romdisk_index_get(struct rd_image *);
+static uint32_t romdisk_index_find(struct rd_image *, const char *);
+static bool romdisk_index_match(const char *, const char *);
+
 static uint32_t romdisk_find(struct rd_image *, const char *, bool);
 static uint32_t romdisk_find_object(struct rd_image *, const char *, size_t, bool,
     uint32_t);
 
-/* XXX Provisional */
 static struct rd_file_handle *romdisk_fd_alloc(void);
 static void romdisk_fd_free(struct rd_file_handle *);
-/* XXX Provisional */
-static struct rd_file fhs;
+
+/* Open files, across all mounts */
+MEMB(fh_pool, struct rd_file_handle, MAX_RD_FILES, 4);
+
+static const romdisk_decompressor_t *decompressor = NULL;
 
 void
 romdisk_init(void)
 {
-        TAILQ_INIT(&fhs);
+        memb_init(&fh_pool);
+}
+
+void
+romdisk_decompressor_set(const romdisk_decompressor_t *d)
+{
+        decompressor = d;
 }
 
 void *
@@ -105,6 +143,7 @@ romdisk_mount(const char *mnt_point __unused,
         mnt->hdr = hdr;
         mnt->files = sizeof(struct romdisk_hdr) +
             ((strlen(hdr->volume_name) >> 4) << 4);
+        mnt->index = romdisk_index_get(mnt);
 
         return mnt;
 }
@@ -132,12 +171,25 @@ romdisk_open(void *p, const char *fn)
                 return NULL;
         }
 
-        fh->rdh = &fhs;
-        fh->index = f_idx + mnt->files;
+        /* The data follows the header and the file name, padded to 16
+         * bytes */
+        fh->index = f_idx + 16 + ((strlen(f_hdr->filename) + 16) & ~15);
         fh->dir = directory;
         fh->ptr = 0;
         fh->len = f_hdr->size;
         fh->mnt = mnt;
+        fh->size = f_hdr->size;
+        fh->data = mnt->image + fh->index;
+        fh->cache = NULL;
+        fh->stream = NULL;
+        fh->stream_ptr = 0;
+
+        if ((f_hdr->spec_info & ROMDISK_SPEC_COMPRESSED) != 0) {
+                if ((romdisk_compressed_open(fh)) < 0) {
+                        romdisk_fd_free(fh);
+                        return NULL;
+                }
+        }
 
         return fh;
 }
@@ -152,11 +204,9 @@ ssize_t
 romdisk_read(void *p, void *buf, size_t bytes)
 {
         struct rd_file_handle *fh;
-        struct rd_image *mnt;
         uint8_t *ofs;
 
         fh = (struct rd_file_handle *)p;
-        mnt = (struct rd_image *)fh->mnt;
 
         /* Sanity checks */
         if ((fh == NULL) || (fh->index == 0)) {
@@ -176,7 +226,28 @@ romdisk_read(void *p, void *buf, size_t bytes)
                 bytes = fh->len - fh->ptr;
         }
 
-        ofs = (uint8_t *)(mnt->image + fh->index + fh->ptr);
+        if (fh->data == NULL) {
+                /* The decoder can only go forward from where it is */
+                if (fh->ptr == fh->stream_ptr) {
+                        ssize_t ret;
+                        ret = decompressor->stream_read(fh->stream, buf, bytes);
+
+                        if (ret < 0) {
+                                return -1;
+                        }
+
+                        fh->ptr += ret;
+                        fh->stream_ptr += ret;
+
+                        return ret;
+                }
+
+                if ((romdisk_cache_fill(fh)) < 0) {
+                        return -1;
+                }
+        }
+
+        ofs = (uint8_t *)(fh->data + fh->ptr);
         memcpy(buf, ofs, bytes);
         fh->ptr += bytes;
 
@@ -187,10 +258,8 @@ void *
 romdisk_direct(void *p)
 {
         struct rd_file_handle *fh;
-        struct rd_image *mnt;
 
         fh = (struct rd_file_handle *)p;
-        mnt = (struct rd_image *)fh->mnt;
 
         /* Sanity checks */
         if ((fh == NULL) || (fh->index == 0)) {
@@ -205,7 +274,57 @@ romdisk_direct(void *p)
                 return NULL;
         }
 
-        return (void *)(mnt->image + fh->index);
+        if (fh->data == NULL) {
+                if ((romdisk_cache_fill(fh)) < 0) {
+                        return NULL;
+                }
+        }
+
+        return (void *)fh->data;
+}
+
+/* Same as romdisk_direct(), but bounded to a range of the file. As the data
+ * is not copied, the view can be used as the source of a DMA transfer. The
+ * data of files that are not compressed is aligned as given to genromfs -a */
+int
+romdisk_view(void *p, off_t offset, size_t size, romdisk_view_t *view)
+{
+        struct rd_file_handle *fh;
+
+        fh = (struct rd_file_handle *)p;
+
+        /* Sanity checks */
+        if ((fh == NULL) || (fh->index == 0)) {
+                /* Not a valid file descriptor or is not open for
+                 * reading */
+                /* errno = EBADF; */
+                return -1;
+        }
+
+        if (fh->dir) {
+                /* errno = EISDIR; */
+                return -1;
+        }
+
+        if ((view == NULL) || (offset < 0) || ((size_t)offset > fh->len)) {
+                /* errno = EINVAL; */
+                return -1;
+        }
+
+        if ((view->data = romdisk_direct(fh)) == NULL) {
+                return -1;
+        }
+
+        /* Is there enough left? Compare against what's left so that a
+         * large size can't overflow */
+        if (size > (fh->len - offset)) {
+                size = fh->len - offset;
+        }
+
+        view->data = (const uint8_t *)view->data + offset;
+        view->size = size;
+
+        return 0;
 }
 
 off_t
@@ -301,6 +420,65 @@ romdisk_total(void *p)
         return fh->len;
 }
 
+static int
+romdisk_compressed_open(struct rd_file_handle *fh)
+{
+        if (decompressor == NULL) {
+                return -1;
+        }
+
+        ssize_t len;
+        len = decompressor->size_get(fh->data, fh->size);
+
+        if (len < 0) {
+                return -1;
+        }
+
+        fh->len = len;
+
+        if (decompressor->stream_open != NULL) {
+                fh->stream = decompressor->stream_open(fh->data, fh->size);
+        }
+
+        if (fh->stream != NULL) {
+                fh->data = NULL;
+
+                return 0;
+        }
+
+        return romdisk_cache_fill(fh);
+}
+
+/* Decompress the whole file, so that it can be read from anywhere */
+static int
+romdisk_cache_fill(struct rd_file_handle *fh)
+{
+        const struct rd_image *mnt;
+        mnt = (const struct rd_image *)fh->mnt;
+
+        if (fh->stream != NULL) {
+                decompressor->stream_close(fh->stream);
+                fh->stream = NULL;
+        }
+
+        /* Avoid asking for zero bytes */
+        if ((fh->cache = _internal_malloc(fh->len + 1)) == NULL) {
+                return -1;
+        }
+
+        if ((decompressor->decompress(mnt->image + fh->index, fh->cache,
+                    fh->len)) != (ssize_t)fh->len) {
+                _internal_free(fh->cache);
+                fh->cache = NULL;
+
+                return -1;
+        }
+
+        fh->data = fh->cache;
+
+        return 0;
+}
+
 /* Given a file name and a starting ROMDISK directory listing (byte
  * offset), search for the entry in the directory and return the byte
  * offset to its entry */
@@ -347,6 +525,122 @@ romdisk_find_object(struct rd_image *mnt, const char *fn, size_t fn_len, bool di
         return 0;
 }
 
+static const struct romdisk_index *
+romdisk_index_get(struct rd_image *mnt)
+{
+        const struct romdisk_index *index;
+        const struct romdisk_file *f_hdr;
+        uint32_t ofs;
+
+        ofs = romdisk_find_object(mnt, INDEX_NAME, strlen(INDEX_NAME),
+            /* directory = */ false, mnt->files);
+
+        if (ofs == 0) {
+                return NULL;
+        }
+
+        f_hdr = (const struct romdisk_file *)(mnt->image + ofs);
+
+        /* The data follows the header and the file name, padded to 16
+         * bytes */
+        index = (const struct romdisk_index *)(mnt->image + ofs + 16 +
+            ((strlen(f_hdr->filename) + 16) & ~15));
+
+        if ((strncmp(index->magic, INDEX_MAGIC, 8)) != 0) {
+                return NULL;
+        }
+
+        return index;
+}
+
+/* Look the path up in the index, the way romdisk_find() would: leading,
+ * and repeated slashes are ignored */
+static uint32_t
+romdisk_index_find(struct rd_image *mnt, const char *fn)
+{
+        const struct romdisk_index *index;
+        const struct romdisk_index_entry *entry;
+        const char *fn_cur;
+        uint32_t hash;
+        uint32_t mask;
+        uint32_t i;
+        bool separator;
+        bool empty;
+
+        index = mnt->index;
+        hash = FNV_OFFSET;
+        separator = false;
+        empty = true;
+
+        for (fn_cur = fn; *fn_cur != '\0'; fn_cur++) {
+                if (*fn_cur == '/') {
+                        separator = !empty;
+                        continue;
+                }
+
+                if (separator) {
+                        hash = (hash ^ '/') * FNV_PRIME;
+                        separator = false;
+                }
+
+                hash = (hash ^ (uint8_t)*fn_cur) * FNV_PRIME;
+                empty = false;
+        }
+
+        /* Only files are in the index */
+        if (empty || separator) {
+                return 0;
+        }
+
+        mask = index->count - 1;
+
+        for (i = hash & mask; ; i = (i + 1) & mask) {
+                entry = &index->entries[i];
+
+                if (entry->offset == 0) {
+                        return 0;
+                }
+
+                if ((entry->hash == hash) &&
+                    romdisk_index_match((const char *)index + entry->path, fn)) {
+                        return entry->offset;
+                }
+        }
+}
+
+static bool
+romdisk_index_match(const char *path, const char *fn)
+{
+        bool separator;
+        bool empty;
+
+        separator = false;
+        empty = true;
+
+        for (; *fn != '\0'; fn++) {
+                if (*fn == '/') {
+                        separator = !empty;
+                        continue;
+                }
+
+                if (separator) {
+                        if (*path++ != '/') {
+                                return false;
+                        }
+
+                        separator = false;
+                }
+
+                if (*path++ != *fn) {
+                        return false;
+                }
+
+                empty = false;
+        }
+
+        return (*path == '\0');
+}
+
 static uint32_t
 romdisk_find(struct rd_image *mnt, const char *fn, bool directory)
 {
@@ -355,6 +649,10 @@ romdisk_find(struct rd_image *mnt, const char *fn, bool directory)
         int fn_len;
         const struct romdisk_file *f_hdr;
 
+        if ((mnt->index != NULL) && !directory) {
+                return romdisk_index_find(mnt, fn);
+        }
+
         fn_cur = NULL;
         ofs = mnt->files;
 
@@ -386,41 +684,34 @@ romdisk_find(struct rd_image *mnt, const char *fn, bool directory)
 static struct rd_file_handle *
 romdisk_fd_alloc(void)
 {
-        struct rd_file_handle *fh;
-        fh = (struct rd_file_handle *)_internal_malloc(sizeof(struct rd_file_handle));
-
-        if (fh == NULL) {
-                return NULL;
-        }
-
-        TAILQ_INSERT_TAIL(&fhs, fh, handles);
-
-        return fh;
+        return memb_alloc(&fh_pool);
 }
 
 static void
-romdisk_fd_free(struct rd_file_handle *fd)
+romdisk_fd_free(struct rd_file_handle *fh)
 {
-        if (fd == NULL) {
+        if (fh == NULL) {
                 return;
         }
 
-        struct rd_file_handle *fh;
+        /* Not a handle at all */
+        if ((memb_index(&fh_pool, fh)) < 0) {
+                return;
+        }
 
-        bool fd_match;
-        fd_match = false;
+        void * const stream = fh->stream;
+        uint8_t * const cache = fh->cache;
 
-        TAILQ_FOREACH (fh, &fhs, handles) {
-                if (fh == fd) {
-                        fd_match = true;
-                        break;
-                }
+        /* Not a handle that's open */
+        if ((memb_free(&fh_pool, fh)) < 0) {
+                return;
         }
 
-        if (!fd_match) {
-                return;
+        if (stream != NULL) {
+                decompressor->stream_close(stream);
         }
 
-        TAILQ_REMOVE(&fhs, fh, handles);
-        _internal_free(fh);
+        if (cache != NULL) {
+                _internal_free(cache);
+        }
 }
@@ -20,12 +20,43 @@
 
 __BEGIN_DECLS
 
+/* Set in the spec info of regular files whose data is compressed */
+#define ROMDISK_SPEC_COMPRESSED 0x00000001
+
+/*
+ * Decodes the data of compressed files, which are otherwise not opened.
+ *
+ * size_get() returns the uncompressed size of the data, or -1 if the data
+ * is not valid. decompress() decodes all of the data into a buffer, and
+ * returns the number of bytes written, or -1.
+ *
+ * The stream functions are optional. When stream_open() does not return
+ * NULL, the file is decoded as it is read in order, without having to hold
+ * all of it in memory. Otherwise, the file is decoded once when it's
+ * opened.
+ */
+typedef struct romdisk_decompressor {
+        ssize_t (*size_get)(const void *, size_t);
+        ssize_t (*decompress)(const void *, void *, size_t);
+        void *(*stream_open)(const void *, size_t);
+        ssize_t (*stream_read)(void *, void *, size_t);
+        void (*stream_close)(void *);
+} romdisk_decompressor_t;
+
+/* A range of the data of a file, where it lies in memory */
+typedef struct romdisk_view {
+        const void *data;
+        size_t size;
+} romdisk_view_t;
+
 void romdisk_init(void);
+void romdisk_decompressor_set(const romdisk_decompressor_t *);
 void *romdisk_mount(const char *, const uint8_t *);
 void *romdisk_open(void *, const char *);
 void romdisk_close(void *);
 ssize_t romdisk_read(void *, void *, size_t);
 void *romdisk_direct(void *);
+int romdisk_view(void *, off_t, size_t, romdisk_view_t *);
 off_t romdisk_seek(void *, off_t, int);
 off_t romdisk_tell(void *);
 size_t romdisk_total(void *);
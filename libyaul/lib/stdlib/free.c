@@ -13,6 +13,8 @@ free(void *addr __unused) /* Keep as __unused */
         tlsf_t pool;
         pool = master_state()->tlsf_pools[TLSF_POOL_USER];
 
+        _internal_mm_stats_free(TLSF_POOL_USER, addr);
+
         tlsf_free(pool, addr);
 #else
         assert(false && "Missing implementation. Override malloc symbol");
@@ -16,6 +16,8 @@ malloc(size_t n __unused) /* Keep as __unused */
         void *ret;
         ret = tlsf_malloc(pool, n);
 
+        _internal_mm_stats_alloc(TLSF_POOL_USER, ret);
+
         return ret;
 #else
         assert(false && "Missing implementation. Override malloc symbol");
@@ -16,6 +16,8 @@ memalign(size_t n __unused, size_t align __unused) /* Keep as __unused */
         void *ret;
         ret = tlsf_memalign(pool, align, n);
 
+        _internal_mm_stats_alloc(TLSF_POOL_USER, ret);
+
         return ret;
 #else
         assert(false && "Missing implementation. Override memalign symbol");
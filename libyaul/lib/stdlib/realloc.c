@@ -13,9 +13,13 @@ realloc(void *old __unused, size_t new_len __unused) /* Keep as __unused */
         tlsf_t pool;
         pool = master_state()->tlsf_pools[TLSF_POOL_USER];
 
+        const size_t old_size = _internal_mm_stats_size(old);
+
         void *ret;
         ret = tlsf_realloc(pool, old, new_len);
 
+        _internal_mm_stats_realloc(TLSF_POOL_USER, old_size, ret, new_len);
+
         return ret;
 #else
         assert(false && "Missing implementation. Override realloc symbol");
@@ -20,6 +20,9 @@ __BEGIN_DECLS
 /// Not yet documented.
 #define VDP1_SYNC_INTERVAL_VARIABLE     (-1)
 
+/// Maximum number of command table regions that can be alternated between.
+#define VDP1_SYNC_BUFFER_COUNT_MAX      (3)
+
 typedef enum vdp_sync_mode {
         VDP1_SYNC_MODE_ERASE_CHANGE = 0x00,
         VDP1_SYNC_MODE_CHANGE_ONLY  = 0x01
@@ -33,6 +36,38 @@ typedef enum vdp_sync_mode {
         vdp_sync_vblank_out_set(NULL);                                         \
 } while (false)
 
+/// @brief Frame timing statistics.
+///
+/// @details Timings are in CPU FRT ticks. Convert them with the
+/// `CPU_FRT_*_COUNT_1MS` constant that matches the FRT clock divisor in use. A
+/// timing that exceeds 65535 ticks wraps around.
+typedef struct vdp_sync_stats {
+        /// Number of calls to @ref vdp_sync.
+        uint32_t frame_count;
+        /// Time VDP1 took to draw the last frame, from when drawing started
+        /// (the frame change in 60Hz mode, the start of plotting in variable
+        /// interval mode) to the sprite end interrupt.
+        uint16_t vdp1_draw_ticks;
+        /// Highest @ref vdp_sync_stats.vdp1_draw_ticks since the last reset.
+        uint16_t vdp1_draw_ticks_max;
+        /// Length of the last VBLANK, from VBLANK-IN to VBLANK-OUT.
+        uint16_t vblank_ticks;
+        /// Time taken by the last VBLANK-IN DMA queue flush.
+        uint16_t vblank_in_dma_ticks;
+        /// Highest @ref vdp_sync_stats.vblank_in_dma_ticks since the last
+        /// reset.
+        uint16_t vblank_in_dma_ticks_max;
+        /// Number of VBLANK-IN where command tables were put for the frame,
+        /// but @ref vdp_sync wasn't waiting, i.e. the CPU didn't finish the
+        /// frame in time. Frames without anything put aren't counted, so that
+        /// syncing at a lower rate isn't reported as dropping frames.
+        uint32_t cpu_dropped_count;
+        /// Number of VBLANK-IN where the frame buffers couldn't be changed
+        /// because VDP1 was still drawing (variable interval mode) or still
+        /// receiving its command tables.
+        uint32_t vdp1_dropped_count;
+} vdp_sync_stats_t;
+
 typedef void (*vdp1_sync_callback_t)(void *);
 
 typedef void (*vdp_sync_callback_t)(void *);
@@ -43,6 +78,11 @@ extern void vdp1_sync_interval_set(const int8_t);
 extern vdp_sync_mode_t vdp1_sync_mode_get(void);
 extern void vdp1_sync_mode_set(vdp_sync_mode_t);
 
+/// @brief Transfer @p count command tables to VDP1 VRAM.
+///
+/// @details The index is in command tables (not bytes), from the start of the
+/// region returned by @ref vdp1_sync_cmdt_buffer_get. The command tables must
+/// fit within @ref vdp1_sync_cmdt_buffer_count_get.
 extern void vdp1_sync_cmdt_put(const vdp1_cmdt_t *, const uint16_t,
     const uint16_t, vdp1_sync_callback_t, void *);
 
@@ -54,11 +94,40 @@ extern void vdp1_sync_cmdt_orderlist_put(const vdp1_cmdt_orderlist_t *,
 
 extern bool vdp1_sync_rendering(void);
 
+/// Split the command table partition into @p count regions (1, 2, or 3).
+///
+/// With more than one region, the command table at VDP1 VRAM offset 0 becomes
+/// a jump to the region last committed. Command tables put via
+/// @ref vdp1_sync_cmdt_put are then written to the region returned by
+/// @ref vdp1_sync_cmdt_buffer_get, and the index is relative to that region.
+/// This lets the CPU build the next frame while VDP1 is drawing the current
+/// one.
+///
+/// In variable interval mode, the region is committed, and drawing starts, at
+/// the first frame change where VDP1 is done drawing the previous region.
+/// @ref vdp_sync returns then, without waiting for VDP1 to finish drawing.
+/// What VDP1 drew is displayed at the frame change of the next region.
+///
+/// Order lists must be patched with @ref vdp1_cmdt_orderlist_vram_patch
+/// against @ref vdp1_sync_cmdt_buffer_get before every put.
+///
+/// Call again after calling @ref vdp1_vram_partitions_set.
+extern void vdp1_sync_buffering_set(uint8_t count);
+extern uint8_t vdp1_sync_buffering_get(void);
+extern vdp1_cmdt_t *vdp1_sync_cmdt_buffer_get(void);
+extern uint16_t vdp1_sync_cmdt_buffer_count_get(void);
+
 extern void vdp2_sync_commit(void);
 
 extern void vdp_sync_vblank_in_set(vdp_sync_callback_t);
 extern void vdp_sync_vblank_out_set(vdp_sync_callback_t);
 
+/// @brief Obtain the frame timing statistics.
+extern void vdp_sync_stats_get(vdp_sync_stats_t *);
+
+/// @brief Reset the counters and maximums of the frame timing statistics.
+extern void vdp_sync_stats_reset(void);
+
 extern callback_id_t vdp_sync_user_callback_add(vdp_sync_callback_t, void *);
 extern void vdp_sync_user_callback_remove(callback_id_t);
 extern void vdp_sync_user_callback_clear(void);
@@ -8,9 +8,11 @@
 #ifndef _VDP1_H_
 #define _VDP1_H_
 
+#include <vdp1/batch.h>
 #include <vdp1/cmdt.h>
 #include <vdp1/env.h>
 #include <vdp1/map.h>
+#include <vdp1/texture.h>
 #include <vdp1/vram.h>
 
 __BEGIN_DECLS
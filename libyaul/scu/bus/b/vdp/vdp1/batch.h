@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _VDP1_BATCH_H_
+#define _VDP1_BATCH_H_
+
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <vdp1/cmdt.h>
+#include <vdp1/map.h>
+
+__BEGIN_DECLS
+
+/// Number of priority layers.
+#define VDP1_BATCH_LAYER_COUNT          (8)
+
+/// Flip the sprite horizontally.
+#define VDP1_BATCH_FLIP_H               (0x10)
+/// Flip the sprite vertically.
+#define VDP1_BATCH_FLIP_V               (0x20)
+
+/// @brief Compact sprite record.
+///
+/// @details The fields are stored in the format of the command table, so that
+/// they can be copied as is. Use the helper functions below to fill them in.
+typedef struct vdp1_batch_sprite {
+        /// Upper-left vertex.
+        int16_t x;
+        int16_t y;
+        /// Character address, as in @ref vdp1_cmdt_t.cmd_srca.
+        uint16_t char_base;
+        /// Character size, as in @ref vdp1_cmdt_t.cmd_size.
+        uint16_t char_size;
+        /// Color bank or lookup table address, as in
+        /// @ref vdp1_cmdt_t.cmd_colr.
+        uint16_t color;
+        /// Draw mode, as in @ref vdp1_cmdt_t.cmd_pmod.
+        uint16_t draw_mode;
+        /// Any of @ref VDP1_BATCH_FLIP_H and @ref VDP1_BATCH_FLIP_V.
+        uint8_t flip;
+        /// Priority layer. Lower layers are drawn first.
+        uint8_t layer;
+        unsigned int :16;
+} __aligned(4) vdp1_batch_sprite_t;
+
+static inline void __always_inline
+vdp1_batch_sprite_texture_set(vdp1_batch_sprite_t *sprite, vdp1_vram_t base,
+    uint16_t width, uint16_t height)
+{
+        sprite->char_base = (base >> 3) & 0xFFFF;
+        sprite->char_size = (((width >> 3) << 8) | height) & 0x3FFF;
+}
+
+static inline void __always_inline
+vdp1_batch_sprite_draw_mode_set(vdp1_batch_sprite_t *sprite,
+    vdp1_cmdt_draw_mode_t draw_mode)
+{
+        sprite->draw_mode = draw_mode.raw;
+}
+
+/// @brief Set the color bank in color mode 0, 2, 3, or 4.
+static inline void __always_inline
+vdp1_batch_sprite_color_bank_set(vdp1_batch_sprite_t *sprite,
+    vdp1_cmdt_color_bank_t color_bank)
+{
+        sprite->color = color_bank.raw;
+}
+
+/// @brief Set the lookup table address in color mode 1.
+static inline void __always_inline
+vdp1_batch_sprite_color_lut_set(vdp1_batch_sprite_t *sprite, vdp1_vram_t base)
+{
+        sprite->color = (base >> 3) & 0xFFFF;
+}
+
+/// @brief Build a normal sprite command table for each sprite.
+///
+/// @details The command tables are written in the order of the sprites. Only
+/// the fields used by normal sprites are written, and the jump mode is set to
+/// "next".
+///
+/// @returns The number of command tables written.
+extern uint16_t vdp1_batch_sprites_emit(vdp1_cmdt_t *cmdts,
+    const vdp1_batch_sprite_t *sprites, uint16_t count);
+
+/// @brief Same as @ref vdp1_batch_sprites_emit, but the command tables are
+/// ordered by layer.
+///
+/// @details Sprites within the same layer keep their order.
+extern uint16_t vdp1_batch_sprites_sorted_emit(vdp1_cmdt_t *cmdts,
+    const vdp1_batch_sprite_t *sprites, uint16_t count);
+
+__END_DECLS
+
+#endif /* !_VDP1_BATCH_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _VDP1_TEXTURE_H_
+#define _VDP1_TEXTURE_H_
+
+#include <sys/cdefs.h>
+#include <sys/queue.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <vdp1/map.h>
+
+__BEGIN_DECLS
+
+/// Alignment (in bytes) of each texture allocated in the texture partition.
+#define VDP1_TEXTURE_ALIGNMENT          (8)
+
+/// Texture slot is not in use.
+#define VDP1_TEXTURE_STATE_FREE         (0x00)
+/// Texture is resident in VDP1 VRAM.
+#define VDP1_TEXTURE_STATE_RESIDENT     (0x01)
+/// Texture has been evicted and must be restored and uploaded again.
+#define VDP1_TEXTURE_STATE_EVICTED      (0x02)
+
+/// @brief A texture allocated in the VDP1 texture partition.
+///
+/// @details The VRAM address is only valid while the texture is resident, and
+/// may change after @ref vdp1_texture_cache_compact.
+typedef struct vdp1_texture {
+        TAILQ_ENTRY(vdp1_texture) entries;
+
+        /// VRAM address.
+        vdp1_vram_t vram;
+        /// Size in bytes, rounded up to @ref VDP1_TEXTURE_ALIGNMENT.
+        uint32_t size;
+        /// Frame the texture was last referenced in.
+        uint32_t frame;
+        /// Number of references in the current frame.
+        uint16_t ref_count;
+        /// State.
+        uint8_t state;
+} __aligned(4) vdp1_texture_t;
+
+/// @brief Initialize the texture cache over the texture partition with the
+/// given number of texture slots.
+///
+/// @details Call @ref vdp1_texture_cache_clear after changing the partitions
+/// with @ref vdp1_vram_partitions_set.
+extern void vdp1_texture_cache_init(uint16_t);
+extern void vdp1_texture_cache_clear(void);
+
+/// @brief Clear the per-frame reference counts.
+///
+/// @details Textures allocated, restored or referenced via
+/// @ref vdp1_texture_ref in the current frame are never evicted. When there's
+/// no room, the contiguous run of textures that was least recently used is
+/// evicted.
+extern void vdp1_texture_cache_frame_end(void);
+
+/// @brief Move all resident textures to the start of the texture partition
+/// via CPU-DMAC.
+///
+/// @details Only call when VDP1 is not drawing, e.g. from a VBLANK-IN
+/// callback. Command tables referencing moved textures must be updated.
+extern void vdp1_texture_cache_compact(void);
+extern uint32_t vdp1_texture_cache_free_get(void);
+
+extern vdp1_texture_t *vdp1_texture_alloc(uint32_t);
+extern void vdp1_texture_free(vdp1_texture_t *);
+extern bool vdp1_texture_restore(vdp1_texture_t *);
+extern void vdp1_texture_ref(vdp1_texture_t *);
+
+static inline bool __always_inline
+vdp1_texture_resident(const vdp1_texture_t *texture)
+{
+        return (texture->state == VDP1_TEXTURE_STATE_RESIDENT);
+}
+
+__END_DECLS
+
+#endif /* !_VDP1_TEXTURE_H_ */
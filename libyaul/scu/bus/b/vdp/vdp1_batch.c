@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+
+#include <vdp1/batch.h>
+
+static_assert(sizeof(vdp1_batch_sprite_t) == 16);
+
+static inline void __always_inline
+_cmdt_write(vdp1_cmdt_t *cmdt, const vdp1_batch_sprite_t *sprite)
+{
+        /* Normal sprite, jump mode "next", and direction bits. Every field is
+         * written once, without reading the command table back */
+        cmdt->cmd_ctrl = sprite->flip & (VDP1_BATCH_FLIP_H | VDP1_BATCH_FLIP_V);
+        cmdt->cmd_link = 0x0000;
+        cmdt->cmd_pmod = sprite->draw_mode;
+        cmdt->cmd_colr = sprite->color;
+        cmdt->cmd_srca = sprite->char_base;
+        cmdt->cmd_size = sprite->char_size;
+        cmdt->cmd_xa = sprite->x;
+        cmdt->cmd_ya = sprite->y;
+        cmdt->cmd_grda = 0x0000;
+}
+
+uint16_t
+vdp1_batch_sprites_emit(vdp1_cmdt_t *cmdts, const vdp1_batch_sprite_t *sprites,
+    uint16_t count)
+{
+        assert(cmdts != NULL);
+        assert((count == 0) || (sprites != NULL));
+
+        for (uint32_t i = 0; i < count; i++) {
+                _cmdt_write(&cmdts[i], &sprites[i]);
+        }
+
+        return count;
+}
+
+uint16_t
+vdp1_batch_sprites_sorted_emit(vdp1_cmdt_t *cmdts,
+    const vdp1_batch_sprite_t *sprites, uint16_t count)
+{
+        assert(cmdts != NULL);
+        assert((count == 0) || (sprites != NULL));
+
+        uint16_t offsets[VDP1_BATCH_LAYER_COUNT];
+
+        for (uint32_t layer = 0; layer < VDP1_BATCH_LAYER_COUNT; layer++) {
+                offsets[layer] = 0;
+        }
+
+        /* Counting sort: count the sprites in each layer, then turn the counts
+         * into the index of the first command table of each layer */
+        for (uint32_t i = 0; i < count; i++) {
+                assert(sprites[i].layer < VDP1_BATCH_LAYER_COUNT);
+
+                offsets[sprites[i].layer]++;
+        }
+
+        uint16_t offset;
+        offset = 0;
+
+        for (uint32_t layer = 0; layer < VDP1_BATCH_LAYER_COUNT; layer++) {
+                const uint16_t layer_count = offsets[layer];
+
+                offsets[layer] = offset;
+                offset += layer_count;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+                const vdp1_batch_sprite_t * const sprite = &sprites[i];
+
+                _cmdt_write(&cmdts[offsets[sprite->layer]], sprite);
+
+                offsets[sprite->layer]++;
+        }
+
+        return count;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cpu/dmac.h>
+#include <cpu/intc.h>
+
+#include <vdp1/texture.h>
+#include <vdp1/vram.h>
+
+#include "vdp-internal.h"
+
+/* CPU-DMAC channel used for compaction. Channel 0 is used by vdp_sync() */
+#define TEXTURE_DMAC_CHANNEL    1
+
+TAILQ_HEAD(texture_list, vdp1_texture);
+
+static struct {
+        /* Resident textures, sorted by VRAM address */
+        struct texture_list resident;
+
+        vdp1_texture_t *slots;
+        uint16_t slot_count;
+
+        vdp1_vram_t base;
+        uint32_t size;
+        uint32_t frame;
+} _cache;
+
+static vdp1_texture_t *_slot_alloc(void);
+static bool _pinned(const vdp1_texture_t *);
+static bool _window_find(uint32_t, vdp1_vram_t *, vdp1_texture_t **,
+    vdp1_texture_t **);
+static void _evict(vdp1_texture_t *, vdp1_texture_t *);
+static bool _place(vdp1_texture_t *);
+static void _vram_move(vdp1_vram_t, vdp1_vram_t, uint32_t);
+
+void
+vdp1_texture_cache_init(uint16_t slot_count)
+{
+        assert(slot_count > 0);
+
+        if (_cache.slots != NULL) {
+                free(_cache.slots);
+        }
+
+        _cache.slots = malloc(slot_count * sizeof(vdp1_texture_t));
+        assert(_cache.slots != NULL);
+
+        _cache.slot_count = slot_count;
+
+        vdp1_texture_cache_clear();
+}
+
+void
+vdp1_texture_cache_clear(void)
+{
+        assert(_cache.slots != NULL);
+
+        const vdp1_vram_partitions_t * const vram_partitions =
+            _state_vdp1()->vram_partitions;
+
+        TAILQ_INIT(&_cache.resident);
+
+        (void)memset(_cache.slots, 0x00,
+            _cache.slot_count * sizeof(vdp1_texture_t));
+
+        _cache.base = (vdp1_vram_t)vram_partitions->texture_base;
+        _cache.size = vram_partitions->texture_size;
+        _cache.frame = 0;
+}
+
+void
+vdp1_texture_cache_frame_end(void)
+{
+        vdp1_texture_t *texture;
+
+        TAILQ_FOREACH (texture, &_cache.resident, entries) {
+                texture->ref_count = 0;
+        }
+
+        _cache.frame++;
+}
+
+void
+vdp1_texture_cache_compact(void)
+{
+        vdp1_vram_t cursor;
+        cursor = _cache.base;
+
+        vdp1_texture_t *texture;
+
+        /* Slide each texture down to the end of the previous one. Since the
+         * destination is always below the source, an incrementing copy is safe
+         * even when the two overlap */
+        TAILQ_FOREACH (texture, &_cache.resident, entries) {
+                if (texture->vram != cursor) {
+                        _vram_move(cursor, texture->vram, texture->size);
+
+                        texture->vram = cursor;
+                }
+
+                cursor += texture->size;
+        }
+
+        cpu_dmac_channel_wait(TEXTURE_DMAC_CHANNEL);
+}
+
+uint32_t
+vdp1_texture_cache_free_get(void)
+{
+        uint32_t used_size;
+        used_size = 0;
+
+        const vdp1_texture_t *texture;
+
+        TAILQ_FOREACH (texture, &_cache.resident, entries) {
+                used_size += texture->size;
+        }
+
+        return (_cache.size - used_size);
+}
+
+vdp1_texture_t *
+vdp1_texture_alloc(uint32_t size)
+{
+        assert(size > 0);
+
+        vdp1_texture_t *texture;
+        texture = _slot_alloc();
+
+        if (texture == NULL) {
+                return NULL;
+        }
+
+        texture->size = (size + (VDP1_TEXTURE_ALIGNMENT - 1)) &
+                        ~(VDP1_TEXTURE_ALIGNMENT - 1);
+
+        if (!(_place(texture))) {
+                texture->state = VDP1_TEXTURE_STATE_FREE;
+
+                return NULL;
+        }
+
+        return texture;
+}
+
+void
+vdp1_texture_free(vdp1_texture_t *texture)
+{
+        assert(texture != NULL);
+        assert(texture->state != VDP1_TEXTURE_STATE_FREE);
+
+        if (texture->state == VDP1_TEXTURE_STATE_RESIDENT) {
+                TAILQ_REMOVE(&_cache.resident, texture, entries);
+        }
+
+        texture->state = VDP1_TEXTURE_STATE_FREE;
+}
+
+bool
+vdp1_texture_restore(vdp1_texture_t *texture)
+{
+        assert(texture != NULL);
+        assert(texture->state != VDP1_TEXTURE_STATE_FREE);
+
+        if (texture->state == VDP1_TEXTURE_STATE_RESIDENT) {
+                return true;
+        }
+
+        return _place(texture);
+}
+
+void
+vdp1_texture_ref(vdp1_texture_t *texture)
+{
+        assert(texture != NULL);
+        assert(texture->state == VDP1_TEXTURE_STATE_RESIDENT);
+
+        texture->ref_count++;
+        texture->frame = _cache.frame;
+}
+
+static vdp1_texture_t *
+_slot_alloc(void)
+{
+        assert(_cache.slots != NULL);
+
+        for (uint32_t i = 0; i < _cache.slot_count; i++) {
+                vdp1_texture_t * const texture = &_cache.slots[i];
+
+                if (texture->state == VDP1_TEXTURE_STATE_FREE) {
+                        texture->state = VDP1_TEXTURE_STATE_EVICTED;
+
+                        return texture;
+                }
+        }
+
+        return NULL;
+}
+
+/* Textures referenced, allocated or restored in the current frame may
+ * still be drawn, so they can't be evicted */
+static bool
+_pinned(const vdp1_texture_t *texture)
+{
+        return ((texture->ref_count > 0) || (texture->frame == _cache.frame));
+}
+
+/* Find the contiguous run of resident textures to evict to make room for the
+ * given size. The least recently used run is evicted, i.e. the run whose most
+ * recently used texture was used the longest ago, with ties going to the run
+ * with the fewest bytes. A gap that's already large enough evicts nothing.
+ *
+ * On success, the VRAM address is returned along with the first texture to
+ * evict and the texture the window precedes (NULL if the window extends to
+ * the end of the partition). No texture is evicted when both are the same */
+static bool
+_window_find(uint32_t size, vdp1_vram_t *vram, vdp1_texture_t **first,
+    vdp1_texture_t **next)
+{
+        const vdp1_vram_t end = _cache.base + _cache.size;
+
+        bool found;
+        found = false;
+
+        uint32_t best_cost;
+        best_cost = 0;
+
+        uint32_t best_frame;
+        best_frame = 0;
+
+        vdp1_vram_t start;
+        start = _cache.base;
+
+        vdp1_texture_t *window_first;
+        window_first = TAILQ_FIRST(&_cache.resident);
+
+        while (true) {
+                uint32_t cost;
+                cost = 0;
+
+                uint32_t frame;
+                frame = 0;
+
+                vdp1_texture_t *texture;
+                texture = window_first;
+
+                while (true) {
+                        const vdp1_vram_t limit =
+                            (texture == NULL) ? end : texture->vram;
+
+                        if ((limit - start) >= size) {
+                                if (!found || (frame < best_frame) ||
+                                    ((frame == best_frame) && (cost < best_cost))) {
+                                        found = true;
+                                        best_cost = cost;
+                                        best_frame = frame;
+
+                                        *vram = start;
+                                        *first = window_first;
+                                        *next = texture;
+                                }
+
+                                break;
+                        }
+
+                        if ((texture == NULL) || (_pinned(texture))) {
+                                break;
+                        }
+
+                        cost += texture->size;
+
+                        if (texture->frame > frame) {
+                                frame = texture->frame;
+                        }
+
+                        texture = TAILQ_NEXT(texture, entries);
+                }
+
+                /* Nothing is older or cheaper than a gap that already fits */
+                if ((found && (best_cost == 0)) || (window_first == NULL)) {
+                        break;
+                }
+
+                start = window_first->vram + window_first->size;
+                window_first = TAILQ_NEXT(window_first, entries);
+        }
+
+        return found;
+}
+
+static void
+_evict(vdp1_texture_t *first, vdp1_texture_t *next)
+{
+        vdp1_texture_t *texture;
+        texture = first;
+
+        while (texture != next) {
+                vdp1_texture_t * const next_texture =
+                    TAILQ_NEXT(texture, entries);
+
+                TAILQ_REMOVE(&_cache.resident, texture, entries);
+
+                texture->state = VDP1_TEXTURE_STATE_EVICTED;
+                texture->vram = 0x00000000;
+
+                texture = next_texture;
+        }
+}
+
+static bool
+_place(vdp1_texture_t *texture)
+{
+        if (texture->size > _cache.size) {
+                return false;
+        }
+
+        vdp1_vram_t vram;
+        vdp1_texture_t *first;
+        vdp1_texture_t *next;
+
+        if (!(_window_find(texture->size, &vram, &first, &next))) {
+                return false;
+        }
+
+        _evict(first, next);
+
+        texture->vram = vram;
+        texture->frame = _cache.frame;
+        texture->ref_count = 0;
+        texture->state = VDP1_TEXTURE_STATE_RESIDENT;
+
+        if (next == NULL) {
+                TAILQ_INSERT_TAIL(&_cache.resident, texture, entries);
+        } else {
+                TAILQ_INSERT_BEFORE(next, texture, entries);
+        }
+
+        return true;
+}
+
+static void
+_vram_move(vdp1_vram_t dst, vdp1_vram_t src, uint32_t len)
+{
+        static cpu_dmac_cfg_t dmac_cfg = {
+                .channel = TEXTURE_DMAC_CHANNEL,
+                .src_mode = CPU_DMAC_SOURCE_INCREMENT,
+                .src = 0x00000000,
+                .dst = 0x00000000,
+                .dst_mode = CPU_DMAC_DESTINATION_INCREMENT,
+                .len = 0x00000000,
+                .stride = CPU_DMAC_STRIDE_4_BYTES,
+                .bus_mode = CPU_DMAC_BUS_MODE_CYCLE_STEAL,
+                .ihr = NULL
+        };
+
+        dmac_cfg.dst = dst;
+        dmac_cfg.src = src;
+        dmac_cfg.len = len;
+
+        cpu_dmac_channel_wait(TEXTURE_DMAC_CHANNEL);
+        cpu_dmac_channel_config_set(&dmac_cfg);
+        cpu_dmac_enable();
+        cpu_dmac_channel_start(TEXTURE_DMAC_CHANNEL);
+}
@@ -9,10 +9,13 @@
 #define _VDP2_H_
 
 #include <vdp2/cram.h>
+#include <vdp2/palette.h>
 #include <vdp2/scrn.h>
 #include <vdp2/sprite.h>
+#include <vdp2/tilemap.h>
 #include <vdp2/tvmd.h>
 #include <vdp2/vram.h>
+#include <vdp2/vram_layout.h>
 
 __BEGIN_DECLS
 
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _VDP2_PALETTE_H_
+#define _VDP2_PALETTE_H_
+
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <color.h>
+
+#include <vdp2/cram.h>
+
+__BEGIN_DECLS
+
+/* Palettes are managed in a shadow copy of CRAM. Effects are computed on the
+ * shadow copy by vdp2_palette_update(), which then enqueues a single transfer
+ * of the modified range of CRAM to the DMA queue. The transfer takes place
+ * during VBLANK-IN when vdp_sync() is called.
+ *
+ * Only CRAM modes 0 and 1 (RGB 555) are supported */
+
+/// Number of colors in the smallest palette that can be allocated.
+#define VDP2_PALETTE_UNIT_COUNT         (16)
+
+/// Maximum number of palettes that can be allocated at once.
+#define VDP2_PALETTE_COUNT_MAX          (32)
+
+#define VDP2_PALETTE_EFFECT_NONE        (0x00)
+#define VDP2_PALETTE_EFFECT_FADE_TO     (0x01)
+#define VDP2_PALETTE_EFFECT_FADE_FROM   (0x02)
+#define VDP2_PALETTE_EFFECT_CYCLE       (0x03)
+
+typedef struct vdp2_palette {
+        /// CRAM address.
+        vdp2_cram_t cram;
+        /// Number of colors.
+        uint16_t count;
+        /// Current effect.
+        uint8_t effect;
+
+        /* Private */
+        uint8_t unit_index;
+        uint8_t unit_count;
+        color_rgb1555_t *base;
+        color_rgb1555_t *shadow;
+
+        union {
+                struct {
+                        color_rgb1555_t color;
+                        uint16_t step;
+                        uint16_t step_count;
+                } fade;
+
+                struct {
+                        uint16_t start;
+                        uint16_t count;
+                        uint16_t offset;
+                        uint8_t period;
+                        uint8_t timer;
+                } cycle;
+        };
+} vdp2_palette_t;
+
+extern void vdp2_palette_init(void);
+
+extern vdp2_palette_t *vdp2_palette_alloc(uint16_t);
+extern void vdp2_palette_free(vdp2_palette_t *);
+
+extern void vdp2_palette_colors_set(vdp2_palette_t *, const color_rgb1555_t *);
+extern void vdp2_palette_color_set(vdp2_palette_t *, uint16_t,
+    color_rgb1555_t);
+
+/// @brief Fade from the palette colors to @p color over a number of frames.
+extern void vdp2_palette_fade_to_set(vdp2_palette_t *, color_rgb1555_t,
+    uint16_t);
+/// @brief Fade from @p color to the palette colors over a number of frames.
+extern void vdp2_palette_fade_from_set(vdp2_palette_t *, color_rgb1555_t,
+    uint16_t);
+/// @brief Rotate a range of colors by one every @p period frames.
+extern void vdp2_palette_cycle_set(vdp2_palette_t *, uint16_t, uint16_t,
+    uint8_t);
+/// @brief Stop the current effect and restore the palette colors.
+extern void vdp2_palette_effect_stop(vdp2_palette_t *);
+extern bool vdp2_palette_effect_busy(const vdp2_palette_t *);
+
+/// @brief Step each effect by one frame and enqueue the upload of the modified
+/// range of CRAM. Call once per frame before @ref vdp_sync.
+extern void vdp2_palette_update(void);
+
+__END_DECLS
+
+#endif /* !_VDP2_PALETTE_H_ */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _VDP2_TILEMAP_H_
+#define _VDP2_TILEMAP_H_
+
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <scu/dma.h>
+
+#include <vdp2/scrn.h>
+
+__BEGIN_DECLS
+
+/// Maximum number of transfers (runs of pattern name data) per update.
+#define VDP2_TILEMAP_XFER_COUNT (256)
+
+/// @brief Streams a world map larger than a normal background map into the
+/// four planes of the normal background, which are treated as a ring.
+///
+/// @details The world map is an array of pattern name data (one or two words,
+/// depending on @ref vdp2_scrn_cell_format.pnd_size) in row-major order. The
+/// world map wraps around at its edges.
+typedef struct vdp2_tilemap {
+        /// Cell format of the normal background. Planes A to D are used.
+        const vdp2_scrn_cell_format_t *cell_format;
+        /// World map.
+        const void *map;
+        /// Width of the world map (in characters).
+        uint16_t width;
+        /// Height of the world map (in characters).
+        uint16_t height;
+
+        /* Private */
+        uint16_t ring_width;
+        uint16_t ring_height;
+        uint8_t page_shift;
+        uint8_t plane_width;
+        uint8_t plane_height;
+        uint8_t char_shift;
+        uint8_t pnd_bytes;
+
+        /* Top-left character of the window currently resident in VRAM */
+        int32_t tx;
+        int32_t ty;
+        uint16_t window_width;
+        uint16_t window_height;
+        bool valid;
+
+        scu_dma_handle_t handle;
+        scu_dma_xfer_t *xfer_table;
+        uint16_t xfer_count;
+} vdp2_tilemap_t;
+
+/// @brief Initialize the tilemap streamer.
+///
+/// @details The members @p cell_format, @p map, @p width, and @p height must be
+/// set. The visible window must fit within the normal background map.
+extern void vdp2_tilemap_init(vdp2_tilemap_t *);
+extern void vdp2_tilemap_deinit(vdp2_tilemap_t *);
+
+/// @brief Force the visible window to be uploaded in full on the next call to
+/// @ref vdp2_tilemap_update.
+extern void vdp2_tilemap_invalidate(vdp2_tilemap_t *);
+
+/// @brief Move the camera to (@p x, @p y) (in pixels) in the world map.
+///
+/// @details The rows and columns of characters exposed since the last call are
+/// enqueued as a single indirect SCU-DMA transfer, which takes place during
+/// VBLANK-IN when @ref vdp_sync is called. The scroll values of the normal
+/// background are set accordingly.
+///
+/// Call at most once per frame, as the transfer table is reused.
+extern void vdp2_tilemap_update(vdp2_tilemap_t *, int32_t, int32_t);
+
+__END_DECLS
+
+#endif /* !_VDP2_TILEMAP_H_ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _VDP2_VRAM_LAYOUT_H_
+#define _VDP2_VRAM_LAYOUT_H_
+
+#include <sys/cdefs.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <vdp2/scrn.h>
+#include <vdp2/vram.h>
+
+__BEGIN_DECLS
+
+/// Maximum number of scroll screens that can be laid out at once.
+#define VDP2_VRAM_LAYOUT_SCRN_COUNT_MAX (4)
+
+/// @brief A normal background to be placed in VRAM.
+///
+/// @details Exactly one of @p cell_format or @p bitmap_format must be set. The
+/// VRAM addresses (character pattern table and map, or bitmap pattern) of the
+/// format are written by @ref vdp2_vram_layout_solve.
+typedef struct vdp2_vram_layout_scrn {
+        /// Cell format (NBG0 to NBG3).
+        vdp2_scrn_cell_format_t *cell_format;
+        /// Bitmap format (NBG0 and NBG1).
+        vdp2_scrn_bitmap_format_t *bitmap_format;
+        /// Size (in bytes) of the character pattern data (cell format only).
+        uint32_t cpd_size;
+        /// Number of distinct planes (1 to 4) to allocate (cell format only).
+        /// Planes A to D are assigned cyclically from the allocated planes.
+        uint8_t plane_count;
+} vdp2_vram_layout_scrn_t;
+
+/// @brief Place the data of each scroll screen across the four VRAM banks, and
+/// build a VRAM cycle pattern table for the current resolution.
+///
+/// @details VRAM must be partitioned into four banks (A0, A1, B0, and B1). Only
+/// the accesses required by each scroll screen are allocated. The remaining
+/// timings are given to the CPU. Reduction is not taken into account.
+///
+/// The results are not committed. Call @ref vdp2_scrn_cell_format_set or @ref
+/// vdp2_scrn_bitmap_format_set for each scroll screen, and @ref
+/// vdp2_vram_cycp_set with @p cycp.
+///
+/// @returns `true` if a valid layout was found.
+extern bool vdp2_vram_layout_solve(vdp2_vram_layout_scrn_t *, uint8_t,
+    vdp2_vram_cycp_t *);
+
+__END_DECLS
+
+#endif /* !_VDP2_VRAM_LAYOUT_H_ */
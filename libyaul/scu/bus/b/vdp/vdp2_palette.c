@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <cpu/cache.h>
+
+#include <sys/dma-queue.h>
+
+#include <vdp2/palette.h>
+
+#include "vdp-internal.h"
+
+/* Number of colors in CRAM (mode 1) */
+#define CRAM_COLOR_COUNT        (VDP2_CRAM_MODE_1_SIZE / sizeof(color_rgb1555_t))
+
+/* Maximum number of 16-color units */
+#define UNIT_COUNT_MAX          (CRAM_COLOR_COUNT / VDP2_PALETTE_UNIT_COUNT)
+
+/* Palettes of 256 colors (or more) are aligned to a 256-color bank, which is
+ * what a CRAM offset or a palette number in a pattern name can address */
+#define UNIT_ALIGNMENT_MAX      (256 / VDP2_PALETTE_UNIT_COUNT)
+
+static struct {
+        vdp2_palette_t palettes[VDP2_PALETTE_COUNT_MAX];
+
+        /* One bit per allocated 16-color unit */
+        uint32_t units[UNIT_COUNT_MAX / 32];
+        uint8_t unit_count;
+
+        /* Dirty range of the shadow copy (in colors) */
+        uint16_t dirty_start;
+        uint16_t dirty_end;
+} _state;
+
+/* The shadow copy is uploaded to CRAM, while the base copy holds the colors set
+ * by the user and is left untouched by effects */
+static color_rgb1555_t _shadow[CRAM_COLOR_COUNT] __aligned(4);
+static color_rgb1555_t _base[CRAM_COLOR_COUNT];
+
+static bool _units_find(uint8_t, uint8_t *);
+static void _units_mark(uint8_t, uint8_t, bool);
+static void _dirty_mark(const vdp2_palette_t *, uint16_t, uint16_t);
+
+static void _fade_step(vdp2_palette_t *);
+static void _cycle_step(vdp2_palette_t *);
+
+static inline color_rgb1555_t __always_inline
+_color_lerp(color_rgb1555_t c0, color_rgb1555_t c1, int32_t weight)
+{
+        const int32_t r0 = c0.raw & 0x1F;
+        const int32_t g0 = (c0.raw >> 5) & 0x1F;
+        const int32_t b0 = (c0.raw >> 10) & 0x1F;
+
+        const int32_t r1 = c1.raw & 0x1F;
+        const int32_t g1 = (c1.raw >> 5) & 0x1F;
+        const int32_t b1 = (c1.raw >> 10) & 0x1F;
+
+        const int32_t r = r0 + (((r1 - r0) * weight) >> 8);
+        const int32_t g = g0 + (((g1 - g0) * weight) >> 8);
+        const int32_t b = b0 + (((b1 - b0) * weight) >> 8);
+
+        return (color_rgb1555_t){
+                .raw = (c0.raw & 0x8000) | (b << 10) | (g << 5) | r
+        };
+}
+
+void
+vdp2_palette_init(void)
+{
+#ifdef DEBUG
+        /* RGB 888 (mode 2) isn't supported */
+        assert(vdp2_cram_mode_get() != 2);
+#endif /* DEBUG */
+
+        (void)memset(&_state, 0x00, sizeof(_state));
+
+        _state.unit_count = ((vdp2_cram_mode_get() == 0)
+            ? (VDP2_CRAM_MODE_0_SIZE / sizeof(color_rgb1555_t))
+            : CRAM_COLOR_COUNT) / VDP2_PALETTE_UNIT_COUNT;
+
+        _state.dirty_start = CRAM_COLOR_COUNT;
+        _state.dirty_end = 0;
+}
+
+vdp2_palette_t *
+vdp2_palette_alloc(uint16_t count)
+{
+        assert(count > 0);
+
+        vdp2_palette_t *palette;
+        palette = NULL;
+
+        for (uint32_t i = 0; i < VDP2_PALETTE_COUNT_MAX; i++) {
+                if (_state.palettes[i].count == 0) {
+                        palette = &_state.palettes[i];
+                        break;
+                }
+        }
+
+        if (palette == NULL) {
+                return NULL;
+        }
+
+        const uint8_t unit_count =
+            (count + (VDP2_PALETTE_UNIT_COUNT - 1)) / VDP2_PALETTE_UNIT_COUNT;
+
+        uint8_t unit_index;
+
+        if (!(_units_find(unit_count, &unit_index))) {
+                return NULL;
+        }
+
+        _units_mark(unit_index, unit_count, true);
+
+        const uint16_t offset = unit_index * VDP2_PALETTE_UNIT_COUNT;
+
+        palette->cram = VDP2_CRAM_ADDR(offset);
+        palette->count = count;
+        palette->effect = VDP2_PALETTE_EFFECT_NONE;
+        palette->unit_index = unit_index;
+        palette->unit_count = unit_count;
+        palette->base = &_base[offset];
+        palette->shadow = &_shadow[offset];
+
+        return palette;
+}
+
+void
+vdp2_palette_free(vdp2_palette_t *palette)
+{
+        assert(palette != NULL);
+        assert(palette->count > 0);
+
+        _units_mark(palette->unit_index, palette->unit_count, false);
+
+        palette->count = 0;
+        palette->effect = VDP2_PALETTE_EFFECT_NONE;
+}
+
+void
+vdp2_palette_colors_set(vdp2_palette_t *palette, const color_rgb1555_t *colors)
+{
+        assert(palette != NULL);
+        assert(palette->count > 0);
+        assert(colors != NULL);
+
+        const size_t size = palette->count * sizeof(color_rgb1555_t);
+
+        (void)memcpy(palette->base, colors, size);
+
+        /* An ongoing effect picks up the new colors on its next step */
+        if (palette->effect == VDP2_PALETTE_EFFECT_NONE) {
+                (void)memcpy(palette->shadow, colors, size);
+
+                _dirty_mark(palette, 0, palette->count);
+        }
+}
+
+void
+vdp2_palette_color_set(vdp2_palette_t *palette, uint16_t index,
+    color_rgb1555_t color)
+{
+        assert(palette != NULL);
+        assert(index < palette->count);
+
+        palette->base[index] = color;
+
+        if (palette->effect == VDP2_PALETTE_EFFECT_NONE) {
+                palette->shadow[index] = color;
+
+                _dirty_mark(palette, index, 1);
+        }
+}
+
+void
+vdp2_palette_fade_to_set(vdp2_palette_t *palette, color_rgb1555_t color,
+    uint16_t frame_count)
+{
+        assert(palette != NULL);
+        assert(palette->count > 0);
+        assert(frame_count > 0);
+
+        palette->effect = VDP2_PALETTE_EFFECT_FADE_TO;
+        palette->fade.color = color;
+        palette->fade.step = 0;
+        palette->fade.step_count = frame_count;
+}
+
+void
+vdp2_palette_fade_from_set(vdp2_palette_t *palette, color_rgb1555_t color,
+    uint16_t frame_count)
+{
+        assert(palette != NULL);
+        assert(palette->count > 0);
+        assert(frame_count > 0);
+
+        palette->effect = VDP2_PALETTE_EFFECT_FADE_FROM;
+        palette->fade.color = color;
+        palette->fade.step = 0;
+        palette->fade.step_count = frame_count;
+}
+
+void
+vdp2_palette_cycle_set(vdp2_palette_t *palette, uint16_t start, uint16_t count,
+    uint8_t period)
+{
+        assert(palette != NULL);
+        assert(count > 1);
+        assert((start + count) <= palette->count);
+        assert(period > 0);
+
+        palette->effect = VDP2_PALETTE_EFFECT_CYCLE;
+        palette->cycle.start = start;
+        palette->cycle.count = count;
+        palette->cycle.offset = 0;
+        palette->cycle.period = period;
+        palette->cycle.timer = period;
+}
+
+void
+vdp2_palette_effect_stop(vdp2_palette_t *palette)
+{
+        assert(palette != NULL);
+        assert(palette->count > 0);
+
+        palette->effect = VDP2_PALETTE_EFFECT_NONE;
+
+        (void)memcpy(palette->shadow, palette->base,
+            palette->count * sizeof(color_rgb1555_t));
+
+        _dirty_mark(palette, 0, palette->count);
+}
+
+bool
+vdp2_palette_effect_busy(const vdp2_palette_t *palette)
+{
+        assert(palette != NULL);
+
+        return (palette->effect != VDP2_PALETTE_EFFECT_NONE);
+}
+
+void
+vdp2_palette_update(void)
+{
+        for (uint32_t i = 0; i < VDP2_PALETTE_COUNT_MAX; i++) {
+                vdp2_palette_t * const palette = &_state.palettes[i];
+
+                if (palette->count == 0) {
+                        continue;
+                }
+
+                switch (palette->effect) {
+                case VDP2_PALETTE_EFFECT_FADE_TO:
+                case VDP2_PALETTE_EFFECT_FADE_FROM:
+                        _fade_step(palette);
+                        break;
+                case VDP2_PALETTE_EFFECT_CYCLE:
+                        _cycle_step(palette);
+                        break;
+                }
+        }
+
+        if (_state.dirty_start >= _state.dirty_end) {
+                return;
+        }
+
+        /* Transfer in units of 4 bytes */
+        const uint16_t start = _state.dirty_start & ~1;
+        const uint16_t end = (_state.dirty_end + 1) & ~1;
+
+        int8_t ret __unused;
+        ret = dma_queue_simple_enqueue(DMA_QUEUE_TAG_VBLANK_IN,
+            (void *)VDP2_CRAM_ADDR(start),
+            (void *)(CPU_CACHE_THROUGH | (uint32_t)&_shadow[start]),
+            (end - start) * sizeof(color_rgb1555_t));
+        assert(ret == 0);
+
+        _state.dirty_start = CRAM_COLOR_COUNT;
+        _state.dirty_end = 0;
+}
+
+/* First-fit search for free units, aligned to the next power of two of the
+ * number of units (up to a 256-color bank) */
+static bool
+_units_find(uint8_t unit_count, uint8_t *unit_index)
+{
+        uint8_t alignment;
+        alignment = 1;
+
+        while ((alignment < unit_count) && (alignment < UNIT_ALIGNMENT_MAX)) {
+                alignment <<= 1;
+        }
+
+        for (uint32_t index = 0;
+             (index + unit_count) <= _state.unit_count;
+             index += alignment) {
+                uint32_t i;
+
+                for (i = 0; i < unit_count; i++) {
+                        const uint32_t unit = index + i;
+
+                        if ((_state.units[unit >> 5] & (1 << (unit & 31))) != 0) {
+                                break;
+                        }
+                }
+
+                if (i == unit_count) {
+                        *unit_index = index;
+
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+static void
+_units_mark(uint8_t unit_index, uint8_t unit_count, bool used)
+{
+        for (uint32_t unit = unit_index; unit < (unit_index + unit_count); unit++) {
+                if (used) {
+                        _state.units[unit >> 5] |= 1 << (unit & 31);
+                } else {
+                        _state.units[unit >> 5] &= ~(1 << (unit & 31));
+                }
+        }
+}
+
+static void
+_dirty_mark(const vdp2_palette_t *palette, uint16_t index, uint16_t count)
+{
+        const uint16_t start = (palette->unit_index * VDP2_PALETTE_UNIT_COUNT) +
+            index;
+        const uint16_t end = start + count;
+
+        if (start < _state.dirty_start) {
+                _state.dirty_start = start;
+        }
+
+        if (end > _state.dirty_end) {
+                _state.dirty_end = end;
+        }
+}
+
+static void
+_fade_step(vdp2_palette_t *palette)
+{
+        palette->fade.step++;
+
+        int32_t weight;
+        weight = (palette->fade.step << 8) / palette->fade.step_count;
+
+        if (palette->effect == VDP2_PALETTE_EFFECT_FADE_FROM) {
+                weight = 256 - weight;
+        }
+
+        const color_rgb1555_t color = palette->fade.color;
+
+        for (uint32_t i = 0; i < palette->count; i++) {
+                palette->shadow[i] = _color_lerp(palette->base[i], color,
+                    weight);
+        }
+
+        _dirty_mark(palette, 0, palette->count);
+
+        /* Once faded to a color, the shadow copy is left as is */
+        if (palette->fade.step == palette->fade.step_count) {
+                palette->effect = VDP2_PALETTE_EFFECT_NONE;
+        }
+}
+
+static void
+_cycle_step(vdp2_palette_t *palette)
+{
+        palette->cycle.timer--;
+
+        if (palette->cycle.timer > 0) {
+                return;
+        }
+
+        palette->cycle.timer = palette->cycle.period;
+
+        const uint16_t start = palette->cycle.start;
+        const uint16_t count = palette->cycle.count;
+
+        palette->cycle.offset++;
+
+        if (palette->cycle.offset == count) {
+                palette->cycle.offset = 0;
+        }
+
+        const color_rgb1555_t * const base = &palette->base[start];
+        color_rgb1555_t * const shadow = &palette->shadow[start];
+
+        uint16_t src;
+        src = palette->cycle.offset;
+
+        for (uint32_t i = 0; i < count; i++) {
+                shadow[i] = base[src];
+
+                src++;
+
+                if (src == count) {
+                        src = 0;
+                }
+        }
+
+        _dirty_mark(palette, start, count);
+}
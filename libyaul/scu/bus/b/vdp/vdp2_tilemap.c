@@ -0,0 +1,324 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <cpu/cache.h>
+
+#include <sys/dma-queue.h>
+
+#include <vdp2/tilemap.h>
+
+#include "vdp-internal.h"
+
+/* The transfer table must be aligned to its size rounded up to the next power
+ * of two */
+#define XFER_TABLE_SIZE         (VDP2_TILEMAP_XFER_COUNT * sizeof(scu_dma_xfer_t))
+#define XFER_TABLE_ALIGNMENT    (4096)
+
+static_assert(XFER_TABLE_SIZE <= XFER_TABLE_ALIGNMENT);
+static_assert(XFER_TABLE_SIZE > (XFER_TABLE_ALIGNMENT / 2));
+
+static void _full_add(vdp2_tilemap_t *, int32_t, int32_t);
+static bool _incremental_add(vdp2_tilemap_t *, int32_t, int32_t);
+
+static bool _row_add(vdp2_tilemap_t *, int32_t, int32_t, uint32_t);
+static bool _cell_add(vdp2_tilemap_t *, int32_t, int32_t);
+static bool _xfer_add(vdp2_tilemap_t *, int32_t, int32_t, uint32_t);
+
+static vdp2_vram_t _vram_calculate(const vdp2_tilemap_t *, uint32_t, uint32_t);
+
+static inline uint32_t __always_inline
+_wrap(int32_t value, uint32_t count)
+{
+        int32_t wrapped;
+        wrapped = value % (int32_t)count;
+
+        if (wrapped < 0) {
+                wrapped += count;
+        }
+
+        return wrapped;
+}
+
+void
+vdp2_tilemap_init(vdp2_tilemap_t *tilemap)
+{
+        assert(tilemap != NULL);
+
+        const vdp2_scrn_cell_format_t * const cell_format =
+            tilemap->cell_format;
+
+        assert(cell_format != NULL);
+        assert(tilemap->map != NULL);
+        assert((tilemap->width > 0) && (tilemap->height > 0));
+
+#ifdef DEBUG
+        assert((cell_format->scroll_screen == VDP2_SCRN_NBG0) ||
+               (cell_format->scroll_screen == VDP2_SCRN_NBG1) ||
+               (cell_format->scroll_screen == VDP2_SCRN_NBG2) ||
+               (cell_format->scroll_screen == VDP2_SCRN_NBG3));
+#endif /* DEBUG */
+
+        const uint32_t page_width = VDP2_SCRN_CALCULATE_PAGE_WIDTH(cell_format);
+
+        tilemap->page_shift = (page_width == 64) ? 6 : 5;
+        tilemap->plane_width = (cell_format->plane_size == (1 * 1)) ? 1 : 2;
+        tilemap->plane_height = (cell_format->plane_size == (2 * 2)) ? 2 : 1;
+        tilemap->char_shift = (cell_format->character_size == (1 * 1)) ? 3 : 4;
+        tilemap->pnd_bytes = cell_format->pnd_size * 2;
+
+        /* Planes A to D are laid out 2x2 */
+        tilemap->ring_width = 2 * tilemap->plane_width * page_width;
+        tilemap->ring_height = 2 * tilemap->plane_height * page_width;
+
+        const int16_vec2_t * const resolution = &_state_vdp2()->tv.resolution;
+        const uint32_t char_size = 1 << tilemap->char_shift;
+
+        tilemap->window_width =
+            ((resolution->x + (char_size - 1)) >> tilemap->char_shift) + 1;
+        tilemap->window_height =
+            ((resolution->y + (char_size - 1)) >> tilemap->char_shift) + 1;
+
+        assert(tilemap->window_width <= tilemap->ring_width);
+        assert(tilemap->window_height <= tilemap->ring_height);
+
+        /* Worst case number of runs in a full upload: each row is split at page
+         * boundaries and at the edge of the world map */
+        assert((tilemap->window_height *
+                ((tilemap->window_width >> tilemap->page_shift) + 3 +
+                 (tilemap->window_width / tilemap->width))) <=
+               VDP2_TILEMAP_XFER_COUNT);
+
+        tilemap->xfer_table = memalign(XFER_TABLE_SIZE, XFER_TABLE_ALIGNMENT);
+        assert(tilemap->xfer_table != NULL);
+
+        tilemap->xfer_count = 0;
+
+        const scu_dma_level_cfg_t dma_cfg = {
+                .mode = SCU_DMA_MODE_INDIRECT,
+                .xfer.indirect = tilemap->xfer_table,
+                .stride = SCU_DMA_STRIDE_2_BYTES,
+                .update = SCU_DMA_UPDATE_NONE
+        };
+
+        scu_dma_config_buffer(&tilemap->handle, &dma_cfg);
+
+        vdp2_tilemap_invalidate(tilemap);
+}
+
+void
+vdp2_tilemap_deinit(vdp2_tilemap_t *tilemap)
+{
+        assert(tilemap != NULL);
+
+        if (tilemap->xfer_table != NULL) {
+                free(tilemap->xfer_table);
+        }
+
+        tilemap->xfer_table = NULL;
+}
+
+void
+vdp2_tilemap_invalidate(vdp2_tilemap_t *tilemap)
+{
+        assert(tilemap != NULL);
+
+        tilemap->valid = false;
+}
+
+void
+vdp2_tilemap_update(vdp2_tilemap_t *tilemap, int32_t x, int32_t y)
+{
+        assert(tilemap != NULL);
+        assert(tilemap->xfer_table != NULL);
+
+        const int32_t tx = x >> tilemap->char_shift;
+        const int32_t ty = y >> tilemap->char_shift;
+
+        tilemap->xfer_count = 0;
+
+        if (!tilemap->valid || !(_incremental_add(tilemap, tx, ty))) {
+                tilemap->xfer_count = 0;
+
+                _full_add(tilemap, tx, ty);
+        }
+
+        tilemap->tx = tx;
+        tilemap->ty = ty;
+        tilemap->valid = true;
+
+        const vdp2_scrn_t scroll_screen = tilemap->cell_format->scroll_screen;
+
+        const int32_t ring_width = tilemap->ring_width << tilemap->char_shift;
+        const int32_t ring_height = tilemap->ring_height << tilemap->char_shift;
+
+        vdp2_scrn_scroll_x_set(scroll_screen,
+            fix16_int32_from(x & (ring_width - 1)));
+        vdp2_scrn_scroll_y_set(scroll_screen,
+            fix16_int32_from(y & (ring_height - 1)));
+
+        if (tilemap->xfer_count == 0) {
+                return;
+        }
+
+        tilemap->xfer_table[tilemap->xfer_count - 1].src |=
+            SCU_DMA_INDIRECT_TABLE_END;
+
+        int8_t ret __unused;
+        ret = dma_queue_enqueue(&tilemap->handle, DMA_QUEUE_TAG_VBLANK_IN,
+            NULL, NULL);
+        assert(ret == 0);
+}
+
+static void
+_full_add(vdp2_tilemap_t *tilemap, int32_t tx, int32_t ty)
+{
+        for (uint32_t row = 0; row < tilemap->window_height; row++) {
+                bool added __unused;
+                added = _row_add(tilemap, ty + row, tx, tilemap->window_width);
+                assert(added);
+        }
+}
+
+/* Add only the rows and columns of the window at (tx,ty) that aren't in the
+ * resident window. Returns false if the window moved too far, or if the
+ * transfer table is too small */
+static bool
+_incremental_add(vdp2_tilemap_t *tilemap, int32_t tx, int32_t ty)
+{
+        const int32_t width = tilemap->window_width;
+        const int32_t height = tilemap->window_height;
+
+        const int32_t dx = tx - tilemap->tx;
+        const int32_t dy = ty - tilemap->ty;
+
+        if ((abs(dx) >= width) || (abs(dy) >= height)) {
+                return false;
+        }
+
+        /* Newly exposed rows span the entire window */
+        const int32_t row_start = (dy > 0) ? (tilemap->ty + height) : ty;
+        const int32_t row_end = (dy > 0) ? (ty + height) : tilemap->ty;
+
+        for (int32_t row = row_start; row < row_end; row++) {
+                if (!(_row_add(tilemap, row, tx, width))) {
+                        return false;
+                }
+        }
+
+        /* Newly exposed columns only span the rows kept from the resident
+         * window */
+        const int32_t column_start = (dx > 0) ? (tilemap->tx + width) : tx;
+        const int32_t column_end = (dx > 0) ? (tx + width) : tilemap->tx;
+
+        const int32_t kept_start = (dy > 0) ? ty : tilemap->ty;
+        const int32_t kept_end = (dy > 0) ? (tilemap->ty + height) : (ty + height);
+
+        for (int32_t column = column_start; column < column_end; column++) {
+                for (int32_t row = kept_start; row < kept_end; row++) {
+                        if (!(_cell_add(tilemap, column, row))) {
+                                return false;
+                        }
+                }
+        }
+
+        return true;
+}
+
+static bool
+_row_add(vdp2_tilemap_t *tilemap, int32_t wy, int32_t wx, uint32_t count)
+{
+        const uint32_t page_mask = (1 << tilemap->page_shift) - 1;
+
+        while (count > 0) {
+                const uint32_t sx = _wrap(wx, tilemap->width);
+                const uint32_t rx = wx & (tilemap->ring_width - 1);
+
+                /* Split the run at the edge of the world map, and at page
+                 * boundaries (which includes the edge of the ring) */
+                uint32_t run;
+                run = count;
+
+                if (run > (tilemap->width - sx)) {
+                        run = tilemap->width - sx;
+                }
+
+                if (run > ((page_mask + 1) - (rx & page_mask))) {
+                        run = (page_mask + 1) - (rx & page_mask);
+                }
+
+                if (!(_xfer_add(tilemap, wx, wy, run))) {
+                        return false;
+                }
+
+                wx += run;
+                count -= run;
+        }
+
+        return true;
+}
+
+static bool
+_cell_add(vdp2_tilemap_t *tilemap, int32_t wx, int32_t wy)
+{
+        return _xfer_add(tilemap, wx, wy, 1);
+}
+
+static bool
+_xfer_add(vdp2_tilemap_t *tilemap, int32_t wx, int32_t wy, uint32_t count)
+{
+        if (tilemap->xfer_count == VDP2_TILEMAP_XFER_COUNT) {
+                return false;
+        }
+
+        const uint32_t sx = _wrap(wx, tilemap->width);
+        const uint32_t sy = _wrap(wy, tilemap->height);
+        const uint32_t rx = wx & (tilemap->ring_width - 1);
+        const uint32_t ry = wy & (tilemap->ring_height - 1);
+
+        const uint32_t src = (uint32_t)tilemap->map +
+            (((sy * tilemap->width) + sx) * tilemap->pnd_bytes);
+
+        scu_dma_xfer_t * const xfer =
+            &tilemap->xfer_table[tilemap->xfer_count];
+
+        xfer->len = count * tilemap->pnd_bytes;
+        xfer->dst = _vram_calculate(tilemap, rx, ry);
+        xfer->src = CPU_CACHE_THROUGH | src;
+
+        tilemap->xfer_count++;
+
+        return true;
+}
+
+static vdp2_vram_t
+_vram_calculate(const vdp2_tilemap_t *tilemap, uint32_t rx, uint32_t ry)
+{
+        const uint32_t page_shift = tilemap->page_shift;
+        const uint32_t page_mask = (1 << page_shift) - 1;
+
+        const uint32_t plane_width = tilemap->plane_width << page_shift;
+        const uint32_t plane_height = tilemap->plane_height << page_shift;
+
+        const uint32_t plane = ((ry >= plane_height) ? 2 : 0) +
+                               ((rx >= plane_width) ? 1 : 0);
+
+        const uint32_t px = rx & (plane_width - 1);
+        const uint32_t py = ry & (plane_height - 1);
+
+        const uint32_t page = ((py >> page_shift) * tilemap->plane_width) +
+                              (px >> page_shift);
+
+        const uint32_t cell = (page << (page_shift << 1)) +
+                              ((py & page_mask) << page_shift) +
+                              (px & page_mask);
+
+        return (tilemap->cell_format->map_bases.planes[plane] +
+            (cell * tilemap->pnd_bytes));
+}
@@ -0,0 +1,499 @@
+/*
+ * Copyright (c) 2012-2019 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <assert.h>
+#include <string.h>
+
+#include <vdp2/scrn.h>
+#include <vdp2/vram.h>
+#include <vdp2/vram_layout.h>
+
+#include "vdp-internal.h"
+
+#define BANK_COUNT              (4)
+#define TIMING_COUNT            (8)
+#define TIMING_COUNT_HIRES      (4)
+
+#define TIMING_FREE             (0xFF)
+
+/* Character pattern table lead addresses are in units of cells */
+#define CPD_ALIGNMENT           (0x20)
+
+struct layout_state {
+        uint8_t timings[BANK_COUNT][TIMING_COUNT];
+        uint32_t offsets[BANK_COUNT];
+};
+
+struct layout_item {
+        vdp2_vram_layout_scrn_t *scrn;
+
+        /* Number of character pattern (or bitmap) data accesses required in
+         * each bank the data resides in */
+        uint8_t access_count;
+        uint32_t plane_size;
+        uint32_t data_size;
+
+        uint8_t pnd_bank;
+        uint32_t pnd_offset;
+        uint8_t cpd_bank;
+        uint32_t cpd_offset;
+};
+
+struct layout {
+        struct layout_item items[VDP2_VRAM_LAYOUT_SCRN_COUNT_MAX];
+        uint8_t count;
+
+        uint8_t timing_count;
+        const uint8_t *cpd_timings;
+
+        struct layout_state state;
+};
+
+/*-
+ * Bitmask of the timings at which character pattern data can be read, indexed
+ * by the timing at which the pattern name data of the same scroll screen is
+ * read.
+ *
+ * +-----+------------------------+------------+
+ * | PND | CPD (normal)           | CPD (hi)   |
+ * +-----+------------------------+------------+
+ * | T0  | T0,T1,T2,T4,T5,T6,T7   | T0,T1,T2   |
+ * | T1  | T0,T1,T2,T3,T5,T6,T7   | T1,T2,T3   |
+ * | T2  | T0,T1,T2,T3,T6,T7      | T2,T3      |
+ * | T3  | T0,T1,T2,T3,T7         | T3         |
+ * | T4  | T0,T1,T2,T3            |            |
+ * | T5  | T1,T2,T3               |            |
+ * | T6  | T2,T3                  |            |
+ * | T7  | T3                     |            |
+ * +-----+------------------------+------------+ */
+static const uint8_t _cpd_timings_normal[TIMING_COUNT] = {
+        0xF7,
+        0xEF,
+        0xCF,
+        0x8F,
+        0x0F,
+        0x0E,
+        0x0C,
+        0x08
+};
+
+static const uint8_t _cpd_timings_hires[TIMING_COUNT] = {
+        0x07,
+        0x0E,
+        0x0C,
+        0x08,
+        0x00,
+        0x00,
+        0x00,
+        0x00
+};
+
+static uint8_t _access_count_get(vdp2_scrn_ccc_t);
+static uint32_t _bitmap_size_get(const vdp2_scrn_bitmap_format_t *);
+static void _items_sort(struct layout *);
+static bool _bank_duplicate(const struct layout_state *, uint8_t);
+static bool _timings_take(const struct layout *, struct layout_state *,
+    uint8_t, uint8_t, uint8_t, uint8_t);
+static bool _solve(struct layout *, const struct layout_state *, uint8_t);
+static bool _solve_bitmap(struct layout *, const struct layout_state *,
+    uint8_t);
+static bool _solve_cell(struct layout *, const struct layout_state *,
+    uint8_t);
+static void _results_write(const struct layout *, vdp2_vram_cycp_t *);
+
+bool
+vdp2_vram_layout_solve(vdp2_vram_layout_scrn_t *scrns, uint8_t count,
+    vdp2_vram_cycp_t *cycp)
+{
+        assert(scrns != NULL);
+        assert(cycp != NULL);
+        assert((count > 0) && (count <= VDP2_VRAM_LAYOUT_SCRN_COUNT_MAX));
+
+        static struct layout layout;
+
+        (void)memset(&layout, 0x00, sizeof(layout));
+
+        if (_state_vdp2()->tv.resolution.x >= 640) {
+                layout.timing_count = TIMING_COUNT_HIRES;
+                layout.cpd_timings = _cpd_timings_hires;
+        } else {
+                layout.timing_count = TIMING_COUNT;
+                layout.cpd_timings = _cpd_timings_normal;
+        }
+
+        (void)memset(layout.state.timings, TIMING_FREE,
+            sizeof(layout.state.timings));
+
+        uint32_t access_total;
+        access_total = 0;
+
+        for (uint32_t i = 0; i < count; i++) {
+                vdp2_vram_layout_scrn_t * const scrn = &scrns[i];
+                struct layout_item * const item = &layout.items[i];
+
+                assert((scrn->cell_format == NULL) != (scrn->bitmap_format == NULL));
+
+                item->scrn = scrn;
+
+                if (scrn->cell_format != NULL) {
+                        const vdp2_scrn_cell_format_t * const format =
+                            scrn->cell_format;
+
+                        assert(format->scroll_screen <= VDP2_SCRN_NBG3);
+                        assert((scrn->plane_count > 0) && (scrn->plane_count <= 4));
+
+                        item->access_count = _access_count_get(format->cc_count);
+                        item->plane_size = VDP2_SCRN_CALCULATE_PLANE_SIZE(format);
+                        item->data_size = scrn->cpd_size;
+
+                        /* One pattern name data access */
+                        access_total += item->access_count + 1;
+                } else {
+                        const vdp2_scrn_bitmap_format_t * const format =
+                            scrn->bitmap_format;
+
+                        assert(format->scroll_screen <= VDP2_SCRN_NBG1);
+
+                        item->access_count = _access_count_get(format->cc_count);
+                        item->data_size = _bitmap_size_get(format);
+
+                        const uint32_t bank_span =
+                            (item->data_size + VDP2_VRAM_BSIZE_4 - 1) / VDP2_VRAM_BSIZE_4;
+
+                        access_total += item->access_count * bank_span;
+                }
+        }
+
+        layout.count = count;
+
+        if (access_total > (uint32_t)(BANK_COUNT * layout.timing_count)) {
+                return false;
+        }
+
+        _items_sort(&layout);
+
+        if (!(_solve(&layout, &layout.state, 0))) {
+                return false;
+        }
+
+        _results_write(&layout, cycp);
+
+        return true;
+}
+
+static uint8_t
+_access_count_get(vdp2_scrn_ccc_t cc_count)
+{
+        switch (cc_count) {
+        case VDP2_SCRN_CCC_PALETTE_16:
+                return 1;
+        case VDP2_SCRN_CCC_PALETTE_256:
+                return 2;
+        case VDP2_SCRN_CCC_PALETTE_2048:
+        case VDP2_SCRN_CCC_RGB_32768:
+                return 4;
+        case VDP2_SCRN_CCC_RGB_16770000:
+        default:
+                return 8;
+        }
+}
+
+static uint32_t
+_bitmap_size_get(const vdp2_scrn_bitmap_format_t *format)
+{
+        const uint32_t dot_count =
+            format->bitmap_size.width * format->bitmap_size.height;
+
+        switch (format->cc_count) {
+        case VDP2_SCRN_CCC_PALETTE_16:
+                return (dot_count >> 1);
+        case VDP2_SCRN_CCC_PALETTE_256:
+                return dot_count;
+        case VDP2_SCRN_CCC_PALETTE_2048:
+        case VDP2_SCRN_CCC_RGB_32768:
+                return (dot_count << 1);
+        case VDP2_SCRN_CCC_RGB_16770000:
+        default:
+                return (dot_count << 2);
+        }
+}
+
+/* Bitmaps must start on a bank boundary, so place them first. Then place the
+ * scroll screens requiring the most accesses */
+static void
+_items_sort(struct layout *layout)
+{
+        for (uint32_t i = 1; i < layout->count; i++) {
+                const struct layout_item item = layout->items[i];
+
+                const uint32_t key = ((item.scrn->bitmap_format != NULL) << 8) |
+                                     item.access_count;
+
+                int32_t j;
+
+                for (j = i - 1; j >= 0; j--) {
+                        const struct layout_item * const other_item =
+                            &layout->items[j];
+
+                        const uint32_t other_key =
+                            ((other_item->scrn->bitmap_format != NULL) << 8) |
+                            other_item->access_count;
+
+                        if (other_key >= key) {
+                                break;
+                        }
+
+                        layout->items[j + 1] = *other_item;
+                }
+
+                layout->items[j + 1] = item;
+        }
+}
+
+/* Banks in the same state are interchangeable. Skipping all but the first one
+ * keeps the search from exploring symmetric layouts */
+static bool
+_bank_duplicate(const struct layout_state *state, uint8_t bank)
+{
+        for (uint32_t i = 0; i < bank; i++) {
+                if (state->offsets[i] != state->offsets[bank]) {
+                        continue;
+                }
+
+                if ((memcmp(state->timings[i], state->timings[bank],
+                            TIMING_COUNT)) == 0) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+/* Take the first free timings allowed by the mask */
+static bool
+_timings_take(const struct layout *layout, struct layout_state *state,
+    uint8_t bank, uint8_t mask, uint8_t count, uint8_t code)
+{
+        uint8_t * const timings = state->timings[bank];
+
+        for (uint32_t t = 0; (t < layout->timing_count) && (count > 0); t++) {
+                if ((mask & (1 << t)) == 0x00) {
+                        continue;
+                }
+
+                if (timings[t] != TIMING_FREE) {
+                        continue;
+                }
+
+                timings[t] = code;
+
+                count--;
+        }
+
+        return (count == 0);
+}
+
+static bool
+_solve(struct layout *layout, const struct layout_state *state, uint8_t index)
+{
+        if (index == layout->count) {
+                layout->state = *state;
+
+                return true;
+        }
+
+        if (layout->items[index].scrn->bitmap_format != NULL) {
+                return _solve_bitmap(layout, state, index);
+        }
+
+        return _solve_cell(layout, state, index);
+}
+
+static bool
+_solve_bitmap(struct layout *layout, const struct layout_state *state,
+    uint8_t index)
+{
+        struct layout_item * const item = &layout->items[index];
+
+        const vdp2_scrn_t scroll_screen = item->scrn->bitmap_format->scroll_screen;
+
+        const uint32_t bank_span =
+            (item->data_size + VDP2_VRAM_BSIZE_4 - 1) / VDP2_VRAM_BSIZE_4;
+
+        for (uint32_t bank = 0; (bank + bank_span) <= BANK_COUNT; bank++) {
+                if (_bank_duplicate(state, bank)) {
+                        continue;
+                }
+
+                struct layout_state next_state;
+                next_state = *state;
+
+                uint32_t remaining_size;
+                remaining_size = item->data_size;
+
+                uint32_t i;
+
+                for (i = bank; i < (bank + bank_span); i++) {
+                        if (next_state.offsets[i] != 0) {
+                                break;
+                        }
+
+                        if (!(_timings_take(layout, &next_state, i, 0xFF,
+                                    item->access_count,
+                                    VDP2_VRAM_CYCP_CHPNDR(scroll_screen)))) {
+                                break;
+                        }
+
+                        const uint32_t size = (remaining_size > VDP2_VRAM_BSIZE_4)
+                            ? VDP2_VRAM_BSIZE_4
+                            : remaining_size;
+
+                        next_state.offsets[i] = size;
+                        remaining_size -= size;
+                }
+
+                if (i != (bank + bank_span)) {
+                        continue;
+                }
+
+                item->cpd_bank = bank;
+                item->cpd_offset = 0;
+
+                if (_solve(layout, &next_state, index + 1)) {
+                        return true;
+                }
+        }
+
+        return false;
+}
+
+static bool
+_solve_cell(struct layout *layout, const struct layout_state *state,
+    uint8_t index)
+{
+        struct layout_item * const item = &layout->items[index];
+
+        const vdp2_scrn_t scroll_screen = item->scrn->cell_format->scroll_screen;
+
+        const uint32_t planes_size = item->plane_size * item->scrn->plane_count;
+
+        for (uint32_t pnd_bank = 0; pnd_bank < BANK_COUNT; pnd_bank++) {
+                if (_bank_duplicate(state, pnd_bank)) {
+                        continue;
+                }
+
+                /* Planes are aligned to their size */
+                const uint32_t pnd_offset =
+                    (state->offsets[pnd_bank] + item->plane_size - 1) &
+                    ~(item->plane_size - 1);
+
+                if ((pnd_offset + planes_size) > VDP2_VRAM_BSIZE_4) {
+                        continue;
+                }
+
+                for (uint32_t t = 0; t < layout->timing_count; t++) {
+                        if (state->timings[pnd_bank][t] != TIMING_FREE) {
+                                continue;
+                        }
+
+                        struct layout_state pnd_state;
+                        pnd_state = *state;
+
+                        pnd_state.timings[pnd_bank][t] =
+                            VDP2_VRAM_CYCP_PNDR(scroll_screen);
+                        pnd_state.offsets[pnd_bank] = pnd_offset + planes_size;
+
+                        for (uint32_t cpd_bank = 0; cpd_bank < BANK_COUNT; cpd_bank++) {
+                                if ((cpd_bank != pnd_bank) &&
+                                    (_bank_duplicate(&pnd_state, cpd_bank))) {
+                                        continue;
+                                }
+
+                                const uint32_t cpd_offset =
+                                    (pnd_state.offsets[cpd_bank] + CPD_ALIGNMENT - 1) &
+                                    ~(CPD_ALIGNMENT - 1);
+
+                                if ((cpd_offset + item->data_size) > VDP2_VRAM_BSIZE_4) {
+                                        continue;
+                                }
+
+                                struct layout_state cpd_state;
+                                cpd_state = pnd_state;
+
+                                if (!(_timings_take(layout, &cpd_state, cpd_bank,
+                                            layout->cpd_timings[t],
+                                            item->access_count,
+                                            VDP2_VRAM_CYCP_CHPNDR(scroll_screen)))) {
+                                        continue;
+                                }
+
+                                cpd_state.offsets[cpd_bank] = cpd_offset + item->data_size;
+
+                                item->pnd_bank = pnd_bank;
+                                item->pnd_offset = pnd_offset;
+                                item->cpd_bank = cpd_bank;
+                                item->cpd_offset = cpd_offset;
+
+                                if (_solve(layout, &cpd_state, index + 1)) {
+                                        return true;
+                                }
+                        }
+                }
+        }
+
+        return false;
+}
+
+static void
+_results_write(const struct layout *layout, vdp2_vram_cycp_t *cycp)
+{
+        for (uint32_t i = 0; i < layout->count; i++) {
+                const struct layout_item * const item = &layout->items[i];
+
+                if (item->scrn->bitmap_format != NULL) {
+                        vdp2_scrn_bitmap_format_t * const format =
+                            item->scrn->bitmap_format;
+
+                        format->bitmap_pattern =
+                            VDP2_VRAM_ADDR(item->cpd_bank, item->cpd_offset);
+
+                        continue;
+                }
+
+                vdp2_scrn_cell_format_t * const format = item->scrn->cell_format;
+
+                format->cp_table = VDP2_VRAM_ADDR(item->cpd_bank, item->cpd_offset);
+
+                for (uint32_t p = 0; p < 4; p++) {
+                        const uint32_t plane_offset = item->pnd_offset +
+                            ((p % item->scrn->plane_count) * item->plane_size);
+
+                        format->map_bases.planes[p] =
+                            VDP2_VRAM_ADDR(item->pnd_bank, plane_offset);
+                }
+        }
+
+        for (uint32_t bank = 0; bank < BANK_COUNT; bank++) {
+                uint32_t raw;
+                raw = 0x00000000;
+
+                for (uint32_t t = 0; t < TIMING_COUNT; t++) {
+                        uint32_t code;
+                        code = layout->state.timings[bank][t];
+
+                        if (t >= layout->timing_count) {
+                                code = VDP2_VRAM_CYCP_NO_ACCESS;
+                        } else if (code == TIMING_FREE) {
+                                code = VDP2_VRAM_CYCP_CPU_RW;
+                        }
+
+                        raw |= code << (28 - (t << 2));
+                }
+
+                cycp->pt[bank].raw = raw;
+        }
+}
@@ -12,13 +12,17 @@
 
 #include <cpu/cache.h>
 #include <cpu/dmac.h>
+#include <cpu/frt.h>
 #include <cpu/intc.h>
 
 #include <scu/ic.h>
 
+#include <mm/arena.h>
+
 #include <vdp.h>
 
 #include <sys/dma-queue.h>
+#include <sys/prof.h>
 
 #include "vdp-internal.h"
 
@@ -79,6 +83,8 @@
 #define VDP1_PTMR_PLOT                  (0x0001)
 #define VDP1_PTMR_AUTO                  (0x0002)
 
+#define VDP1_CMDT_JUMP_SKIP_ASSIGN      (0x5000)
+
 #ifdef VDP_SYNC_DEBUG
 #include <dbgio.h>
 
@@ -124,6 +130,25 @@ static_assert(sizeof(struct vdp1_state) == 4);
 static_assert(sizeof(struct vdp2_state) == 4);
 static_assert(sizeof(_state) == 12);
 
+/* Command table regions the VDP1 entry jump alternates between */
+static volatile struct {
+        vdp1_cmdt_t *regions[VDP1_SYNC_BUFFER_COUNT_MAX];
+        uint16_t region_count; /* Number of command tables per region */
+        uint8_t count;         /* Number of regions */
+        uint8_t back;          /* Region written to by the CPU */
+        uint8_t front;         /* Region last handed over to the VDP1 */
+        bool pending;          /* Front region waits for the frame change */
+        bool drawing;          /* VDP1 is drawing the front region */
+} _vdp1_buffering;
+
+/* Frame timing statistics */
+static volatile struct {
+        vdp_sync_stats_t stats;
+        uint16_t vdp1_draw_start;
+        uint16_t vblank_in_start;
+        bool vdp1_drawing;
+} _stats;
+
 static callback_t _user_vdp1_sync_callback;
 static callback_t _user_vblank_in_callback;
 static callback_t _user_vblank_out_callback;
@@ -185,6 +210,9 @@ static const struct {
 }, *_current_vdp1_mode; /* Pointer to the current VDP1 mode */
 
 static void _vdp1_init(void);
+static void _vdp1_buffer_swap(void);
+static void _vdp1_buffer_commit(void);
+static void _vdp1_plot_start(void);
 
 static inline __always_inline void _vdp1_sync_put_call(const void *);
 static inline __always_inline void _vdp1_dma_call(const void *);
@@ -200,6 +228,10 @@ static void _vdp2_init(void);
 static void _vdp2_registers_transfer(cpu_dmac_cfg_t *);
 static void _vdp2_back_screen_transfer(cpu_dmac_cfg_t *);
 
+static void _stats_vdp1_draw_start(void);
+static void _stats_ticks_update(volatile uint16_t *, volatile uint16_t *,
+    uint16_t);
+
 static void _vblank_in_handler(void);
 static void _vblank_out_handler(void);
 static void _sprite_end_handler(void);
@@ -227,6 +259,8 @@ _internal_vdp_sync_init(void)
         _state.vdp1.interval_mode = VDP1_INTERVAL_MODE_AUTO;
         _state.vdp2.flags = VDP2_FLAG_IDLE;
 
+        (void)memset((void *)&_stats, 0x00, sizeof(_stats));
+
         _vdp1_init();
         _vdp2_init();
 
@@ -246,6 +280,8 @@ vdp_sync(void)
 {
         DEBUG_PRINTF("vdp_sync: Enter\n");
 
+        prof_zone_begin(PROF_ZONE_VDP_SYNC);
+
         const uint32_t intc_mask = cpu_intc_mask_get();
 
         /* Wait for DMA queue to finish flushing, prior to syncing */
@@ -254,6 +290,12 @@ vdp_sync(void)
 
         cpu_intc_mask_set(15);
 
+        /* All command tables for this frame have been transferred, so hand
+         * the region over to the VDP1 */
+        if ((_state.vdp1.flags & VDP1_FLAG_REQUEST_XFER_LIST) != 0x00) {
+                _vdp1_buffer_swap();
+        }
+
         scu_dma_handle_t *handle;
         handle = _state_vdp2()->commit.handle;
 
@@ -289,8 +331,15 @@ vdp_sync(void)
                         _state.vdp2.flags &= ~VDP2_FLAG_REQUEST_COMMIT;
                         _state.vdp2.flags |= VDP2_FLAG_COMITTING;
 
+                        const uint16_t dma_start = cpu_frt_count_get();
+
                         ret = dma_queue_flush(DMA_QUEUE_TAG_VBLANK_IN);
                         assert(ret >= 0);
+
+                        dma_queue_flush_wait();
+
+                        _stats_ticks_update(&_stats.stats.vblank_in_dma_ticks,
+                            &_stats.stats.vblank_in_dma_ticks_max, dma_start);
                 }
 
                 dma_queue_flush_wait();
@@ -314,6 +363,15 @@ vdp_sync(void)
 
         callback_list_process(_user_callback_list, /* clear = */ true);
 
+        /* Transfers enqueued this frame have completed, so the frame arena of
+         * the previous frame can be reused */
+        frame_arena_swap();
+
+        _stats.stats.frame_count++;
+
+        prof_zone_end(PROF_ZONE_VDP_SYNC);
+        prof_frame_end();
+
         _state.flags &= ~SYNC_FLAG_MASK;
         _state.vdp1.flags &= ~VDP1_FLAG_MASK;
         _state.vdp2.flags &= ~VDP2_FLAG_MASK;
@@ -362,6 +420,72 @@ vdp1_sync_interval_set(const int8_t interval)
         _current_vdp1_mode = &_vdp1_mode_table[mode];
 }
 
+void
+vdp1_sync_buffering_set(uint8_t count)
+{
+        assert((count > 0) && (count <= VDP1_SYNC_BUFFER_COUNT_MAX));
+
+        /* Wait until the previous command table list transfer is done */
+        if ((_state.vdp1.flags & VDP1_FLAG_REQUEST_XFER_LIST) != 0x00) {
+                while ((_state.vdp1.flags & VDP1_FLAG_LIST_XFERRED) == 0x00) {
+                }
+        }
+
+        const vdp1_vram_partitions_t * const vram_partitions =
+            _state_vdp1()->vram_partitions;
+
+        const uint16_t region_count =
+            (vram_partitions->cmdt_size / sizeof(vdp1_cmdt_t)) / count;
+
+        assert(region_count > 0);
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        _vdp1_buffering.count = count;
+        _vdp1_buffering.back = 0;
+        _vdp1_buffering.front = 0;
+        _vdp1_buffering.pending = false;
+        _vdp1_buffering.drawing = false;
+        _vdp1_buffering.region_count = region_count;
+
+        for (uint32_t i = 0; i < count; i++) {
+                _vdp1_buffering.regions[i] =
+                    &vram_partitions->cmdt_base[i * region_count];
+        }
+
+        /* Leave an end command table at the entry point so that nothing stale
+         * is drawn until the first region is committed. With a single region,
+         * the command tables are written to the entry point directly */
+        if (count > 1) {
+                MEMORY_WRITE(16, VDP1_VRAM(0x0000), 0x8000);
+        }
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+uint8_t
+vdp1_sync_buffering_get(void)
+{
+        return _vdp1_buffering.count;
+}
+
+vdp1_cmdt_t *
+vdp1_sync_cmdt_buffer_get(void)
+{
+        if (_vdp1_buffering.count <= 1) {
+                return (vdp1_cmdt_t *)VDP1_VRAM(0x0000);
+        }
+
+        return _vdp1_buffering.regions[_vdp1_buffering.back];
+}
+
+uint16_t
+vdp1_sync_cmdt_buffer_count_get(void)
+{
+        return _vdp1_buffering.region_count;
+}
+
 vdp_sync_mode_t
 vdp1_sync_mode_get(void)
 {
@@ -453,6 +577,34 @@ vdp2_sync_commit(void)
         _state.vdp2.flags |= VDP2_FLAG_COMMITTED;
 }
 
+void
+vdp_sync_stats_get(vdp_sync_stats_t *stats)
+{
+        assert(stats != NULL);
+
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        (void)memcpy(stats, (const void *)&_stats.stats, sizeof(vdp_sync_stats_t));
+
+        cpu_intc_mask_set(intc_mask);
+}
+
+void
+vdp_sync_stats_reset(void)
+{
+        const uint32_t intc_mask = cpu_intc_mask_get();
+        cpu_intc_mask_set(15);
+
+        _stats.stats.frame_count = 0;
+        _stats.stats.vdp1_draw_ticks_max = 0;
+        _stats.stats.vblank_in_dma_ticks_max = 0;
+        _stats.stats.cpu_dropped_count = 0;
+        _stats.stats.vdp1_dropped_count = 0;
+
+        cpu_intc_mask_set(intc_mask);
+}
+
 void
 vdp_sync_vblank_in_set(vdp_sync_callback_t callback)
 {
@@ -492,6 +644,63 @@ _vdp1_init(void)
 
         vdp1_sync_mode_set(VDP1_SYNC_MODE_ERASE_CHANGE);
         vdp1_sync_interval_set(VDP1_SYNC_INTERVAL_60HZ);
+
+        _vdp1_buffering.count = 1;
+        _vdp1_buffering.back = 0;
+        _vdp1_buffering.front = 0;
+        _vdp1_buffering.pending = false;
+        _vdp1_buffering.drawing = false;
+        _vdp1_buffering.region_count =
+            _state_vdp1()->vram_partitions->cmdt_size / sizeof(vdp1_cmdt_t);
+        _vdp1_buffering.regions[0] = _state_vdp1()->vram_partitions->cmdt_base;
+}
+
+static void
+_vdp1_buffer_swap(void)
+{
+        if (_vdp1_buffering.count <= 1) {
+                return;
+        }
+
+        const uint8_t back = _vdp1_buffering.back;
+
+        _vdp1_buffering.front = back;
+        _vdp1_buffering.back = (back + 1) % _vdp1_buffering.count;
+
+        /* In variable mode, the region is committed at the next frame change
+         * where the VDP1 is done drawing the previous one. The region written
+         * to next is then no longer read from */
+        if (_state.vdp1.interval_mode == VDP1_INTERVAL_MODE_VARIABLE) {
+                _vdp1_buffering.pending = true;
+
+                return;
+        }
+
+        _vdp1_buffer_commit();
+}
+
+static void
+_vdp1_buffer_commit(void)
+{
+        /* Point the entry jump at the front region. The VDP1 only reads the
+         * entry command table when it starts drawing, so this takes effect on
+         * the next plot */
+        const uint32_t link =
+            ((uint32_t)_vdp1_buffering.regions[_vdp1_buffering.front] -
+                VDP1_VRAM(0x0000)) >> 3;
+
+        MEMORY_WRITE(16, VDP1_VRAM(0x0002), link);
+        MEMORY_WRITE(16, VDP1_VRAM(0x0000), VDP1_CMDT_JUMP_SKIP_ASSIGN);
+}
+
+static void
+_vdp1_plot_start(void)
+{
+        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_IDLE);
+        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_PLOT);
+        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_PLOT);
+
+        _stats_vdp1_draw_start();
 }
 
 static inline void __always_inline
@@ -547,7 +756,12 @@ _vdp1_mode_auto_sync_put(const void *args_ptr)
 
         cpu_intc_mask_set(intc_mask);
 
-        const uint32_t vdp1_vram = VDP1_VRAM(args->index);
+        /* The index is in command tables, from the start of the region */
+        assert((args->index + args->count) <= _vdp1_buffering.region_count);
+
+        vdp1_cmdt_t * const region = vdp1_sync_cmdt_buffer_get();
+
+        const uint32_t vdp1_vram = (uint32_t)&region[args->index];
 
         switch (args->transfer_type) {
         case TRANSFER_TYPE_BUFFER:
@@ -590,7 +804,7 @@ _vdp1_mode_auto_vblank_in(const void *args_ptr __unused)
 
         /* If we're still transferring, then abort */
         if ((flags_vdp1 & VDP1_FLAG_LIST_XFERRED) == 0x00) {
-                assert(false && "Exceeded transfer time");
+                _stats.stats.vdp1_dropped_count++;
 
                 return;
         }
@@ -608,6 +822,9 @@ _vdp1_mode_auto_vblank_in(const void *args_ptr __unused)
         MEMORY_WRITE(16, VDP1(FBCR), VDP1_FBCR_NONE);
         MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_IDLE);
         MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_AUTO);
+
+        /* Drawing starts with the frame change */
+        _stats_vdp1_draw_start();
 }
 
 static void
@@ -672,11 +889,15 @@ _vdp1_mode_variable_dma(const void *args_ptr __unused)
         _state.vdp1.flags |= VDP1_FLAG_LIST_XFERRED;
         _state.vdp1.flags |= VDP1_FLAG_REQUEST_COMMIT_LIST;
 
+        /* When buffering, drawing starts once the region is committed at the
+         * frame change */
+        if (_vdp1_buffering.count > 1) {
+                return;
+        }
+
         /* Since the DMA transfer went through, the VDP1 is idling, so start
          * drawing */
-        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_IDLE);
-        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_PLOT);
-        MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_PLOT);
+        _vdp1_plot_start();
 }
 
 static void
@@ -687,6 +908,8 @@ _vdp1_mode_variable_sprite_end(const void *args_ptr __unused)
         _state.vdp1.flags &= ~VDP1_FLAG_REQUEST_COMMIT_LIST;
         _state.vdp1.flags |= VDP1_FLAG_LIST_COMMITTED;
 
+        _vdp1_buffering.drawing = false;
+
         /* Move the plotter to idle, we are done drawing */
         /* MEMORY_WRITE(16, VDP1(PTMR), VDP1_PTMR_IDLE); */
 
@@ -696,6 +919,30 @@ _vdp1_mode_variable_sprite_end(const void *args_ptr __unused)
 static void
 _vdp1_mode_variable_vblank_in(const void *args_ptr __unused)
 {
+        /* When buffering, vdp_sync() only waits for the region to be
+         * committed. Change frame buffers to show what the VDP1 drew from the
+         * previous region, once it's done */
+        if (_vdp1_buffering.count > 1) {
+                if (!_vdp1_buffering.pending) {
+                        return;
+                }
+
+                if (_vdp1_buffering.drawing) {
+                        _stats.stats.vdp1_dropped_count++;
+
+                        return;
+                }
+
+                _state.vdp1.flags |= VDP1_FLAG_REQUEST_CHANGE;
+
+                _state_vdp1()->regs->tvmr |= VDP1_TVMR_VBE;
+
+                MEMORY_WRITE(16, VDP1(TVMR), _state_vdp1()->regs->tvmr);
+                MEMORY_WRITE(16, VDP1(FBCR), VDP1_FBCR_FCM_FCT);
+
+                return;
+        }
+
         /* Don't change frame buffers if we never sent a transfer list */
         if ((_state.vdp1.flags & VDP1_FLAG_LIST_COMMITTED) == 0x00) {
                 DEBUG_PRINTF("VBLANK-IN,!VDP1_FLAG_LIST_COMMITTED\n");
@@ -704,6 +951,9 @@ _vdp1_mode_variable_vblank_in(const void *args_ptr __unused)
 
         if ((vdp1_sync_rendering())) {
                 DEBUG_PRINTF("VBLANK-IN: Rendering!\n");
+
+                _stats.stats.vdp1_dropped_count++;
+
                 return;
         }
 
@@ -744,6 +994,16 @@ _vdp1_mode_variable_vblank_out(const void *args_ptr __unused)
         MEMORY_WRITE(16, VDP1(TVMR), _state_vdp1()->regs->tvmr);
 
         DEBUG_PRINTF("VBLANK-OUT,TVMR=$0\n");
+
+        /* The frame buffer to draw to was just erased, so draw the region
+         * vdp_sync() handed over */
+        if (_vdp1_buffering.pending) {
+                _vdp1_buffering.pending = false;
+                _vdp1_buffering.drawing = true;
+
+                _vdp1_buffer_commit();
+                _vdp1_plot_start();
+        }
 }
 
 static void
@@ -811,6 +1071,13 @@ _vdp1_cmdt_orderlist_transfer(const vdp1_cmdt_orderlist_t *cmdt_orderlist)
 static void
 _sprite_end_handler(void)
 {
+        if (_stats.vdp1_drawing) {
+                _stats.vdp1_drawing = false;
+
+                _stats_ticks_update(&_stats.stats.vdp1_draw_ticks,
+                    &_stats.stats.vdp1_draw_ticks_max, _stats.vdp1_draw_start);
+        }
+
         _vdp1_sprite_end_call(NULL);
 }
 
@@ -887,12 +1154,44 @@ _vdp2_dma_handler(const dma_queue_transfer_t *transfer)
         _state.vdp2.flags &= ~VDP2_FLAG_COMITTING;
 }
 
+/* Plotting restarts the draw, so the timing restarts along with it */
+static void
+_stats_vdp1_draw_start(void)
+{
+        _stats.vdp1_drawing = true;
+        _stats.vdp1_draw_start = cpu_frt_count_get();
+}
+
+static void
+_stats_ticks_update(volatile uint16_t *ticks, volatile uint16_t *ticks_max,
+    uint16_t start)
+{
+        /* Unsigned 16-bit arithmetic takes care of the FRT wrapping around */
+        const uint16_t elapsed = cpu_frt_count_get() - start;
+
+        *ticks = elapsed;
+
+        if (elapsed > *ticks_max) {
+                *ticks_max = elapsed;
+        }
+}
+
 static void
 _vblank_in_handler(void)
 {
+        _stats.vblank_in_start = cpu_frt_count_get();
+
         /* VBLANK-IN interrupt runs at scanline #224 */
         if ((_state.flags & SYNC_FLAG_SYNC) == 0x00) {
                 DEBUG_PRINTF("VBLANK-IN, !SYNC_FLAG_SYNC\n");
+
+                /* A frame is only dropped if command tables were put for it
+                 * and vdp_sync() wasn't reached in time. Otherwise, the CPU
+                 * simply isn't syncing every frame, e.g. running at 30Hz */
+                if ((_state.vdp1.flags & VDP1_FLAG_REQUEST_XFER_LIST) != 0x00) {
+                        _stats.stats.cpu_dropped_count++;
+                }
+
                 goto no_sync;
         }
 
@@ -911,6 +1210,8 @@ static void
 _vblank_out_handler(void)
 {
         /* VBLANK-OUT interrupt runs at scanline #511 */
+        _stats.stats.vblank_ticks =
+            cpu_frt_count_get() - _stats.vblank_in_start;
 
         if ((_state.flags & SYNC_FLAG_SYNC) == 0x00) {
                 DEBUG_PRINTF("VBLANK-OUT, !SYNC_FLAG_SYNC\n");
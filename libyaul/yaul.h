@@ -61,7 +61,10 @@
 
 #include <math.h>
 
+#include <mm/arena.h>
+#include <mm/heap.h>
 #include <mm/memb.h>
+#include <mm/stats.h>
 
 #if defined(MALLOC_IMPL_TLSF)
 #include <mm/tlsf.h>
@@ -69,6 +72,7 @@
 
 #include <sys/init.h>
 #include <sys/dma-queue.h>
+#include <sys/prof.h>
 
 #include <fs/iso9660/iso9660.h>
 #include <fs/romdisk/romdisk.h>
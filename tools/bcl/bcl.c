@@ -1,5 +1,825 @@
+/*
+ * Copyright (c) 2012-2016 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bcl.h"
+
+#define PROGNAME "bcl"
+
+/* Maximum LZ offset, same as the default in libbcl */
+#define LZ_MAX_OFFSET           100000
+
+#define RICE_FMT_UINT8          2
+#define RICE_FMT_UINT16         4
+#define RICE_FMT_UINT32         8
+
+/* Minimum time spent decompressing each codec when benchmarking */
+#define BENCH_TIME_MIN          0.25
+
+#define JOBS_MAX                256
+
+int Huffman_Compress(unsigned char *, unsigned char *, unsigned int);
+int LZ_Compress(unsigned char *, unsigned char *, unsigned int, unsigned long);
+int LZ_CompressOptimal(unsigned char *, unsigned char *, unsigned int, unsigned long);
+int Rice_Compress(void *, void *, unsigned int, int);
+int RLE_Compress(unsigned char *, unsigned char *, unsigned int);
+int SF_Compress(unsigned char *, unsigned char *, unsigned int);
+uint32_t lzb_compress(void *, void *, uint32_t);
+uint32_t prs_compress(void *, void *, uint32_t);
+
+struct codec {
+        const char *name;
+        uint8_t id;
+        uint8_t param;
+        /* Size of a sample, in bytes */
+        uint8_t width;
+        /* Spend more time compressing for a smaller output */
+        bool optimal;
+};
+
+static const struct codec _codecs[] = {
+        { "none",       BCL_CODEC_NONE,    0,               1, false },
+        { "huffman",    BCL_CODEC_HUFFMAN, 0,               1, false },
+        { "lz",         BCL_CODEC_LZ,      0,               1, false },
+        { "lz-optimal", BCL_CODEC_LZ,      0,               1, true  },
+        { "lzb",        BCL_CODEC_LZB,     0,               1, false },
+        { "prs",        BCL_CODEC_PRS,     0,               1, false },
+        { "rice8",      BCL_CODEC_RICE,    RICE_FMT_UINT8,  1, false },
+        { "rice16",     BCL_CODEC_RICE,    RICE_FMT_UINT16, 2, false },
+        { "rice32",     BCL_CODEC_RICE,    RICE_FMT_UINT32, 4, false },
+        { "rle",        BCL_CODEC_RLE,     0,               1, false },
+        { "sf",         BCL_CODEC_SF,      0,               1, false },
+        { NULL,         0,                 0,               0, false }
+};
+
+static struct {
+        bool d_set;
+        bool b_set;
+        const struct codec *codec;
+        bool best;
+        char *output_filepath;
+        uint32_t jobs;
+} _global_options = {
+        .d_set = false,
+        .b_set = false,
+        .codec = &_codecs[2],
+        .best = false,
+        .output_filepath = NULL,
+        .jobs = 0
+};
+
+/* Input files shared by the worker threads */
+static struct {
+        pthread_mutex_t mutex;
+        char **filepaths;
+        uint32_t count;
+        uint32_t next;
+        int exit_code;
+} _work = {
+        .mutex = PTHREAD_MUTEX_INITIALIZER,
+        .filepaths = NULL,
+        .count = 0,
+        .next = 0,
+        .exit_code = 0
+};
+
+static void _usage(void);
+
+static const struct codec *_codec_find(const char *);
+
+static uint8_t *_file_read(const char *, uint32_t *);
+static int _file_write(const char *, const uint8_t *, uint32_t);
+
+static uint32_t _checksum(const uint8_t *, uint32_t);
+static void _header_write(uint8_t *, const bcl_header_t *);
+static int _header_read(const uint8_t *, uint32_t, bcl_header_t *);
+
+static int32_t _compress(const struct codec *, uint8_t *, uint32_t, uint8_t *);
+static int _uncompress(const bcl_header_t *, uint8_t *, uint8_t *);
+static uint32_t _compress_bound(uint32_t);
+
+static double _time_get(void);
+
+static int _compress_file(const char *);
+static int _uncompress_file(const char *);
+static int _bench_file(const char *);
+
+static void *_worker(void *);
+static int _files_process(char **, uint32_t);
+
 int
-main(int argc, char *argv[])
+main(int argc, char **argv)
 {
+        static const struct option long_options[] = {
+                { "help",       no_argument,       NULL, 'h' },
+                { "decompress", no_argument,       NULL, 'd' },
+                { "bench",      no_argument,       NULL, 'b' },
+                { "codec",      required_argument, NULL, 'c' },
+                { "output",     required_argument, NULL, 'o' },
+                { "jobs",       required_argument, NULL, 'j' },
+                { NULL,         0,                 NULL, 0   }
+        };
+
+        int option;
+
+        while ((option = getopt_long(argc, argv, "hdbc:o:j:", long_options, NULL)) > 0) {
+                switch (option) {
+                case 'd':
+                        _global_options.d_set = true;
+                        break;
+                case 'b':
+                        _global_options.b_set = true;
+                        break;
+                case 'c':
+                        if ((strcmp(optarg, "best")) == 0) {
+                                _global_options.best = true;
+                                break;
+                        }
+
+                        _global_options.codec = _codec_find(optarg);
+
+                        if (_global_options.codec == NULL) {
+                                fprintf(stderr, "%s: Unknown codec \"%s\"\n",
+                                    PROGNAME, optarg);
+
+                                return 1;
+                        }
+                        break;
+                case 'o':
+                        _global_options.output_filepath = optarg;
+                        break;
+                case 'j':
+                        _global_options.jobs = strtoul(optarg, NULL, 0);
+
+                        if ((_global_options.jobs == 0) ||
+                            (_global_options.jobs > JOBS_MAX)) {
+                                fprintf(stderr, "%s: Invalid number of jobs \"%s\"\n",
+                                    PROGNAME, optarg);
+
+                                return 1;
+                        }
+                        break;
+                case 'h':
+                default:
+                        _usage();
+                        return 1;
+                }
+        }
+
+        const uint32_t input_count = argc - optind;
+
+        if (input_count == 0) {
+                _usage();
+                return 1;
+        }
+
+        if (_global_options.d_set && _global_options.b_set) {
+                _usage();
+                return 1;
+        }
+
+        /* Only a single input can be given an output, or benchmarked */
+        if ((input_count > 1) &&
+            ((_global_options.output_filepath != NULL) || _global_options.b_set)) {
+                _usage();
+                return 1;
+        }
+
+        if (_global_options.b_set) {
+                return _bench_file(argv[optind]);
+        }
+
+        return _files_process(&argv[optind], input_count);
+}
+
+static void
+_usage(void)
+{
+        fprintf(stderr,
+            "Usage: %s [-c codec] [-j jobs] [-o output] input...\n"
+            "       %s -d [-j jobs] [-o output] input...\n"
+            "       %s -b input\n"
+            "\n"
+            " -c, --codec codec    Compress with codec (default: lz), or \"best\"\n"
+            " -d, --decompress     Decompress\n"
+            " -b, --bench          Report the ratio and decode speed of each codec\n"
+            " -o, --output file    Write to file (default: input.bcl, or input\n"
+            "                      without .bcl when decompressing). Only with a\n"
+            "                      single input\n"
+            " -j, --jobs jobs      Process this many inputs at once (default: one\n"
+            "                      per processor)\n"
+            " -h, --help           Display this help\n"
+            "\n"
+            "Codecs:",
+            PROGNAME, PROGNAME, PROGNAME);
+
+        for (const struct codec *codec = _codecs; codec->name != NULL; codec++) {
+                fprintf(stderr, " %s", codec->name);
+        }
+
+        fprintf(stderr, "\n");
+}
+
+static const struct codec *
+_codec_find(const char *name)
+{
+        for (const struct codec *codec = _codecs; codec->name != NULL; codec++) {
+                if ((strcmp(codec->name, name)) == 0) {
+                        return codec;
+                }
+        }
+
+        return NULL;
+}
+
+static uint8_t *
+_file_read(const char *filepath, uint32_t *size)
+{
+        FILE *fp;
+
+        if ((fp = fopen(filepath, "rb")) == NULL) {
+                fprintf(stderr, "%s: %s: %s\n", PROGNAME, filepath,
+                    strerror(errno));
+
+                return NULL;
+        }
+
+        (void)fseek(fp, 0, SEEK_END);
+        const long file_size = ftell(fp);
+        (void)fseek(fp, 0, SEEK_SET);
+
+        if ((file_size < 0) || (file_size > (long)UINT32_MAX)) {
+                fprintf(stderr, "%s: %s: Invalid file size\n", PROGNAME,
+                    filepath);
+
+                fclose(fp);
+
+                return NULL;
+        }
+
+        /* Never allocate zero bytes */
+        uint8_t * const buffer = malloc(file_size + 1);
+
+        if ((fread(buffer, 1, file_size, fp)) != (size_t)file_size) {
+                fprintf(stderr, "%s: %s: Unable to read\n", PROGNAME,
+                    filepath);
+
+                free(buffer);
+                fclose(fp);
+
+                return NULL;
+        }
+
+        fclose(fp);
+
+        *size = file_size;
+
+        return buffer;
+}
+
+static int
+_file_write(const char *filepath, const uint8_t *buffer, uint32_t size)
+{
+        FILE *fp;
+
+        if ((fp = fopen(filepath, "wb")) == NULL) {
+                fprintf(stderr, "%s: %s: %s\n", PROGNAME, filepath,
+                    strerror(errno));
+
+                return -1;
+        }
+
+        if ((fwrite(buffer, 1, size, fp)) != size) {
+                fprintf(stderr, "%s: %s: Unable to write\n", PROGNAME,
+                    filepath);
+
+                fclose(fp);
+
+                return -1;
+        }
+
+        fclose(fp);
+
+        return 0;
+}
+
+/* Adler-32, same as bcl_checksum() in libbcl */
+static uint32_t
+_checksum(const uint8_t *buffer, uint32_t size)
+{
+        uint32_t a;
+        uint32_t b;
+
+        a = 1;
+        b = 0;
+
+        for (uint32_t i = 0; i < size; i++) {
+                a = (a + buffer[i]) % 65521;
+                b = (b + a) % 65521;
+        }
+
+        return (b << 16) | a;
+}
+
+static void
+_be32_write(uint8_t *p, uint32_t value)
+{
+        p[0] = value >> 24;
+        p[1] = value >> 16;
+        p[2] = value >> 8;
+        p[3] = value;
+}
+
+static uint32_t
+_be32_read(const uint8_t *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void
+_header_write(uint8_t *p, const bcl_header_t *header)
+{
+        _be32_write(&p[0], header->magic);
+        p[4] = header->codec;
+        p[5] = header->param;
+        p[6] = header->reserved >> 8;
+        p[7] = header->reserved;
+        _be32_write(&p[8], header->compressed_size);
+        _be32_write(&p[12], header->uncompressed_size);
+        _be32_write(&p[16], header->checksum);
+}
+
+static int
+_header_read(const uint8_t *p, uint32_t size, bcl_header_t *header)
+{
+        if (size < BCL_HEADER_SIZE) {
+                return -1;
+        }
+
+        header->magic = _be32_read(&p[0]);
+        header->codec = p[4];
+        header->param = p[5];
+        header->reserved = (p[6] << 8) | p[7];
+        header->compressed_size = _be32_read(&p[8]);
+        header->uncompressed_size = _be32_read(&p[12]);
+        header->checksum = _be32_read(&p[16]);
+
+        if (header->magic != BCL_HEADER_MAGIC) {
+                return -1;
+        }
+
+        if (header->codec >= BCL_CODEC_COUNT) {
+                return -1;
+        }
+
+        if (header->compressed_size > (size - BCL_HEADER_SIZE)) {
+                return -1;
+        }
+
         return 0;
 }
+
+static uint32_t
+_compress_bound(uint32_t size)
+{
+        /* Enough for the worst case of every codec */
+        return (size * 2) + 1024;
+}
+
+static int32_t
+_compress(const struct codec *codec, uint8_t *in, uint32_t size, uint8_t *out)
+{
+        if ((size % codec->width) != 0) {
+                return -1;
+        }
+
+        switch (codec->id) {
+        case BCL_CODEC_NONE:
+                (void)memcpy(out, in, size);
+                return size;
+        case BCL_CODEC_HUFFMAN:
+                return Huffman_Compress(in, out, size);
+        case BCL_CODEC_LZ:
+                if (codec->optimal) {
+                        return LZ_CompressOptimal(in, out, size, LZ_MAX_OFFSET);
+                }
+
+                return LZ_Compress(in, out, size, LZ_MAX_OFFSET);
+        case BCL_CODEC_LZB:
+                return lzb_compress(in, out, size);
+        case BCL_CODEC_PRS:
+                return prs_compress(in, out, size);
+        case BCL_CODEC_RICE:
+                return Rice_Compress(in, out, size, codec->param);
+        case BCL_CODEC_RLE:
+                return RLE_Compress(in, out, size);
+        case BCL_CODEC_SF:
+                return SF_Compress(in, out, size);
+        }
+
+        return -1;
+}
+
+static int
+_uncompress(const bcl_header_t *header, uint8_t *in, uint8_t *out)
+{
+        const uint32_t in_size = header->compressed_size;
+        const uint32_t out_size = header->uncompressed_size;
+
+        switch (header->codec) {
+        case BCL_CODEC_NONE:
+                (void)memcpy(out, in, out_size);
+                break;
+        case BCL_CODEC_HUFFMAN:
+                Huffman_Uncompress(in, out, in_size, out_size);
+                break;
+        case BCL_CODEC_LZ:
+                LZ_Uncompress(in, out, in_size);
+                break;
+        case BCL_CODEC_LZB:
+                if ((lzb_decompress(in, in_size, out, out_size)) != (int32_t)out_size) {
+                        return -1;
+                }
+                break;
+        case BCL_CODEC_PRS:
+                if ((prs_decompress_bounded(in, in_size, out, out_size)) != (int32_t)out_size) {
+                        return -1;
+                }
+                break;
+        case BCL_CODEC_RICE:
+                Rice_Uncompress(in, out, in_size, out_size, header->param);
+                break;
+        case BCL_CODEC_RLE:
+                RLE_Uncompress(in, out, in_size);
+                break;
+        case BCL_CODEC_SF:
+                SF_Uncompress(in, out, in_size, out_size);
+                break;
+        default:
+                return -1;
+        }
+
+        return 0;
+}
+
+static double
+_time_get(void)
+{
+        struct timespec ts;
+
+        (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static int
+_compress_file(const char *input_filepath)
+{
+        uint8_t *in;
+        uint32_t in_size;
+
+        if ((in = _file_read(input_filepath, &in_size)) == NULL) {
+                return 1;
+        }
+
+        uint8_t * const out = malloc(BCL_HEADER_SIZE + _compress_bound(in_size));
+        uint8_t * const data = &out[BCL_HEADER_SIZE];
+
+        const struct codec *codec;
+        codec = _global_options.codec;
+
+        int32_t compressed_size;
+
+        if (_global_options.best) {
+                uint8_t * const scratch = malloc(_compress_bound(in_size));
+
+                compressed_size = -1;
+
+                for (const struct codec *c = _codecs; c->name != NULL; c++) {
+                        const int32_t size = _compress(c, in, in_size, scratch);
+
+                        if (size < 0) {
+                                continue;
+                        }
+
+                        if ((compressed_size < 0) || (size < compressed_size)) {
+                                compressed_size = size;
+                                codec = c;
+
+                                (void)memcpy(data, scratch, size);
+                        }
+                }
+
+                free(scratch);
+        } else {
+                compressed_size = _compress(codec, in, in_size, data);
+        }
+
+        if (compressed_size < 0) {
+                if ((in_size % codec->width) != 0) {
+                        fprintf(stderr, "%s: %s: Unable to compress with %s (size must be a multiple of %i)\n",
+                            PROGNAME, input_filepath, codec->name, codec->width);
+                } else {
+                        fprintf(stderr, "%s: %s: Unable to compress with %s\n",
+                            PROGNAME, input_filepath, codec->name);
+                }
+
+                free(out);
+                free(in);
+
+                return 1;
+        }
+
+        const bcl_header_t header = {
+                .magic = BCL_HEADER_MAGIC,
+                .codec = codec->id,
+                .param = codec->param,
+                .reserved = 0,
+                .compressed_size = compressed_size,
+                .uncompressed_size = in_size,
+                .checksum = _checksum(in, in_size)
+        };
+
+        _header_write(out, &header);
+
+        char *output_filepath;
+        output_filepath = _global_options.output_filepath;
+
+        if (output_filepath == NULL) {
+                output_filepath = malloc(strlen(input_filepath) + 5);
+
+                (void)sprintf(output_filepath, "%s.bcl", input_filepath);
+        }
+
+        int exit_code;
+        exit_code = 0;
+
+        if ((_file_write(output_filepath, out, BCL_HEADER_SIZE + compressed_size)) < 0) {
+                exit_code = 1;
+        }
+
+        if (output_filepath != _global_options.output_filepath) {
+                free(output_filepath);
+        }
+
+        free(out);
+        free(in);
+
+        return exit_code;
+}
+
+static int
+_uncompress_file(const char *input_filepath)
+{
+        uint8_t *in;
+        uint32_t in_size;
+
+        if ((in = _file_read(input_filepath, &in_size)) == NULL) {
+                return 1;
+        }
+
+        bcl_header_t header;
+
+        if ((_header_read(in, in_size, &header)) < 0) {
+                fprintf(stderr, "%s: %s: Invalid header\n", PROGNAME,
+                    input_filepath);
+
+                free(in);
+
+                return 1;
+        }
+
+        /* Never allocate zero bytes */
+        uint8_t * const out = malloc(header.uncompressed_size + 1);
+
+        if (((_uncompress(&header, &in[BCL_HEADER_SIZE], out)) < 0) ||
+            ((_checksum(out, header.uncompressed_size)) != header.checksum)) {
+                fprintf(stderr, "%s: %s: Corrupt data\n", PROGNAME,
+                    input_filepath);
+
+                free(out);
+                free(in);
+
+                return 1;
+        }
+
+        char *output_filepath;
+        output_filepath = _global_options.output_filepath;
+
+        if (output_filepath == NULL) {
+                const size_t length = strlen(input_filepath);
+
+                output_filepath = malloc(length + 5);
+
+                (void)strcpy(output_filepath, input_filepath);
+
+                if ((length > 4) &&
+                    ((strcmp(&input_filepath[length - 4], ".bcl")) == 0)) {
+                        output_filepath[length - 4] = '\0';
+                } else {
+                        (void)strcat(output_filepath, ".out");
+                }
+        }
+
+        int exit_code;
+        exit_code = 0;
+
+        if ((_file_write(output_filepath, out, header.uncompressed_size)) < 0) {
+                exit_code = 1;
+        }
+
+        if (output_filepath != _global_options.output_filepath) {
+                free(output_filepath);
+        }
+
+        free(out);
+        free(in);
+
+        return exit_code;
+}
+
+static int
+_bench_file(const char *input_filepath)
+{
+        uint8_t *in;
+        uint32_t in_size;
+
+        if ((in = _file_read(input_filepath, &in_size)) == NULL) {
+                return 1;
+        }
+
+        uint8_t * const compressed = malloc(_compress_bound(in_size));
+        uint8_t * const out = malloc(in_size + 1);
+
+        const double mb = in_size / (1024.0 * 1024.0);
+
+        printf("%s: %u bytes\n\n", input_filepath, in_size);
+        printf("%-10s %10s %7s %12s %12s\n", "codec", "size", "ratio",
+            "comp MB/s", "decomp MB/s");
+
+        int exit_code;
+        exit_code = 0;
+
+        for (const struct codec *codec = _codecs; codec->name != NULL; codec++) {
+                double time_start;
+                time_start = _time_get();
+
+                const int32_t compressed_size =
+                    _compress(codec, in, in_size, compressed);
+
+                const double compress_time = _time_get() - time_start;
+
+                if (compressed_size < 0) {
+                        printf("%-10s %10s\n", codec->name, "n/a");
+
+                        continue;
+                }
+
+                const bcl_header_t header = {
+                        .magic = BCL_HEADER_MAGIC,
+                        .codec = codec->id,
+                        .param = codec->param,
+                        .reserved = 0,
+                        .compressed_size = compressed_size,
+                        .uncompressed_size = in_size,
+                        .checksum = 0
+                };
+
+                uint32_t iterations;
+                iterations = 0;
+
+                double decompress_time;
+
+                time_start = _time_get();
+
+                do {
+                        (void)_uncompress(&header, compressed, out);
+
+                        iterations++;
+
+                        decompress_time = _time_get() - time_start;
+                } while (decompress_time < BENCH_TIME_MIN);
+
+                const bool match = ((memcmp(in, out, in_size)) == 0);
+
+                if (!match) {
+                        exit_code = 1;
+                }
+
+                printf("%-10s %10i %6.1f%% %12.1f %12.1f%s\n",
+                    codec->name,
+                    compressed_size,
+                    (in_size > 0) ? ((100.0 * compressed_size) / in_size) : 0.0,
+                    (compress_time > 0.0) ? (mb / compress_time) : 0.0,
+                    (mb * iterations) / decompress_time,
+                    match ? "" : "  MISMATCH");
+        }
+
+        free(out);
+        free(compressed);
+        free(in);
+
+        return exit_code;
+}
+
+static void *
+_worker(void *arg __attribute__ ((unused)))
+{
+        while (true) {
+                (void)pthread_mutex_lock(&_work.mutex);
+
+                const uint32_t index = _work.next;
+
+                if (index < _work.count) {
+                        _work.next++;
+                }
+
+                (void)pthread_mutex_unlock(&_work.mutex);
+
+                if (index >= _work.count) {
+                        break;
+                }
+
+                const char * const filepath = _work.filepaths[index];
+
+                int exit_code;
+
+                if (_global_options.d_set) {
+                        exit_code = _uncompress_file(filepath);
+                } else {
+                        exit_code = _compress_file(filepath);
+                }
+
+                if (exit_code != 0) {
+                        (void)pthread_mutex_lock(&_work.mutex);
+                        _work.exit_code = exit_code;
+                        (void)pthread_mutex_unlock(&_work.mutex);
+                }
+        }
+
+        return NULL;
+}
+
+/*
+ * Each input is compressed (or decompressed) on its own, so the output of
+ * every file is the same regardless of the number of jobs.
+ */
+static int
+_files_process(char **filepaths, uint32_t count)
+{
+        _work.filepaths = filepaths;
+        _work.count = count;
+        _work.next = 0;
+        _work.exit_code = 0;
+
+        uint32_t jobs;
+        jobs = _global_options.jobs;
+
+        if (jobs == 0) {
+                const long processors = sysconf(_SC_NPROCESSORS_ONLN);
+
+                jobs = (processors > 0) ? processors : 1;
+        }
+
+        if (jobs > count) {
+                jobs = count;
+        }
+
+        if (jobs > JOBS_MAX) {
+                jobs = JOBS_MAX;
+        }
+
+        pthread_t threads[JOBS_MAX];
+
+        /* The calling thread is the first worker */
+        uint32_t thread_count;
+
+        for (thread_count = 0; thread_count < (jobs - 1); thread_count++) {
+                if ((pthread_create(&threads[thread_count], NULL, _worker, NULL)) != 0) {
+                        break;
+                }
+        }
+
+        (void)_worker(NULL);
+
+        for (uint32_t i = 0; i < thread_count; i++) {
+                (void)pthread_join(threads[i], NULL);
+        }
+
+        return _work.exit_code;
+}
@@ -19,16 +19,14 @@
  * "string" refers to any kind of byte sequence (it does not have to be
  * an ASCII string, for instance).
  *
- * The coder uses a brute force approach to finding string matches in the
- * history buffer (or "sliding window", if you wish), which is very, very
- * slow. I recon the complexity is somewhere between O(n^2) and O(n^3),
- * depending on the input data.
+ * The coder finds string matches in the history buffer (or "sliding
+ * window", if you wish) with hash chains: only earlier positions that
+ * start with the same four bytes are compared. The output is identical to
+ * that of the original brute force search.
  *
- * There is also a faster implementation that uses a large working buffer
- * in which a "jump table" is stored, which is used to quickly find
- * possible string matches (see the source code for LZ_CompressFast() for
- * more information). The faster method is an order of magnitude faster,
- * but still quite slow compared to other compression methods.
+ * LZ_CompressOptimal() uses the same match finder, but instead of taking
+ * the longest match at each position, it picks the sequence of literals
+ * and matches that gives the smallest output.
  *
  * The upside is that decompression is very fast, and the compression ratio
  * is often very good.
@@ -77,6 +75,8 @@
  * marcus.geelnard at home.se
  *************************************************************************/
 
+#include <stdlib.h>
+
 
 /*************************************************************************
  * Constants used for LZ77 coding
@@ -88,6 +88,52 @@
    you. */
 #define LZ_MAX_OFFSET 2147483648
 
+/* Minimum length of a string match. Also the number of bytes hashed to
+   find candidate matches. */
+#define LZ_MIN_LENGTH 4
+
+/* Number of bits of the hash of LZ_MIN_LENGTH bytes */
+#define LZ_HASH_BITS 16
+#define LZ_HASH_SIZE (1 << LZ_HASH_BITS)
+
+/* When optimal parsing, matches at least this long are taken right away
+   instead of pricing every shorter length. */
+#define LZ_NICE_LENGTH 255
+
+/* When optimal parsing, the number of earlier positions at each position
+   that may fail to give a longer match before the search stops. Greedy
+   parsing always walks the whole chain. */
+#define LZ_OPTIMAL_MAX_CHAIN 1024
+
+/* Maximum number of matches of increasing length found at a position */
+#define LZ_MAX_MATCHES 64
+
+
+/*************************************************************************
+ * Types used for LZ77 coding
+ *************************************************************************/
+
+/* Hash chains: head[] holds the most recent position of each hash, and
+   prev[] links each position to the previous one with the same hash. A
+   value of -1 ends a chain. run[] holds the number of identical bytes
+   starting at each position, so that long runs are not compared byte by
+   byte for every offset. */
+typedef struct {
+        unsigned char *in;
+        unsigned int insize;
+        unsigned int maxoffset;
+        unsigned int nextpos;
+        int *head;
+        int *prev;
+        unsigned int *run;
+} lz_matcher_t;
+
+typedef struct {
+        unsigned int length;
+        unsigned int offset;
+} lz_match_t;
+
+
 /*************************************************************************
  * _LZ_StringCompare() - Return maximum length string match.
  *************************************************************************/
@@ -137,40 +183,269 @@ static int _LZ_WriteVarSize(unsigned int x, unsigned char * buf)
 }
 
 
+/*************************************************************************
+ * _LZ_VarSizeLength() - Number of bytes _LZ_WriteVarSize() writes.
+ *************************************************************************/
+
+static unsigned int _LZ_VarSizeLength(unsigned int x)
+{
+        unsigned int num_bytes;
+
+        for (num_bytes = 1; (num_bytes < 5) && (x >> (num_bytes*7)); ++num_bytes);
+
+        return num_bytes;
+}
+
+
 
 /*************************************************************************
- *                            PUBLIC FUNCTIONS                            *
+ * _LZ_ReadVarSize() - Read unsigned integer with variable number of
+ * bytes depending on value.
+ *************************************************************************/
+
+static int _LZ_ReadVarSize(unsigned int * x, unsigned char * buf)
+{
+        unsigned int y, b, num_bytes;
+
+        /* Read complete value (stop when byte contains zero in 8:th bit) */
+        y = 0;
+        num_bytes = 0;
+        do {
+                b = (unsigned int)(*buf++);
+                y = (y << 7) | (b & 0x0000007f);
+                ++num_bytes;
+        } while (b & 0x00000080);
+
+        /* Store value in x */
+        *x = y;
+
+        /* Return number of bytes read */
+        return num_bytes;
+}
+
+
+/*************************************************************************
+ * _LZ_Hash() - Hash the LZ_MIN_LENGTH bytes at ptr.
  *************************************************************************/
 
+static unsigned int _LZ_Hash(unsigned char * ptr)
+{
+        unsigned int x;
+
+        x = ((unsigned int) ptr[0] << 24) | ((unsigned int) ptr[1] << 16) |
+            ((unsigned int) ptr[2] << 8) | (unsigned int) ptr[3];
+
+        return (x * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
 
 /*************************************************************************
- * LZ_Compress() - Compress a block of data using an LZ77 coder.
- *  in     - Input (uncompressed) buffer.
- *  out    - Output (compressed) buffer. This buffer must be 0.4% larger
- *           than the input buffer, plus one byte.
- *  insize - Number of input bytes.
- * The function returns the size of the compressed data.
+ * _LZ_MatcherInit() - Allocate the hash chains.
  *************************************************************************/
 
-int LZ_Compress(unsigned char *in, unsigned char *out,
-                unsigned int insize, unsigned long max_offset)
+static int _LZ_MatcherInit(lz_matcher_t * m, unsigned char * in,
+                           unsigned int insize, unsigned int maxoffset)
 {
-        unsigned char marker, symbol;
-        unsigned int inpos, outpos, bytesleft, i;
-        unsigned int maxoffset, offset, bestoffset;
-        unsigned int maxlength, length, bestlength;
-        unsigned int histogram[256];
-        unsigned char *ptr1, *ptr2;
+        unsigned int i;
+
+        m->in = in;
+        m->insize = insize;
+        m->maxoffset = maxoffset;
+        m->nextpos = 0;
+        m->head = malloc(LZ_HASH_SIZE * sizeof(int));
+        m->prev = malloc(insize * sizeof(int));
+        m->run = malloc(insize * sizeof(unsigned int));
+
+        if ((m->head == NULL) || (m->prev == NULL) || (m->run == NULL)) {
+                free(m->head);
+                free(m->prev);
+                free(m->run);
+                return -1;
+        }
 
-        if (max_offset >= LZ_MAX_OFFSET) {
-                max_offset = LZ_MAX_OFFSET;
+        for (i = 0; i < LZ_HASH_SIZE; ++i) {
+                m->head[i] = -1;
         }
 
-        /* Do we have anything to compress? */
-        if (insize < 1) {
+        m->run[insize - 1] = 1;
+        for (i = insize - 1; i > 0; --i) {
+                m->run[i - 1] = (in[i - 1] == in[i]) ? (m->run[i] + 1) : 1;
+        }
+
+        return 0;
+}
+
+
+/*************************************************************************
+ * _LZ_MatcherFree() - Free the hash chains.
+ *************************************************************************/
+
+static void _LZ_MatcherFree(lz_matcher_t * m)
+{
+        free(m->head);
+        free(m->prev);
+        free(m->run);
+}
+
+
+/*************************************************************************
+ * _LZ_FindMatches() - Find the string matches at inpos. Every position
+ * before inpos is first added to the hash chains.
+ *
+ * The chain is walked from the nearest position outwards, and a match is
+ * recorded each time it is longer than the previous one. The last match
+ * is then the longest one at the smallest offset, which is exactly what
+ * the original brute force search found. Like that search, offsets start
+ * at 3, and a match never extends past its own offset.
+ *
+ * The search stops after maxchain earlier positions fail to give a
+ * longer match, unless maxchain is zero.
+ *
+ * The function returns the number of matches.
+ *************************************************************************/
+
+static unsigned int _LZ_FindMatches(lz_matcher_t * m, unsigned int inpos,
+                                    unsigned int maxchain, lz_match_t * matches)
+{
+        unsigned char *ptr1, *ptr2;
+        unsigned int bytesleft, maxoffset, offset, maxlength, length;
+        unsigned int bestlength, count, h, minlength, misses;
+        int candidate;
+
+        /* Update hash chains */
+        for (; (m->nextpos < inpos) &&
+                     ((m->nextpos + LZ_MIN_LENGTH) <= m->insize); ++m->nextpos) {
+                h = _LZ_Hash(&m->in[m->nextpos]);
+                m->prev[m->nextpos] = m->head[h];
+                m->head[h] = (int) m->nextpos;
+        }
+
+        bytesleft = m->insize - inpos;
+
+        if (bytesleft < LZ_MIN_LENGTH) {
                 return 0;
         }
 
+        /* Determine most distant position */
+        maxoffset = (inpos > m->maxoffset) ? m->maxoffset : inpos;
+
+        ptr1 = &m->in[inpos];
+
+        bestlength = LZ_MIN_LENGTH - 1;
+        count = 0;
+        misses = 0;
+
+        for (candidate = m->head[_LZ_Hash(ptr1)]; candidate >= 0;
+             candidate = m->prev[candidate]) {
+                offset = inpos - (unsigned int) candidate;
+
+                if (offset > maxoffset) {
+                        break;
+                }
+
+                if ((maxchain > 0) && (misses == maxchain)) {
+                        break;
+                }
+
+                ++misses;
+
+                /* Determine maximum length for this offset */
+                maxlength = (bytesleft < offset ? bytesleft : offset);
+
+                if ((offset < 3) || (maxlength <= bestlength)) {
+                        continue;
+                }
+
+                ptr2 = &ptr1[- (int) offset];
+
+                /* Quickly determine if this is a candidate (for speed) */
+                if ((ptr1[0] != ptr2[0]) ||
+                    (ptr1[bestlength] != ptr2[bestlength])) {
+                        continue;
+                }
+
+                /* Both strings start with a run of the same byte */
+                minlength = m->run[candidate];
+                if (minlength > m->run[inpos]) {
+                        minlength = m->run[inpos];
+                }
+                if (minlength > maxlength) {
+                        minlength = maxlength;
+                }
+
+                length = _LZ_StringCompare(ptr1, ptr2, minlength, maxlength);
+
+                /* Better match than any previous match? */
+                if (length > bestlength) {
+                        bestlength = length;
+                        --misses;
+
+                        if (count == LZ_MAX_MATCHES) {
+                                --count;
+                        }
+
+                        matches[count].length = length;
+                        matches[count].offset = offset;
+                        ++count;
+
+                        /* Nothing can be longer than what is left */
+                        if (bestlength == bytesleft) {
+                                break;
+                        }
+                }
+        }
+
+        return count;
+}
+
+
+/*************************************************************************
+ * _LZ_WriteLiteral() - Output single byte (or two bytes if marker byte).
+ *************************************************************************/
+
+static unsigned int _LZ_WriteLiteral(unsigned char symbol,
+                                     unsigned char marker, unsigned char * buf)
+{
+        buf[0] = symbol;
+
+        if (symbol == marker) {
+                buf[1] = 0;
+                return 2;
+        }
+
+        return 1;
+}
+
+
+/*************************************************************************
+ * _LZ_WriteMatch() - Output string reference.
+ *************************************************************************/
+
+static unsigned int _LZ_WriteMatch(unsigned int length, unsigned int offset,
+                                   unsigned char marker, unsigned char * buf)
+{
+        unsigned int outpos;
+
+        outpos = 0;
+        buf[outpos++] = marker;
+        outpos += _LZ_WriteVarSize(length, &buf[outpos]);
+        outpos += _LZ_WriteVarSize(offset, &buf[outpos]);
+
+        return outpos;
+}
+
+
+/*************************************************************************
+ * _LZ_FindMarker() - Find the least common byte, used as the marker
+ * symbol.
+ *************************************************************************/
+
+static unsigned char _LZ_FindMarker(unsigned char * in, unsigned int insize)
+{
+        unsigned int histogram[256];
+        unsigned int i;
+        unsigned char marker;
+
         /* Create histogram */
         for (i = 0; i < 256; ++i) {
                 histogram[i] = 0;
@@ -187,7 +462,53 @@ int LZ_Compress(unsigned char *in, unsigned char *out,
                 }
         }
 
+        return marker;
+}
+
+
+
+/*************************************************************************
+ *                            PUBLIC FUNCTIONS                            *
+ *************************************************************************/
+
+
+/*************************************************************************
+ * LZ_Compress() - Compress a block of data using an LZ77 coder.
+ *  in     - Input (uncompressed) buffer.
+ *  out    - Output (compressed) buffer. This buffer must be 0.4% larger
+ *           than the input buffer, plus one byte.
+ *  insize - Number of input bytes.
+ * The function returns the size of the compressed data, or -1 if out of
+ * memory.
+ *
+ * Matches are chosen greedily. The output is identical to that of the
+ * original brute force search.
+ *************************************************************************/
+
+int LZ_Compress(unsigned char *in, unsigned char *out,
+                unsigned int insize, unsigned long max_offset)
+{
+        unsigned char marker;
+        unsigned int inpos, outpos, count;
+        unsigned int bestoffset, bestlength;
+        lz_matcher_t m;
+        lz_match_t matches[LZ_MAX_MATCHES];
+
+        if (max_offset >= LZ_MAX_OFFSET) {
+                max_offset = LZ_MAX_OFFSET;
+        }
+
+        /* Do we have anything to compress? */
+        if (insize < 1) {
+                return 0;
+        }
+
+        if (_LZ_MatcherInit(&m, in, insize, max_offset) < 0) {
+                return -1;
+        }
+
         /* Remember the marker symbol for the decoder */
+        marker = _LZ_FindMarker(in, insize);
         out[0] = marker;
 
         /* Start of compression */
@@ -195,40 +516,15 @@ int LZ_Compress(unsigned char *in, unsigned char *out,
         outpos = 1;
 
         /* Main compression loop */
-        bytesleft = insize;
-        do {
-                /* Determine most distant position */
-                if (inpos > max_offset) {
-                        maxoffset = max_offset;
-                } else {
-                        maxoffset = inpos;
-                }
-
-                /* Get pointer to current position */
-                ptr1 = &in[inpos];
+        while (inpos < insize) {
+                count = _LZ_FindMatches(&m, inpos, 0, matches);
 
-                /* Search history window for maximum length string match */
-                bestlength = 3;
+                bestlength = 0;
                 bestoffset = 0;
-                for (offset = 3; offset <= maxoffset; ++offset) {
-                        /* Get pointer to candidate string */
-                        ptr2 = &ptr1[- (int) offset];
-
-                        /* Quickly determine if this is a candidate (for speed) */
-                        if ((ptr1[0 ] == ptr2[0]) &&
-                                        (ptr1[bestlength ] == ptr2[bestlength])) {
-                                /* Determine maximum length for this offset */
-                                maxlength = (bytesleft < offset ? bytesleft : offset);
-
-                                /* Count maximum length match at this offset */
-                                length = _LZ_StringCompare(ptr1, ptr2, 0, maxlength);
-
-                                /* Better match than any previous match? */
-                                if (length > bestlength) {
-                                        bestlength = length;
-                                        bestoffset = offset;
-                                }
-                        }
+
+                if (count > 0) {
+                        bestlength = matches[count - 1].length;
+                        bestoffset = matches[count - 1].offset;
                 }
 
                 /* Was there a good enough match? */
@@ -237,32 +533,212 @@ int LZ_Compress(unsigned char *in, unsigned char *out,
                                 ((bestlength == 5) && (bestoffset <= 0x00003fff)) ||
                                 ((bestlength == 6) && (bestoffset <= 0x001fffff)) ||
                                 ((bestlength == 7) && (bestoffset <= 0x0fffffff))) {
-                        out[outpos++] = (unsigned char) marker;
-                        outpos += _LZ_WriteVarSize(bestlength, &out[outpos]);
-                        outpos += _LZ_WriteVarSize(bestoffset, &out[outpos]);
+                        outpos += _LZ_WriteMatch(bestlength, bestoffset, marker, &out[outpos]);
                         inpos += bestlength;
-                        bytesleft -= bestlength;
                 } else {
-                        /* Output single byte (or two bytes if marker byte) */
-                        symbol = in[inpos++];
-                        out[outpos++] = symbol;
-                        if (symbol == marker) {
-                                out[outpos++] = 0;
+                        outpos += _LZ_WriteLiteral(in[inpos], marker, &out[outpos]);
+                        ++inpos;
+                }
+        }
+
+        _LZ_MatcherFree(&m);
+
+        return outpos;
+}
+
+
+/*************************************************************************
+ * LZ_CompressOptimal() - Compress a block of data using an LZ77 coder,
+ * choosing matches so that the output is as small as possible.
+ *  in     - Input (uncompressed) buffer.
+ *  out    - Output (compressed) buffer. This buffer must be 0.4% larger
+ *           than the input buffer, plus one byte.
+ *  insize - Number of input bytes.
+ * The function returns the size of the compressed data, or -1 if out of
+ * memory.
+ *
+ * The cheapest way to reach each position is found by pricing a literal
+ * and every match length starting from each earlier position. The output
+ * is decoded by LZ_Uncompress() exactly like that of LZ_Compress(), and
+ * is usually smaller. Compression is several times slower.
+ *************************************************************************/
+
+int LZ_CompressOptimal(unsigned char *in, unsigned char *out,
+                       unsigned int insize, unsigned long max_offset)
+{
+        unsigned char marker;
+        unsigned int inpos, outpos, count, i, length, minlength, cost;
+        unsigned int *price, *lengths, *offsets;
+        lz_matcher_t m;
+        lz_match_t matches[LZ_MAX_MATCHES];
+
+        if (max_offset >= LZ_MAX_OFFSET) {
+                max_offset = LZ_MAX_OFFSET;
+        }
+
+        /* Do we have anything to compress? */
+        if (insize < 1) {
+                return 0;
+        }
+
+        if (_LZ_MatcherInit(&m, in, insize, max_offset) < 0) {
+                return -1;
+        }
+
+        /* Cheapest way to reach each position: its price in bytes, and the
+           length and offset of the last step (an offset of zero is a
+           literal) */
+        price = malloc((insize + 1) * sizeof(unsigned int));
+        lengths = malloc((insize + 1) * sizeof(unsigned int));
+        offsets = malloc((insize + 1) * sizeof(unsigned int));
+
+        if ((price == NULL) || (lengths == NULL) || (offsets == NULL)) {
+                free(price);
+                free(lengths);
+                free(offsets);
+                _LZ_MatcherFree(&m);
+                return -1;
+        }
+
+        marker = _LZ_FindMarker(in, insize);
+
+        price[0] = 0;
+        for (i = 1; i <= insize; ++i) {
+                price[i] = 0xffffffff;
+        }
+
+        inpos = 0;
+        while (inpos < insize) {
+                cost = price[inpos] + ((in[inpos] == marker) ? 2 : 1);
+                if (cost < price[inpos + 1]) {
+                        price[inpos + 1] = cost;
+                        lengths[inpos + 1] = 1;
+                        offsets[inpos + 1] = 0;
+                }
+
+                count = _LZ_FindMatches(&m, inpos, LZ_OPTIMAL_MAX_CHAIN, matches);
+
+                /* Take long matches right away */
+                if ((count > 0) &&
+                    (matches[count - 1].length >= LZ_NICE_LENGTH)) {
+                        length = matches[count - 1].length;
+                        cost = price[inpos] + 1 +
+                               _LZ_VarSizeLength(length) +
+                               _LZ_VarSizeLength(matches[count - 1].offset);
+                        if (cost < price[inpos + length]) {
+                                price[inpos + length] = cost;
+                                lengths[inpos + length] = length;
+                                offsets[inpos + length] = matches[count - 1].offset;
+                        }
+                        inpos += length;
+                        continue;
+                }
+
+                /* Every length up to that of a match is reached with the
+                   smallest offset that allows it */
+                minlength = LZ_MIN_LENGTH;
+                for (i = 0; i < count; ++i) {
+                        for (length = minlength; length <= matches[i].length; ++length) {
+                                cost = price[inpos] + 1 +
+                                       _LZ_VarSizeLength(length) +
+                                       _LZ_VarSizeLength(matches[i].offset);
+                                if (cost < price[inpos + length]) {
+                                        price[inpos + length] = cost;
+                                        lengths[inpos + length] = length;
+                                        offsets[inpos + length] = matches[i].offset;
+                                }
                         }
-                        -- bytesleft;
+                        minlength = matches[i].length + 1;
                 }
-        } while (bytesleft > 3);
 
-        /* Dump remaining bytes, if any */
+                ++inpos;
+        }
+
+        _LZ_MatcherFree(&m);
+
+        /* Walk back from the end, turning each step's length into a link
+           to the next position (price[] is no longer needed) */
+        inpos = insize;
+        price[insize] = insize;
+        while (inpos > 0) {
+                length = lengths[inpos];
+                price[inpos - length] = inpos;
+                inpos -= length;
+        }
+
+        /* Remember the marker symbol for the decoder */
+        out[0] = marker;
+        outpos = 1;
+
+        inpos = 0;
         while (inpos < insize) {
-                if (in[inpos] == marker) {
-                        out[outpos++] = marker;
-                        out[outpos++] = 0;
+                i = price[inpos];
+                length = lengths[i];
+
+                if (offsets[i] == 0) {
+                        outpos += _LZ_WriteLiteral(in[inpos], marker, &out[outpos]);
                 } else {
-                        out[outpos++ ] = in[inpos];
+                        outpos += _LZ_WriteMatch(length, offsets[i], marker, &out[outpos]);
                 }
-                ++inpos;
+
+                inpos = i;
         }
 
+        free(price);
+        free(lengths);
+        free(offsets);
+
         return outpos;
 }
+
+
+/*************************************************************************
+ * LZ_Uncompress() - Uncompress a block of data using an LZ77 decoder.
+ *  in      - Input (compressed) buffer.
+ *  out     - Output (uncompressed) buffer. This buffer must be large
+ *            enough to hold the uncompressed data.
+ *  insize  - Number of input bytes.
+ *************************************************************************/
+
+void LZ_Uncompress(unsigned char *in, unsigned char *out,
+                   unsigned int insize)
+{
+        unsigned char marker, symbol;
+        unsigned int i, inpos, outpos, length, offset;
+
+        /* Do we have anything to uncompress? */
+        if (insize < 1) {
+                return;
+        }
+
+        /* Get marker symbol from input stream */
+        marker = in[0];
+        inpos = 1;
+
+        /* Main decompression loop */
+        outpos = 0;
+        do {
+                symbol = in[inpos++];
+                if (symbol == marker) {
+                        /* We had a marker byte */
+                        if (in[inpos] == 0) {
+                                /* It was a single occurrence of the marker byte */
+                                out[outpos++] = marker;
+                                ++inpos;
+                        } else {
+                                /* Extract true length and offset */
+                                inpos += _LZ_ReadVarSize(&length, &in[inpos]);
+                                inpos += _LZ_ReadVarSize(&offset, &in[inpos]);
+
+                                /* Copy corresponding data from history window */
+                                for (i = 0; i < length; ++i) {
+                                        out[outpos] = out[outpos - offset];
+                                        ++outpos;
+                                }
+                        }
+                } else {
+                        /* No marker, plain copy */
+                        out[outpos++] = symbol;
+                }
+        } while (inpos < insize);
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcl.h"
+
+/*
+ * LZB is a byte-aligned LZ77 codec in the spirit of LZ4. There are no bit
+ * fields to extract, so decoding is a few byte loads followed by block
+ * copies.
+ *
+ * The stream is a sequence of:
+ *
+ *   token      Literal count (upper nibble), match length minus 4 (lower
+ *              nibble)
+ *   [count]    If the literal count is 15, bytes are added to it until a
+ *              byte other than 255 is read
+ *   literals
+ *   offset     Distance of the match, two bytes (big-endian), 1..65535
+ *   [length]   If the match length is 15, extended like the literal count
+ *
+ * The last sequence has no match, and ends the stream.
+ *
+ * Matches whose distance is a multiple of 4 are copied 32 bits at a time,
+ * so the encoder prefers them.
+ */
+
+#define LZB_MATCH_LENGTH_MIN    4
+#define LZB_NIBBLE_MAX          15
+
+#define SOURCE_CHECK(n) do {                                                   \
+        if ((size_t)(src_end - src) < (size_t)(n)) {                           \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define DEST_CHECK(n) do {                                                     \
+        if ((size_t)(dst_end - dst) < (size_t)(n)) {                           \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define LENGTH_EXTEND(length) do {                                             \
+        if ((length) == LZB_NIBBLE_MAX) {                                      \
+                uint32_t byte;                                                 \
+                                                                               \
+                do {                                                           \
+                        SOURCE_CHECK(1);                                       \
+                        byte = *src++;                                         \
+                        (length) += byte;                                      \
+                } while (byte == 0xFF);                                        \
+        }                                                                      \
+} while (false)
+
+static inline void
+_literals_copy(uint8_t *dst, const uint8_t *src, uint32_t count)
+{
+        if (count >= 16) {
+                (void)memcpy(dst, src, count);
+
+                return;
+        }
+
+        for (; count > 0; count--) {
+                *dst++ = *src++;
+        }
+}
+
+static inline void
+_match_copy(uint8_t *dst, uint32_t distance, uint32_t size)
+{
+        const uint8_t *ref = dst - distance;
+
+        if (distance == 1) {
+                /* Run of a single byte */
+                (void)memset(dst, *ref, size);
+
+                return;
+        }
+
+        if ((distance >= size) && (size >= 16)) {
+                (void)memcpy(dst, ref, size);
+
+                return;
+        }
+
+        if (distance >= 4) {
+                if ((distance & 0x03) == 0) {
+                        /* Both pointers share the same alignment */
+                        for (; (((uintptr_t)dst & 0x03) != 0) && (size > 0); size--) {
+                                *dst++ = *ref++;
+                        }
+
+                        uint32_t *dst_32 = (uint32_t *)dst;
+                        const uint32_t *ref_32 = (const uint32_t *)ref;
+
+                        /* Each long only reads bytes that were written before
+                         * it, so this is safe even when overlapping */
+                        for (; size >= 4; size -= 4) {
+                                *dst_32++ = *ref_32++;
+                        }
+
+                        dst = (uint8_t *)dst_32;
+                        ref = (const uint8_t *)ref_32;
+                } else {
+                        for (; size >= 4; size -= 4) {
+                                dst[0] = ref[0];
+                                dst[1] = ref[1];
+                                dst[2] = ref[2];
+                                dst[3] = ref[3];
+
+                                dst += 4;
+                                ref += 4;
+                        }
+                }
+        }
+
+        for (; size > 0; size--) {
+                *dst++ = *ref++;
+        }
+}
+
+int32_t
+lzb_decompress(const void *source, uint32_t source_size, void *dest,
+    uint32_t dest_size)
+{
+        const uint8_t *src = source;
+        const uint8_t * const src_end = &src[source_size];
+        uint8_t *dst = dest;
+        uint8_t * const dst_start = dst;
+        const uint8_t * const dst_end = &dst[dest_size];
+
+        for (;;) {
+                SOURCE_CHECK(1);
+
+                const uint32_t token = *src++;
+
+                uint32_t count;
+                count = token >> 4;
+
+                LENGTH_EXTEND(count);
+
+                SOURCE_CHECK(count);
+                DEST_CHECK(count);
+
+                _literals_copy(dst, src, count);
+
+                src += count;
+                dst += count;
+
+                if (src == src_end) {
+                        return (dst - dst_start);
+                }
+
+                SOURCE_CHECK(2);
+
+                const uint32_t distance = (src[0] << 8) | src[1];
+
+                src += 2;
+
+                if ((distance == 0) || ((uint32_t)(dst - dst_start) < distance)) {
+                        return -1;
+                }
+
+                uint32_t length;
+                length = token & LZB_NIBBLE_MAX;
+
+                LENGTH_EXTEND(length);
+
+                length += LZB_MATCH_LENGTH_MIN;
+
+                DEST_CHECK(length);
+
+                _match_copy(dst, distance, length);
+
+                dst += length;
+        }
+}
+
+#define LZB_DISTANCE_MAX        0xFFFF
+#define LZB_WINDOW_SIZE         0x10000
+#define LZB_HASH_BITS           16
+#define LZB_HASH_SIZE           (1 << LZB_HASH_BITS)
+#define LZB_CHAIN_LENGTH_MAX    256
+/* Matches at least this long are taken without searching further */
+#define LZB_MATCH_LENGTH_NICE   1024
+
+typedef struct {
+        const uint8_t *src;
+        uint32_t size;
+        int32_t *head;
+        int32_t *prev;
+        uint32_t next_pos;
+} lzb_matcher_t;
+
+static uint32_t
+lzb_hash(const uint8_t *p)
+{
+        const uint32_t v = ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+
+        return (v * 2654435761U) >> (32 - LZB_HASH_BITS);
+}
+
+/*
+ * Find the longest match at pos. Of matches of the same length, the first
+ * one at a distance that is a multiple of 4 is preferred, as the decoder
+ * then copies 32 bits at a time.
+ */
+static uint32_t
+lzb_match_find(lzb_matcher_t *m, uint32_t pos, uint32_t *distance)
+{
+        const uint8_t * const src = m->src;
+
+        for (; (m->next_pos < pos) && ((m->next_pos + LZB_MATCH_LENGTH_MIN) <= m->size); m->next_pos++) {
+                const uint32_t h = lzb_hash(&src[m->next_pos]);
+
+                m->prev[m->next_pos & (LZB_WINDOW_SIZE - 1)] = m->head[h];
+                m->head[h] = m->next_pos;
+        }
+
+        const uint32_t length_max = m->size - pos;
+
+        if (length_max < LZB_MATCH_LENGTH_MIN) {
+                return 0;
+        }
+
+        uint32_t best_length;
+        best_length = LZB_MATCH_LENGTH_MIN - 1;
+
+        uint32_t best_distance;
+        best_distance = 0;
+
+        int32_t candidate;
+        candidate = m->head[lzb_hash(&src[pos])];
+
+        for (uint32_t chain = 0; (candidate >= 0) && (chain < LZB_CHAIN_LENGTH_MAX);
+             candidate = m->prev[candidate & (LZB_WINDOW_SIZE - 1)], chain++) {
+                const uint32_t d = pos - candidate;
+
+                if (d > LZB_DISTANCE_MAX) {
+                        break;
+                }
+
+                const bool aligned_better =
+                    ((d & 0x03) == 0) && ((best_distance & 0x03) != 0);
+
+                /* Quickly skip candidates that can't be any better */
+                if (!aligned_better &&
+                    ((best_length >= length_max) ||
+                        (src[candidate + best_length] != src[pos + best_length]))) {
+                        continue;
+                }
+
+                uint32_t length;
+
+                for (length = 0; (length < length_max) &&
+                             (src[candidate + length] == src[pos + length]); length++) {
+                }
+
+                if ((length > best_length) ||
+                    (aligned_better && (length == best_length))) {
+                        best_length = length;
+                        best_distance = d;
+
+                        if ((length == length_max) ||
+                            ((length >= LZB_MATCH_LENGTH_NICE) && ((d & 0x03) == 0))) {
+                                break;
+                        }
+                }
+        }
+
+        if (best_length < LZB_MATCH_LENGTH_MIN) {
+                return 0;
+        }
+
+        *distance = best_distance;
+
+        return best_length;
+}
+
+static uint8_t *
+lzb_length_put(uint8_t *dst, uint32_t length)
+{
+        for (length -= LZB_NIBBLE_MAX; length >= 0xFF; length -= 0xFF) {
+                *dst++ = 0xFF;
+        }
+
+        *dst++ = length;
+
+        return dst;
+}
+
+static uint8_t *
+lzb_sequence_put(uint8_t *dst, const uint8_t *literals, uint32_t count,
+    uint32_t distance, uint32_t length)
+{
+        const uint32_t length_field = (distance != 0) ? (length - LZB_MATCH_LENGTH_MIN) : 0;
+
+        const uint32_t count_nibble = (count < LZB_NIBBLE_MAX) ? count : LZB_NIBBLE_MAX;
+        const uint32_t length_nibble =
+            (length_field < LZB_NIBBLE_MAX) ? length_field : LZB_NIBBLE_MAX;
+
+        *dst++ = (count_nibble << 4) | length_nibble;
+
+        if (count_nibble == LZB_NIBBLE_MAX) {
+                dst = lzb_length_put(dst, count);
+        }
+
+        (void)memcpy(dst, literals, count);
+        dst += count;
+
+        if (distance == 0) {
+                return dst;
+        }
+
+        *dst++ = distance >> 8;
+        *dst++ = distance;
+
+        if (length_nibble == LZB_NIBBLE_MAX) {
+                dst = lzb_length_put(dst, length_field);
+        }
+
+        return dst;
+}
+
+/*
+ * Compressor with hash chains and one step of lazy matching: a match is
+ * dropped for a literal when the next position has a longer one. The
+ * destination buffer must be at least size + (size / 255) + 16 bytes.
+ *
+ * Returns the size of the compressed data.
+ */
+uint32_t
+lzb_compress(void *source, void *dest, uint32_t size)
+{
+        const uint8_t * const src = source;
+        uint8_t * const dst_start = dest;
+
+        lzb_matcher_t m = {
+                .src = src,
+                .size = size,
+                .head = malloc(LZB_HASH_SIZE * sizeof(int32_t)),
+                .prev = malloc(LZB_WINDOW_SIZE * sizeof(int32_t)),
+                .next_pos = 0
+        };
+
+        for (uint32_t i = 0; i < LZB_HASH_SIZE; i++) {
+                m.head[i] = -1;
+        }
+
+        uint8_t *dst;
+        dst = dst_start;
+
+        uint32_t literals_pos;
+        literals_pos = 0;
+
+        uint32_t pos;
+        pos = 0;
+
+        while (pos < size) {
+                uint32_t distance;
+                const uint32_t length = lzb_match_find(&m, pos, &distance);
+
+                if (length == 0) {
+                        pos++;
+
+                        continue;
+                }
+
+                uint32_t next_distance;
+
+                if ((lzb_match_find(&m, pos + 1, &next_distance)) > length) {
+                        pos++;
+
+                        continue;
+                }
+
+                dst = lzb_sequence_put(dst, &src[literals_pos],
+                    pos - literals_pos, distance, length);
+
+                pos += length;
+                literals_pos = pos;
+        }
+
+        dst = lzb_sequence_put(dst, &src[literals_pos], size - literals_pos, 0, 0);
+
+        free(m.prev);
+        free(m.head);
+
+        return (dst - dst_start);
+}
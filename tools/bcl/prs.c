@@ -1,6 +1,10 @@
 #include <stdbool.h>
-#include <stdio.h>
-#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcl.h"
 
 typedef struct {
         uint8_t bitpos;
@@ -71,7 +75,8 @@ void prs_finish(PRS_COMPRESSOR* pc)
 {
         //printf("> > > prs_finish[1]: %08X->%08X\n",pc->srcptr - pc->srcptr_orig,pc->dstptr - pc->dstptr_orig);
         prs_put_control_bit(pc,0);
-        prs_put_control_bit(pc,1);
+        /* Don't start a new control byte, as the end marker follows */
+        prs_put_control_bit_nosave(pc,1);
         //printf("> > > prs_finish[2]: %08X->%08X %d\n",pc->srcptr - pc->srcptr_orig,pc->dstptr - pc->dstptr_orig,pc->bitpos);
         //pc->controlbyte = pc->controlbyte << (8 - pc->bitpos);
         if (pc->bitpos != 0) {
@@ -141,10 +146,8 @@ void prs_copy(PRS_COMPRESSOR* pc,int offset,uint8_t size)
           if (err) system("PAUSE"); */
         //else printf("> > > prs_copy: %08X->%08X @ %08X:%08X\n",pc->srcptr - pc->srcptr_orig,pc->dstptr - pc->dstptr_orig,offset,size);
         if ((offset > -0x100) && (size <= 5)) {
-                printf("> > > %08X->%08X sdat %08X %08X\n",pc->srcptr - pc->srcptr_orig,pc->dstptr - pc->dstptr_orig,offset,size);
                 prs_shortcopy(pc,offset,size);
         } else {
-                printf("> > > %08X->%08X ldat %08X %08X\n",pc->srcptr - pc->srcptr_orig,pc->dstptr - pc->dstptr_orig,offset,size);
                 prs_longcopy(pc,offset,size);
         }
         pc->srcptr += size;
@@ -152,190 +155,398 @@ void prs_copy(PRS_COMPRESSOR* pc,int offset,uint8_t size)
 
 ////////////////////////////////////////////////////////////////////////////////
 
-uint32_t prs_decompress(void* source,void* dest)    // 800F7CB0 through 800F7DE4 in mem
+/*
+ * The stream is a sequence of control bits, read LSB first out of control
+ * bytes interleaved with the data:
+ *
+ *   1      Literal byte
+ *   00nn   Short copy of nn+2 bytes, from -256..-1 (one offset byte)
+ *   01     Long copy, from -8192..-1 (two bytes, plus a size byte if the
+ *          size field is 0). An offset of 0 ends the stream
+ *
+ * A guard bit above the eight control bits tells when the control byte is
+ * exhausted, which saves maintaining a separate bit counter.
+ */
+
+#define CONTROL_GUARD           (0x100)
+#define CONTROL_EMPTY           (0x001)
+
+#define SOURCE_CHECK(n) do {                                                   \
+        if (bounded && ((size_t)(src_end - src) < (size_t)(n))) {              \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define DEST_CHECK(n) do {                                                     \
+        if (bounded && ((size_t)(dst_end - dst) < (size_t)(n))) {              \
+                return -1;                                                     \
+        }                                                                      \
+} while (false)
+
+#define CONTROL_BIT_GET(bit) do {                                              \
+        if (control == CONTROL_EMPTY) {                                        \
+                SOURCE_CHECK(1);                                               \
+                control = *src++ | CONTROL_GUARD;                              \
+        }                                                                      \
+        (bit) = control & 0x01;                                                \
+        control >>= 1;                                                         \
+} while (false)
+
+static inline void
+_literals_8_copy(uint8_t *dst, const uint8_t *src)
+{
+        if ((((uintptr_t)dst | (uintptr_t)src) & 0x03) == 0) {
+                uint32_t * const dst_32 = (uint32_t *)dst;
+                const uint32_t * const src_32 = (const uint32_t *)src;
+
+                dst_32[0] = src_32[0];
+                dst_32[1] = src_32[1];
+
+                return;
+        }
+
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = src[3];
+        dst[4] = src[4];
+        dst[5] = src[5];
+        dst[6] = src[6];
+        dst[7] = src[7];
+}
+
+static inline void
+_match_copy(uint8_t *dst, int32_t offset, uint32_t size)
+{
+        const uint8_t *ref = dst + offset;
+        const uint32_t distance = -offset;
+
+        if (distance == 1) {
+                /* Run of a single byte */
+                (void)memset(dst, *ref, size);
+
+                return;
+        }
+
+        if ((distance >= size) && (size >= 16)) {
+                (void)memcpy(dst, ref, size);
+
+                return;
+        }
+
+        if (distance >= 4) {
+                /* Each group of four bytes only reads bytes that were written
+                 * before the group, so this is safe even when overlapping */
+                for (; size >= 4; size -= 4) {
+                        dst[0] = ref[0];
+                        dst[1] = ref[1];
+                        dst[2] = ref[2];
+                        dst[3] = ref[3];
+
+                        dst += 4;
+                        ref += 4;
+                }
+        }
+
+        for (; size > 0; size--) {
+                *dst++ = *ref++;
+        }
+}
+
+static inline int32_t
+_prs_decode(const uint8_t *src, const uint8_t *src_end, uint8_t *dst,
+    const uint8_t *dst_end, bool bounded)
 {
-        uint32_t r0,r3,r5,r6,r9; // 6 unnamed registers
-        uint32_t bitpos = 9; // 4 named registers
-        uint8_t* sourceptr = (uint8_t*) source;
-        uint8_t* sourceptr_orig = (uint8_t*) source;
-        uint8_t* destptr = (uint8_t*) dest;
-        uint8_t* destptr_orig = (uint8_t*) dest;
-        uint8_t currentbyte;
-        bool flag;
-        int offset;
-        uint32_t x,t; // 2 placed variables
-
-        printf("\n> decompressing\n");
-        currentbyte = sourceptr[0];
-        sourceptr++;
+        uint8_t * const dst_start = dst;
+
+        uint32_t control;
+        uint32_t bit;
+
+        SOURCE_CHECK(1);
+        control = *src++ | CONTROL_GUARD;
+
         for (;;) {
-                bitpos--;
-                if (bitpos == 0) {
-                        currentbyte = sourceptr[0];
-                        bitpos = 8;
-                        sourceptr++;
+                if (control == CONTROL_EMPTY) {
+                        SOURCE_CHECK(1);
+
+                        const uint32_t control_byte = *src++;
+
+                        if (control_byte == 0xFF) {
+                                /* Eight literals in a row. Common in data
+                                 * that doesn't compress well */
+                                SOURCE_CHECK(8);
+                                DEST_CHECK(8);
+
+                                _literals_8_copy(dst, src);
+
+                                src += 8;
+                                dst += 8;
+
+                                continue;
+                        }
+
+                        control = control_byte | CONTROL_GUARD;
                 }
-                flag = currentbyte & 1;
-                currentbyte = currentbyte >> 1;
-                if (flag) {
-                        destptr[0] = sourceptr[0];
-                        printf("> > > %08X->%08X byte\n",sourceptr - sourceptr_orig,destptr - destptr_orig);
-                        sourceptr++;
-                        destptr++;
+
+                CONTROL_BIT_GET(bit);
+
+                if (bit != 0) {
+                        SOURCE_CHECK(1);
+                        DEST_CHECK(1);
+
+                        *dst++ = *src++;
+
                         continue;
                 }
-                bitpos--;
-                if (bitpos == 0) {
-                        currentbyte = sourceptr[0];
-                        bitpos = 8;
-                        sourceptr++;
-                }
-                flag = currentbyte & 1;
-                currentbyte = currentbyte >> 1;
-                if (flag) {
-                        r3 = sourceptr[0] & 0xFF;
-                        //printf("> > > > > first: %02X - ",sourceptr[0]); system("PAUSE");
-                        offset = ((sourceptr[1] & 0xFF) << 8) | r3;
-                        //printf("> > > > > second: %02X - ",sourceptr[1]); system("PAUSE");
-                        sourceptr += 2;
-                        if (offset == 0) {
-                                return (uint32_t)(destptr - destptr_orig);
+
+                int32_t offset;
+                uint32_t size;
+
+                CONTROL_BIT_GET(bit);
+
+                if (bit != 0) {
+                        SOURCE_CHECK(2);
+
+                        const uint32_t word = src[0] | (src[1] << 8);
+
+                        if (word == 0) {
+                                return (dst - dst_start);
                         }
-                        r3 = r3 & 0x00000007;
-                        r5 = (offset >> 3) | 0xFFFFE000;
-                        if (r3 == 0) {
-                                flag = 0;
-                                r3 = sourceptr[0] & 0xFF;
-                                sourceptr++;
-                                r3++;
+
+                        size = src[0] & 0x07;
+                        offset = (int32_t)((word >> 3) | 0xFFFFE000);
+
+                        src += 2;
+
+                        if (size == 0) {
+                                SOURCE_CHECK(1);
+
+                                size = *src++ + 1;
                         } else {
-                                r3 += 2;
+                                size += 2;
                         }
-                        r5 += (uint32_t) destptr;
-                        printf("> > > %08X->%08X ldat %08X %08X %s\n",sourceptr - sourceptr_orig,destptr - destptr_orig,r5 - (uint32_t) destptr,r3,flag ? "inline" : "extended");
                 } else {
-                        r3 = 0;
-                        for (x = 0; x < 2; x++) {
-                                bitpos--;
-                                if (bitpos == 0) {
-                                        currentbyte = sourceptr[0];
-                                        bitpos = 8;
-                                        sourceptr++;
-                                }
-                                flag = currentbyte & 1;
-                                currentbyte = currentbyte >> 1;
-                                offset = r3 << 1;
-                                r3 = offset | flag;
-                        }
-                        offset = sourceptr[0] | 0xFFFFFF00;
-                        r3 += 2;
-                        sourceptr++;
-                        r5 = offset + (uint32_t) destptr;
-                        printf("> > > %08X->%08X sdat %08X %08X\n",sourceptr - sourceptr_orig,destptr - destptr_orig,r5 - (uint32_t) destptr,r3);
-                }
-                if (r3 == 0) {
-                        continue;
+                        CONTROL_BIT_GET(bit);
+                        size = bit << 1;
+                        CONTROL_BIT_GET(bit);
+                        size |= bit;
+                        size += 2;
+
+                        SOURCE_CHECK(1);
+
+                        offset = (int32_t)(*src++ | 0xFFFFFF00);
                 }
-                t = r3;
-                for (x = 0; x < t; x++) {
-                        destptr[0] = * (uint8_t*) r5;
-                        r5++;
-                        r3++;
-                        destptr++;
+
+                if (bounded && ((uint32_t)(dst - dst_start) < (uint32_t)-offset)) {
+                        return -1;
                 }
+
+                DEST_CHECK(size);
+
+                _match_copy(dst, offset, size);
+
+                dst += size;
+        }
+}
+
+uint32_t
+prs_decompress(const void *source, void *dest)
+{
+        return _prs_decode(source, NULL, dest, NULL, false);
+}
+
+int32_t
+prs_decompress_bounded(const void *source, uint32_t source_size, void *dest,
+    uint32_t dest_size)
+{
+        const uint8_t * const src = source;
+        uint8_t * const dst = dest;
+
+        return _prs_decode(src, &src[source_size], dst, &dst[dest_size], true);
+}
+
+static inline uint32_t
+_control_bit_get(uint32_t *control, const uint8_t **src)
+{
+        if (*control == CONTROL_EMPTY) {
+                *control = *(*src)++ | CONTROL_GUARD;
         }
+
+        const uint32_t bit = *control & 0x01;
+
+        *control >>= 1;
+
+        return bit;
 }
 
-uint32_t prs_decompress_size(void* source)
+uint32_t
+prs_decompress_size(const void *source)
 {
-        uint32_t r0,r3,r5,r6,r9; // 6 unnamed registers
-        uint32_t bitpos = 9; // 4 named registers
-        uint8_t* sourceptr = (uint8_t*) source;
-        uint8_t* destptr = NULL;
-        uint8_t* destptr_orig = NULL;
-        uint8_t currentbyte,lastbyte;
-        bool flag;
-        int offset;
-        uint32_t x,t; // 2 placed variables
-
-        //printf("> %08X -> %08X: begin\n",sourceptr,destptr);
-        currentbyte = sourceptr[0];
-        //printf("> [ ] %08X -> %02X: command stream\n",sourceptr,currentbyte);
-        sourceptr++;
+        const uint8_t *src = source;
+
+        uint32_t size;
+        size = 0;
+
+        uint32_t control;
+        control = *src++ | CONTROL_GUARD;
+
         for (;;) {
-                bitpos--;
-                if (bitpos == 0) {
-                        lastbyte = currentbyte = sourceptr[0];
-                        bitpos = 8;
-                        //printf("> [ ] %08X -> %02X: command stream\n",sourceptr,currentbyte);
-                        sourceptr++;
-                }
-                flag = currentbyte & 1;
-                currentbyte = currentbyte >> 1;
-                if (flag) {
-                        //printf("> [1] %08X -> %08X: %02X\n",sourceptr,destptr,*sourceptr);
-                        sourceptr++;
-                        destptr++;
+                if ((_control_bit_get(&control, &src)) != 0) {
+                        src++;
+                        size++;
+
                         continue;
                 }
-                //printf("> [0] extended\n");
-                bitpos--;
-                if (bitpos == 0) {
-                        lastbyte = currentbyte = sourceptr[0];
-                        bitpos = 8;
-                        //printf("> [ ] %08X -> %02X: command stream\n",sourceptr,currentbyte);
-                        sourceptr++;
-                }
-                flag = currentbyte & 1;
-                currentbyte = currentbyte >> 1;
-                if (flag) {
-                        r3 = sourceptr[0];
-                        offset = (sourceptr[1] << 8) | r3;
-                        sourceptr += 2;
-                        if (offset == 0) {
-                                return (uint32_t)(destptr - destptr_orig);
+
+                if ((_control_bit_get(&control, &src)) != 0) {
+                        const uint32_t word = src[0] | (src[1] << 8);
+
+                        if (word == 0) {
+                                return size;
                         }
-                        r3 = r3 & 0x00000007;
-                        r5 = (offset >> 3) | 0xFFFFE000;
-                        if (r3 == 0) {
-                                r3 = sourceptr[0];
-                                sourceptr++;
-                                r3++;
+
+                        const uint32_t long_size = src[0] & 0x07;
+
+                        src += 2;
+
+                        if (long_size == 0) {
+                                size += *src++ + 1;
                         } else {
-                                r3 += 2;
+                                size += long_size + 2;
                         }
-                        r5 += (uint32_t) destptr;
-                        //printf("> > [1] %08X -> %08X: block copy (%d)\n",r5,destptr,r3);
                 } else {
-                        r3 = 0;
-                        for (x = 0; x < 2; x++) {
-                                bitpos--;
-                                if (bitpos == 0) {
-                                        lastbyte = currentbyte = sourceptr[0];
-                                        bitpos = 8;
-                                        //printf("> [ ] %08X -> %02X: command stream\n",sourceptr,currentbyte);
-                                        sourceptr++;
+                        uint32_t short_size;
+                        short_size = _control_bit_get(&control, &src) << 1;
+                        short_size |= _control_bit_get(&control, &src);
+
+                        src++;
+
+                        size += short_size + 2;
+                }
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Back-references reach at most 8191 bytes behind, as an offset of -8192
+ * would encode the end marker */
+#define PRS_WINDOW_SIZE         8192
+#define PRS_DISTANCE_MAX        (PRS_WINDOW_SIZE - 1)
+#define PRS_SHORT_DISTANCE_MAX  0xFF
+#define PRS_LENGTH_MAX          255
+#define PRS_HASH_BITS           15
+#define PRS_HASH_SIZE           (1 << PRS_HASH_BITS)
+#define PRS_CHAIN_LENGTH_MAX    256
+
+static uint32_t
+prs_hash(const uint8_t *p)
+{
+        const uint32_t v = (p[0] << 16) | (p[1] << 8) | p[2];
+
+        return ((v * 2654435761U) >> (32 - PRS_HASH_BITS)) & (PRS_HASH_SIZE - 1);
+}
+
+/*
+ * Greedy compressor. Matches are found with hash chains over the last
+ * PRS_DISTANCE_MAX bytes. The destination buffer must be at least
+ * ((size * 9) / 8) + 8 bytes.
+ *
+ * Returns the size of the compressed data.
+ */
+uint32_t
+prs_compress(void *source, void *dest, uint32_t size)
+{
+        const uint8_t * const src = source;
+
+        PRS_COMPRESSOR pc;
+        prs_init(&pc, source, dest);
+
+        int32_t * const head = malloc(PRS_HASH_SIZE * sizeof(int32_t));
+        int32_t * const prev = malloc(PRS_WINDOW_SIZE * sizeof(int32_t));
+
+        for (uint32_t i = 0; i < PRS_HASH_SIZE; i++) {
+                head[i] = -1;
+        }
+
+        uint32_t pos;
+        pos = 0;
+
+        while (pos < size) {
+                uint32_t best_length;
+                uint32_t best_distance;
+
+                best_length = 0;
+                best_distance = 0;
+
+                const uint32_t length_max = ((size - pos) < PRS_LENGTH_MAX)
+                    ? (size - pos)
+                    : PRS_LENGTH_MAX;
+
+                if (length_max >= 3) {
+                        int32_t candidate;
+                        candidate = head[prs_hash(&src[pos])];
+
+                        for (uint32_t chain = 0;
+                             (candidate >= 0) && (chain < PRS_CHAIN_LENGTH_MAX);
+                             chain++) {
+                                const uint32_t distance = pos - candidate;
+
+                                if (distance > PRS_DISTANCE_MAX) {
+                                        break;
+                                }
+
+                                uint32_t length;
+                                length = 0;
+
+                                while ((length < length_max) &&
+                                       (src[candidate + length] == src[pos + length])) {
+                                        length++;
                                 }
-                                flag = currentbyte & 1;
-                                currentbyte = currentbyte >> 1;
-                                offset = r3 << 1;
-                                r3 = offset | flag;
+
+                                if (length > best_length) {
+                                        best_length = length;
+                                        best_distance = distance;
+
+                                        if (length == length_max) {
+                                                break;
+                                        }
+                                }
+
+                                candidate = prev[candidate & (PRS_WINDOW_SIZE - 1)];
                         }
-                        offset = sourceptr[0] | 0xFFFFFF00;
-                        r3 += 2;
-                        sourceptr++;
-                        r5 = offset + (uint32_t) destptr;
-                        //printf("> > [0] %08X -> %08X: block copy (%d)\n",r5,destptr,r3);
                 }
-                if (r3 == 0) {
-                        continue;
+
+                /* Two byte matches are only worth it as short copies */
+                if ((best_length == 2) && (best_distance > PRS_SHORT_DISTANCE_MAX)) {
+                        best_length = 0;
+                }
+
+                uint32_t advance;
+
+                if (best_length >= 2) {
+                        prs_copy(&pc, -(int)best_distance, best_length);
+
+                        advance = best_length;
+                } else {
+                        prs_rawbyte(&pc);
+
+                        advance = 1;
                 }
-                t = r3;
-                //printf("> > [ ] copying %d bytes\n",t);
-                for (x = 0; x < t; x++) {
-                        r5++;
-                        r3++;
-                        destptr++;
+
+                for (; advance > 0; advance--, pos++) {
+                        if ((pos + 3) <= size) {
+                                const uint32_t hash = prs_hash(&src[pos]);
+
+                                prev[pos & (PRS_WINDOW_SIZE - 1)] = head[hash];
+                                head[hash] = pos;
+                        }
                 }
         }
+
+        prs_finish(&pc);
+
+        free(prev);
+        free(head);
+
+        return (uint32_t)(pc.dstptr - pc.dstptr_orig);
 }
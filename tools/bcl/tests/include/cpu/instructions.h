@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _TESTS_CPU_INSTRUCTIONS_H_
+#define _TESTS_CPU_INSTRUCTIONS_H_
+
+#include <stdint.h>
+
+/* Host stand-in for the SH-2 instructions used by libbcl. Each one works on
+ * values loaded from memory, so it has the same effect on the bytes in
+ * memory regardless of the byte order of the host */
+
+static inline uint32_t
+cpu_instr_xtrct(uint32_t rm, uint32_t rn)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        return (rm >> 16) | (rn << 16);
+#else
+        return (rm << 16) | (rn >> 16);
+#endif
+}
+
+#endif /* !_TESTS_CPU_INSTRUCTIONS_H_ */
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _TESTS_SYS_CDEFS_H_
+#define _TESTS_SYS_CDEFS_H_
+
+/* Stand-in for the definitions libbcl expects from the libyaul headers
+ * when built for the host */
+
+#include_next <sys/cdefs.h>
+
+/* The C library may define it as "__inline" along with the attribute */
+#undef __always_inline
+#define __always_inline __attribute__ ((__always_inline__))
+
+#ifndef __predict_false
+#define __predict_false(x) __builtin_expect((x), 0)
+#endif /* !__predict_false */
+
+#ifndef __unused
+#define __unused __attribute__ ((__unused__))
+#endif /* !__unused */
+
+#endif /* !_TESTS_SYS_CDEFS_H_ */
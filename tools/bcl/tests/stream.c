@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bcl.h"
+
+/*
+ * Decodes a file compressed by the bcl tool with the libbcl decoders, and
+ * compares the output with the original file.
+ *
+ * The whole file is decoded with bcl_uncompress(). Codecs that can be
+ * decoded incrementally are also decoded with the smallest window the codec
+ * allows, and a larger one, passing the compressed data in chunks of
+ * various sizes.
+ */
+
+#define PROGNAME "stream"
+
+static const uint32_t _chunk_sizes[] = {
+        1,
+        7,
+        4096,
+        UINT32_MAX
+};
+
+static uint8_t *_file_read(const char *, uint32_t *);
+static uint32_t _window_size_min_get(uint8_t);
+static int _stream_check(const uint8_t *, const bcl_header_t *,
+    const uint8_t *, uint32_t, uint32_t);
+
+int
+main(int argc, char *argv[])
+{
+        if (argc != 3) {
+                fprintf(stderr, "usage: %s file.bcl file\n", PROGNAME);
+
+                return 1;
+        }
+
+        uint32_t in_size;
+        uint8_t * const in = _file_read(argv[1], &in_size);
+
+        uint32_t expected_size;
+        uint8_t * const expected = _file_read(argv[2], &expected_size);
+
+        if ((in == NULL) || (expected == NULL)) {
+                return 1;
+        }
+
+        bcl_header_t header;
+
+        if ((in_size < BCL_HEADER_SIZE) ||
+            ((bcl_header_parse(in, &header)) < 0) ||
+            (header.uncompressed_size != expected_size)) {
+                fprintf(stderr, "%s: %s: Invalid header\n", PROGNAME, argv[1]);
+
+                return 1;
+        }
+
+        /* Never allocate zero bytes */
+        uint8_t * const out = malloc(expected_size + 1);
+
+        if (((bcl_uncompress(in, out, expected_size)) != (int32_t)expected_size) ||
+            ((memcmp(out, expected, expected_size)) != 0)) {
+                fprintf(stderr, "%s: %s: bcl_uncompress() failed\n", PROGNAME,
+                    argv[1]);
+
+                return 1;
+        }
+
+        if (!(bcl_stream_codec_supported(header.codec))) {
+                return 0;
+        }
+
+        const uint32_t window_size_min = _window_size_min_get(header.codec);
+
+        /* A smaller window than the codec needs is rejected, unless the
+         * window holds all of the data */
+        bcl_stream_t stream;
+
+        if ((window_size_min > 1) && (expected_size > (window_size_min >> 1)) &&
+            ((bcl_stream_init(&stream, &header, out, window_size_min >> 1)) == 0)) {
+                fprintf(stderr, "%s: %s: Window too small, but accepted\n",
+                    PROGNAME, argv[1]);
+
+                return 1;
+        }
+
+        int exit_code;
+        exit_code = 0;
+
+        for (uint32_t i = 0; i < (sizeof(_chunk_sizes) / sizeof(*_chunk_sizes)); i++) {
+                for (uint32_t window_size = window_size_min;
+                     window_size <= (window_size_min << 1);
+                     window_size <<= 1) {
+                        if ((_stream_check(in, &header, expected, window_size,
+                                    _chunk_sizes[i])) < 0) {
+                                fprintf(stderr, "%s: %s: Stream failed "
+                                    "(window %u, chunk %u)\n",
+                                    PROGNAME,
+                                    argv[1],
+                                    (unsigned int)window_size,
+                                    (unsigned int)_chunk_sizes[i]);
+
+                                exit_code = 1;
+                        }
+                }
+        }
+
+        free(out);
+        free(expected);
+        free(in);
+
+        return exit_code;
+}
+
+static uint8_t *
+_file_read(const char *filepath, uint32_t *size)
+{
+        FILE *fp;
+
+        if ((fp = fopen(filepath, "rb")) == NULL) {
+                fprintf(stderr, "%s: %s: Unable to open\n", PROGNAME, filepath);
+
+                return NULL;
+        }
+
+        (void)fseek(fp, 0, SEEK_END);
+        *size = ftell(fp);
+        (void)fseek(fp, 0, SEEK_SET);
+
+        /* Never allocate zero bytes */
+        uint8_t * const buffer = malloc(*size + 1);
+
+        if ((fread(buffer, 1, *size, fp)) != *size) {
+                fprintf(stderr, "%s: %s: Unable to read\n", PROGNAME, filepath);
+
+                free(buffer);
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        (void)fclose(fp);
+
+        return buffer;
+}
+
+static uint32_t
+_window_size_min_get(uint8_t codec)
+{
+        switch (codec) {
+        case BCL_CODEC_LZ:
+                return BCL_STREAM_WINDOW_SIZE_LZ;
+        case BCL_CODEC_LZB:
+                return BCL_STREAM_WINDOW_SIZE_LZB;
+        case BCL_CODEC_PRS:
+                return BCL_STREAM_WINDOW_SIZE_PRS;
+        default:
+                /* Nothing is copied out of the window */
+                return 1;
+        }
+}
+
+static int
+_stream_check(const uint8_t *in, const bcl_header_t *header,
+    const uint8_t *expected, uint32_t window_size, uint32_t chunk_size)
+{
+        uint8_t * const window = malloc(window_size);
+
+        bcl_stream_t stream;
+
+        if ((bcl_stream_init(&stream, header, window, window_size)) < 0) {
+                free(window);
+
+                return -1;
+        }
+
+        const uint8_t *src = &in[BCL_HEADER_SIZE];
+
+        uint32_t src_left;
+        src_left = header->compressed_size;
+
+        uint32_t out_size;
+        out_size = 0;
+
+        int ret;
+        ret = 0;
+
+        while (!(bcl_stream_done(&stream))) {
+                const uint32_t size = (src_left < chunk_size) ? src_left : chunk_size;
+
+                const int32_t used = bcl_stream_decompress(&stream, src, size);
+
+                if (used < 0) {
+                        ret = -1;
+
+                        break;
+                }
+
+                src += used;
+                src_left -= used;
+
+                const void *out;
+                uint32_t out_span;
+
+                /* The output may wrap around the end of the window */
+                bool consumed;
+                consumed = false;
+
+                while ((out_span = bcl_stream_output_get(&stream, &out)) > 0) {
+                        if (((out_size + out_span) > header->uncompressed_size) ||
+                            ((memcmp(out, &expected[out_size], out_span)) != 0)) {
+                                ret = -1;
+
+                                break;
+                        }
+
+                        bcl_stream_output_consume(&stream, out_span);
+
+                        out_size += out_span;
+                        consumed = true;
+                }
+
+                if (ret < 0) {
+                        break;
+                }
+
+                /* Nothing was decoded or consumed: the data is truncated */
+                if ((used == 0) && !consumed && !(bcl_stream_done(&stream))) {
+                        ret = -1;
+
+                        break;
+                }
+        }
+
+        if (out_size != header->uncompressed_size) {
+                ret = -1;
+        }
+
+        free(window);
+
+        return ret;
+}
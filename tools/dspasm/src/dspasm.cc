@@ -9,10 +9,33 @@
 #include <cstdio>
 #include <cstdlib>
 #include <fstream>
+#include <iomanip>
+#include <iostream>
 #include <string>
+#include <vector>
+
+#include <unistd.h>
 
 #include "dspasm.hh"
 #include "driver.hh"
+#include "simulator.hh"
+
+/* Default cycle limit when simulating */
+#define CYCLE_LIMIT 1000000
+
+struct load {
+    uint32_t address;
+    std::string file;
+};
+
+struct simulate_options {
+    std::vector<load> pages;
+    std::vector<load> memory;
+    std::vector<uint32_t> dump_pages;
+    std::vector<std::pair<uint32_t, uint32_t> > dump_memory;
+    uint64_t cycle_limit;
+    bool profile;
+};
 
 static int usage(char *argv[])
 {
@@ -22,7 +45,13 @@ static int usage(char *argv[])
     progname = progname.substr(1 + progname.find_last_of("/\\"));
 
     std::cerr << "usage:" << " " << progname << " "
-              << "[file]" << std::endl;
+              << "[file]" << std::endl
+              << "       " << progname << " "
+              << "-s [-v] [-c cycles] [-p page:file] [-m address:file]"
+              << std::endl
+              << "       " << std::string(progname.size(), ' ') << " "
+              << "   [-d page] [-x address:count] [program-file]"
+              << std::endl;
 
     return EXIT_FAILURE;
 }
@@ -42,13 +71,160 @@ static int compile(const std::string& file)
     return err_no;
 }
 
+static bool parse_pair(const char *arg, uint32_t& first, std::string& second)
+{
+    char *end;
+
+    first = strtoul(arg, &end, 0);
+
+    if ((end == arg) || (*end != ':') || (*(end + 1) == '\0'))
+        return false;
+
+    second = end + 1;
+
+    return true;
+}
+
+static void dump_words(const std::string& title, uint32_t base,
+                       const std::vector<uint32_t>& words, int step)
+{
+    std::cout << title << std::hex << std::uppercase << std::setfill('0');
+
+    for (size_t i = 0; i < words.size(); i++) {
+        if ((i % 4) == 0)
+            std::cout << std::endl << std::setw(8) << (base + (i * step))
+                      << ":";
+
+        std::cout << " " << std::setw(8) << words[i];
+    }
+
+    std::cout << std::dec << std::setfill(' ') << std::endl;
+}
+
+/*
+ * Run an assembled program image on the simulator. The program, data RAM
+ * pages, and memory images are text files of 32-bit words.
+ */
+static int simulate(const std::string& file, const simulate_options& options)
+{
+    DSP::Simulator simulator;
+    std::vector<uint32_t> words;
+
+    if (!DSP::Simulator::parse_words(file, words))
+        return EXIT_FAILURE;
+
+    if (!simulator.load_program(words)) {
+        std::cerr << file << ": Program is too large" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    for (size_t i = 0; i < options.pages.size(); i++) {
+        const load& page = options.pages[i];
+
+        words.clear();
+
+        if (!DSP::Simulator::parse_words(page.file, words))
+            return EXIT_FAILURE;
+
+        if (!simulator.load_data(page.address, words)) {
+            std::cerr << page.file << ": Invalid data RAM page" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (size_t i = 0; i < options.memory.size(); i++) {
+        const load& memory = options.memory[i];
+
+        words.clear();
+
+        if (!DSP::Simulator::parse_words(memory.file, words))
+            return EXIT_FAILURE;
+
+        simulator.load_memory(memory.address, words);
+    }
+
+    const bool ended = simulator.run(options.cycle_limit);
+
+    if (!ended)
+        std::cerr << file << ": Cycle limit reached" << std::endl;
+
+    simulator.dump_statistics(std::cout);
+
+    if (options.profile)
+        simulator.dump_profile(std::cout);
+
+    for (size_t i = 0; i < options.dump_pages.size(); i++) {
+        const uint32_t page = options.dump_pages[i];
+
+        words.clear();
+
+        for (int offset = 0; offset < DSP::DATA_RAM_SIZE; offset++)
+            words.push_back(simulator.data(page, offset));
+
+        dump_words("M" + std::string(1, '0' + (page & 3)) + ":", 0, words, 1);
+    }
+
+    for (size_t i = 0; i < options.dump_memory.size(); i++) {
+        const uint32_t address = options.dump_memory[i].first;
+        const uint32_t count = options.dump_memory[i].second;
+
+        words.clear();
+
+        for (uint32_t j = 0; j < count; j++)
+            words.push_back(simulator.memory(address + (j * 4)));
+
+        dump_words("D0:", address, words, 4);
+    }
+
+    return ended ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char* argv[])
 {
     int ch;
     std::string file;
+    bool simulating;
+    simulate_options options;
+
+    simulating = false;
+    options.cycle_limit = CYCLE_LIMIT;
+    options.profile = false;
+
+    while ((ch = getopt(argc, argv, "svc:p:m:d:x:")) != -1) {
+        load l;
+        uint32_t value;
+        std::string count;
 
-    while ((ch = getopt(argc, argv, "")) != -1) {
         switch(ch) {
+        case 's':
+            simulating = true;
+            break;
+        case 'v':
+            options.profile = true;
+            break;
+        case 'c':
+            options.cycle_limit = strtoull(optarg, NULL, 0);
+            break;
+        case 'p':
+        case 'm':
+            if (!parse_pair(optarg, l.address, l.file))
+                return usage(argv);
+
+            if (ch == 'p')
+                options.pages.push_back(l);
+            else
+                options.memory.push_back(l);
+            break;
+        case 'd':
+            options.dump_pages.push_back(strtoul(optarg, NULL, 0));
+            break;
+        case 'x':
+            if (!parse_pair(optarg, value, count))
+                return usage(argv);
+
+            options.dump_memory.push_back(
+                std::make_pair(value, strtoul(count.c_str(), NULL, 0)));
+            break;
         default:
             return usage(argv);
         }
@@ -58,8 +234,11 @@ int main(int argc, char* argv[])
     arg_offset = argc - 1;
 
     file = argv[arg_offset];
-    if (file.empty() || (argc == 1))
+    if (file.empty() || (argc == 1) || (optind > arg_offset))
         return usage(argv);
 
+    if (simulating)
+        return simulate(file, options);
+
     return compile(file);
 }
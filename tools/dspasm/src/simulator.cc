@@ -0,0 +1,757 @@
+/*
+ * Copyright (c) 2012-2016 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "simulator.hh"
+
+/*
+ * DMA timing, in DSP cycles. These are estimates: the actual cost depends
+ * on the bus arbitration with the CPUs and the other SCU DMA levels.
+ */
+#define DMA_SETUP_CYCLES        2
+#define DMA_WRAM_H_LONG_CYCLES  2
+#define DMA_A_BUS_LONG_CYCLES   4
+#define DMA_B_BUS_LONG_CYCLES   4
+
+#define MASK_48                 0x0000FFFFFFFFFFFFLL
+
+/* D1-bus sources */
+#define SOURCE_ALL              9
+#define SOURCE_ALH              10
+
+/* D1-bus and load immediate destinations */
+#define DESTINATION_RX          4
+#define DESTINATION_PL          5
+#define DESTINATION_RA0         6
+#define DESTINATION_WA0         7
+#define DESTINATION_LOP         10
+#define DESTINATION_TOP         11
+#define DESTINATION_CT0         12
+#define DESTINATION_PC          12
+
+/* Condition bits */
+#define CONDITION_Z             0x01
+#define CONDITION_S             0x02
+#define CONDITION_C             0x04
+#define CONDITION_T0            0x08
+#define CONDITION_SET           0x20
+
+static int64_t sign_extend(uint64_t value, int bits)
+{
+    const uint64_t m = 1ULL << (bits - 1);
+
+    value &= (1ULL << bits) - 1;
+
+    return (int64_t)((value ^ m) - m);
+}
+
+DSP::Simulator::Simulator()
+{
+    memset(_program, 0x00, sizeof(_program));
+    memset(_data, 0x00, sizeof(_data));
+
+    reset();
+}
+
+void DSP::Simulator::reset()
+{
+    _pc = 0;
+    memset(_ct, 0x00, sizeof(_ct));
+    _rx = 0;
+    _ry = 0;
+    _p = 0;
+    _a = 0;
+    _ra0 = 0;
+    _wa0 = 0;
+    _lop = 0;
+    _top = 0;
+
+    _z = false;
+    _s = false;
+    _c = false;
+    _v = false;
+    _end = false;
+
+    _branch = false;
+    _branch_pc = 0;
+    _repeat = false;
+
+    _dma_end_cycle = 0;
+    _dma_page = -1;
+
+    memset(&_statistics, 0x00, sizeof(_statistics));
+    memset(_profile, 0x00, sizeof(_profile));
+}
+
+bool DSP::Simulator::load_program(const std::vector<uint32_t> &words)
+{
+    if (words.size() > PROGRAM_RAM_SIZE)
+        return false;
+
+    memset(_program, 0x00, sizeof(_program));
+
+    for (size_t i = 0; i < words.size(); i++)
+        _program[i] = words[i];
+
+    return true;
+}
+
+bool DSP::Simulator::load_data(int page, const std::vector<uint32_t> &words)
+{
+    if ((page < 0) || (page >= DATA_RAM_PAGES))
+        return false;
+
+    if (words.size() > DATA_RAM_SIZE)
+        return false;
+
+    for (size_t i = 0; i < words.size(); i++)
+        _data[page][i] = words[i];
+
+    return true;
+}
+
+void DSP::Simulator::load_memory(uint32_t address,
+                                 const std::vector<uint32_t> &words)
+{
+    address &= 0x07FFFFFC;
+
+    for (size_t i = 0; i < words.size(); i++)
+        _memory[address + (i * 4)] = words[i];
+}
+
+uint32_t DSP::Simulator::data(int page, int offset) const
+{
+    return _data[page & 3][offset & (DATA_RAM_SIZE - 1)];
+}
+
+uint32_t DSP::Simulator::memory(uint32_t address) const
+{
+    std::map<uint32_t, uint32_t>::const_iterator it;
+
+    it = _memory.find(address & 0x07FFFFFC);
+
+    return (it != _memory.end()) ? it->second : 0;
+}
+
+uint32_t DSP::Simulator::program(int pc) const
+{
+    return _program[pc & (PROGRAM_RAM_SIZE - 1)];
+}
+
+const DSP::Statistics& DSP::Simulator::statistics() const
+{
+    return _statistics;
+}
+
+const DSP::Profile& DSP::Simulator::profile(int pc) const
+{
+    return _profile[pc & (PROGRAM_RAM_SIZE - 1)];
+}
+
+bool DSP::Simulator::run(uint64_t cycle_limit)
+{
+    while (!_end) {
+        if (_statistics.cycles >= cycle_limit)
+            return false;
+
+        const uint8_t pc = _pc;
+        const uint32_t instr = _program[pc];
+
+        /* The program is held back when it needs the DMA, or the data RAM
+         * page the DMA is using */
+        if (_t0()) {
+            const uint64_t stall_cycles =
+                _dma_end_cycle - _statistics.cycles;
+
+            if ((instr >> 28) == 0xC) {
+                _statistics.dma_stall_cycles += stall_cycles;
+                _statistics.cycles += stall_cycles;
+                _profile[pc].stall_cycles += stall_cycles;
+            } else if ((_pages_accessed(instr) & (1 << _dma_page)) != 0) {
+                _statistics.bank_stall_cycles += stall_cycles;
+                _statistics.cycles += stall_cycles;
+                _profile[pc].stall_cycles += stall_cycles;
+            }
+        }
+
+        const bool branch = _branch;
+        const uint8_t branch_pc = _branch_pc;
+        const bool repeat = _repeat;
+
+        _branch = false;
+        _repeat = false;
+
+        switch (instr >> 30) {
+        case 0x0:
+            _operation(instr);
+            break;
+        case 0x2:
+            _load_immediate(instr);
+            break;
+        case 0x3:
+            switch ((instr >> 28) & 0x3) {
+            case 0x0:
+                _dma(instr);
+                break;
+            case 0x1:
+                _jump(instr);
+                break;
+            case 0x2:
+                _loop(instr);
+                break;
+            case 0x3:
+                _end = true;
+                break;
+            }
+            break;
+        default:
+            /* Undefined, treated as NOP */
+            break;
+        }
+
+        _statistics.cycles++;
+        _statistics.instructions++;
+        _profile[pc].count++;
+
+        if (repeat && (_lop != 0)) {
+            _lop = (_lop - 1) & 0x0FFF;
+            _repeat = true;
+            continue;
+        }
+
+        _pc = branch ? branch_pc : ((pc + 1) & (PROGRAM_RAM_SIZE - 1));
+    }
+
+    /* The program may end before the last transfer does */
+    if (_t0()) {
+        _statistics.cycles = _dma_end_cycle;
+    }
+
+    return true;
+}
+
+bool DSP::Simulator::_t0() const
+{
+    return (_statistics.cycles < _dma_end_cycle);
+}
+
+bool DSP::Simulator::_condition(uint32_t condition) const
+{
+    uint32_t flags;
+
+    flags = 0;
+    flags |= _z ? CONDITION_Z : 0;
+    flags |= _s ? CONDITION_S : 0;
+    flags |= _c ? CONDITION_C : 0;
+    flags |= _t0() ? CONDITION_T0 : 0;
+
+    const uint32_t mask = condition & 0x0F;
+
+    if ((condition & CONDITION_SET) != 0)
+        return ((flags & mask) != 0);
+
+    return ((flags & mask) == 0);
+}
+
+int DSP::Simulator::_pages_accessed(uint32_t instr) const
+{
+    int pages;
+
+    pages = 0;
+
+    switch (instr >> 30) {
+    case 0x0:
+        /* X-bus */
+        if (((instr & (1 << 25)) != 0) || (((instr >> 23) & 0x3) == 0x3))
+            pages |= 1 << ((instr >> 20) & 0x3);
+
+        /* Y-bus */
+        if (((instr & (1 << 19)) != 0) || (((instr >> 17) & 0x3) == 0x3))
+            pages |= 1 << ((instr >> 14) & 0x3);
+
+        /* D1-bus */
+        if (((instr >> 12) & 0x3) == 0x3) {
+            if ((instr & 0x0F) <= 7)
+                pages |= 1 << (instr & 0x3);
+        }
+
+        if ((((instr >> 12) & 0x3) != 0) && (((instr >> 8) & 0x0F) <= 3))
+            pages |= 1 << ((instr >> 8) & 0x3);
+        break;
+    case 0x2:
+        if (((instr >> 26) & 0x0F) <= 3)
+            pages |= 1 << ((instr >> 26) & 0x3);
+        break;
+    case 0x3:
+        if (((instr >> 28) & 0x3) == 0x0) {
+            pages |= 1 << ((instr >> 8) & 0x3);
+
+            if ((instr & (1 << 13)) != 0)
+                pages |= 1 << (instr & 0x3);
+        }
+        break;
+    }
+
+    return pages;
+}
+
+uint32_t DSP::Simulator::_source(uint32_t source, bool *increment)
+{
+    const int page = source & 0x3;
+
+    if (source >= 8)
+        return 0;
+
+    if (source >= 4)
+        increment[page] = true;
+
+    return _data[page][_ct[page]];
+}
+
+void DSP::Simulator::_destination(uint32_t destination, uint32_t value,
+                                  bool *increment, bool *ct_written)
+{
+    switch (destination) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+        _data[destination][_ct[destination]] = value;
+        increment[destination] = true;
+        break;
+    case DESTINATION_RX:
+        _rx = value;
+        break;
+    case DESTINATION_PL:
+        _p = (int32_t)value;
+        break;
+    case DESTINATION_RA0:
+        _ra0 = value & 0x01FFFFFF;
+        break;
+    case DESTINATION_WA0:
+        _wa0 = value & 0x01FFFFFF;
+        break;
+    case DESTINATION_LOP:
+        _lop = value & 0x0FFF;
+        break;
+    case DESTINATION_TOP:
+        _top = value & 0xFF;
+        break;
+    case DESTINATION_CT0:
+    case DESTINATION_CT0 + 1:
+    case DESTINATION_CT0 + 2:
+    case DESTINATION_CT0 + 3:
+        _ct[destination - DESTINATION_CT0] = value & (DATA_RAM_SIZE - 1);
+        ct_written[destination - DESTINATION_CT0] = true;
+        break;
+    default:
+        break;
+    }
+}
+
+void DSP::Simulator::_operation(uint32_t instr)
+{
+    bool increment[DATA_RAM_PAGES] = { false, false, false, false };
+    bool ct_written[DATA_RAM_PAGES] = { false, false, false, false };
+
+    /* Both the ALU and the multiplier work off of the registers as they
+     * were at the start of the instruction */
+    const uint32_t acl = (uint32_t)_a;
+    const uint32_t pl = (uint32_t)_p;
+
+    int64_t alu;
+    uint64_t result;
+
+    alu = _a;
+
+    switch ((instr >> 26) & 0x0F) {
+    case 0x1: /* AND */
+    case 0x2: /* OR */
+    case 0x3: /* XOR */
+        if (((instr >> 26) & 0x0F) == 0x1)
+            result = acl & pl;
+        else if (((instr >> 26) & 0x0F) == 0x2)
+            result = acl | pl;
+        else
+            result = acl ^ pl;
+
+        _c = false;
+        goto alu_32;
+    case 0x4: /* ADD */
+        result = (uint64_t)acl + pl;
+
+        _c = ((result >> 32) & 0x1) != 0;
+        _v = ((~(acl ^ pl) & (acl ^ (uint32_t)result)) >> 31) != 0;
+        goto alu_32;
+    case 0x5: /* SUB */
+        result = (uint64_t)acl - pl;
+
+        _c = ((result >> 32) & 0x1) != 0;
+        _v = (((acl ^ pl) & (acl ^ (uint32_t)result)) >> 31) != 0;
+        goto alu_32;
+    case 0x6: /* AD2 */
+        result = ((uint64_t)_a & MASK_48) + ((uint64_t)_p & MASK_48);
+
+        _c = ((result >> 48) & 0x1) != 0;
+        _v = (((~(_a ^ _p)) & (_a ^ (int64_t)result)) >> 47 & 0x1) != 0;
+
+        alu = sign_extend(result, 48);
+
+        _z = (alu == 0);
+        _s = (alu < 0);
+        break;
+    case 0x8: /* SR */
+        result = (uint32_t)((int32_t)acl >> 1);
+
+        _c = (acl & 0x1) != 0;
+        goto alu_32;
+    case 0x9: /* RR */
+        result = (acl >> 1) | (acl << 31);
+
+        _c = (acl & 0x1) != 0;
+        goto alu_32;
+    case 0xA: /* SL */
+        result = (uint32_t)(acl << 1);
+
+        _c = (acl >> 31) != 0;
+        goto alu_32;
+    case 0xB: /* RL */
+        result = (acl << 1) | (acl >> 31);
+
+        _c = (acl >> 31) != 0;
+        goto alu_32;
+    case 0xF: /* RL8 */
+        result = (acl << 8) | (acl >> 24);
+
+        _c = ((acl >> 24) & 0x1) != 0;
+        goto alu_32;
+    default: /* NOP */
+        break;
+    alu_32:
+        alu = (_a & ~0xFFFFFFFFLL) | (uint32_t)result;
+
+        _z = ((uint32_t)result == 0);
+        _s = (((uint32_t)result >> 31) != 0);
+        break;
+    }
+
+    const int64_t mul = sign_extend((uint64_t)((int64_t)_rx * _ry), 48);
+
+    /* X-bus */
+    const uint32_t x_source = (instr >> 20) & 0x7;
+
+    if ((instr & (1 << 25)) != 0)
+        _rx = _source(x_source, increment);
+
+    switch ((instr >> 23) & 0x3) {
+    case 0x2:
+        _p = mul;
+        break;
+    case 0x3:
+        _p = (int32_t)_source(x_source, increment);
+        break;
+    }
+
+    /* Y-bus */
+    const uint32_t y_source = (instr >> 14) & 0x7;
+
+    if ((instr & (1 << 19)) != 0)
+        _ry = _source(y_source, increment);
+
+    switch ((instr >> 17) & 0x3) {
+    case 0x1:
+        _a = 0;
+        break;
+    case 0x2:
+        _a = alu;
+        break;
+    case 0x3:
+        _a = (int32_t)_source(y_source, increment);
+        break;
+    }
+
+    /* D1-bus */
+    const uint32_t destination = (instr >> 8) & 0x0F;
+
+    switch ((instr >> 12) & 0x3) {
+    case 0x1:
+        _destination(destination, (uint32_t)(int8_t)(instr & 0xFF),
+                     increment, ct_written);
+        break;
+    case 0x3: {
+        const uint32_t source = instr & 0x0F;
+
+        uint32_t value;
+
+        if (source == SOURCE_ALL)
+            value = (uint32_t)alu;
+        else if (source == SOURCE_ALH)
+            value = (uint32_t)(alu >> 16);
+        else
+            value = _source(source, increment);
+
+        _destination(destination, value, increment, ct_written);
+    } break;
+    }
+
+    for (int page = 0; page < DATA_RAM_PAGES; page++) {
+        if (increment[page] && !ct_written[page])
+            _ct[page] = (_ct[page] + 1) & (DATA_RAM_SIZE - 1);
+    }
+}
+
+void DSP::Simulator::_load_immediate(uint32_t instr)
+{
+    bool increment[DATA_RAM_PAGES] = { false, false, false, false };
+    bool ct_written[DATA_RAM_PAGES] = { false, false, false, false };
+
+    const uint32_t destination = (instr >> 26) & 0x0F;
+
+    uint32_t value;
+
+    if ((instr & (1 << 25)) != 0) {
+        if (!_condition((instr >> 19) & 0x3F))
+            return;
+
+        value = (uint32_t)sign_extend(instr, 19);
+    } else {
+        value = (uint32_t)sign_extend(instr, 25);
+    }
+
+    if (destination == DESTINATION_PC) {
+        _branch = true;
+        _branch_pc = value & 0xFF;
+
+        return;
+    }
+
+    /* TOP can't be loaded with MVI */
+    if (destination == DESTINATION_TOP)
+        return;
+
+    _destination(destination, value, increment, ct_written);
+
+    for (int page = 0; page < DATA_RAM_PAGES; page++) {
+        if (increment[page])
+            _ct[page] = (_ct[page] + 1) & (DATA_RAM_SIZE - 1);
+    }
+}
+
+void DSP::Simulator::_dma(uint32_t instr)
+{
+    bool increment[DATA_RAM_PAGES] = { false, false, false, false };
+
+    const uint32_t add = (instr >> 15) & 0x7;
+    const bool hold = (instr & (1 << 14)) != 0;
+    const bool write = (instr & (1 << 12)) != 0;
+    const uint32_t ram = (instr >> 8) & 0x7;
+
+    uint32_t count;
+
+    if ((instr & (1 << 13)) != 0)
+        count = _source(instr & 0x7, increment) & 0xFF;
+    else
+        count = instr & 0xFF;
+
+    /* The D0 address increment is in units of 16-bit words */
+    const uint32_t address_add = ((1 << add) >> 1) * 2;
+
+    uint32_t address;
+
+    address = (write ? _wa0 : _ra0) << 2;
+
+    const uint32_t cycles = DMA_SETUP_CYCLES +
+        (count * _dma_long_cycles(address));
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (write) {
+            const int page = ram & 0x3;
+
+            _memory[address & 0x07FFFFFC] = _data[page][_ct[page]];
+            _ct[page] = (_ct[page] + 1) & (DATA_RAM_SIZE - 1);
+        } else if (ram == 4) {
+            /* Program RAM */
+            _program[i & (PROGRAM_RAM_SIZE - 1)] = memory(address);
+        } else {
+            const int page = ram & 0x3;
+
+            _data[page][_ct[page]] = memory(address);
+            _ct[page] = (_ct[page] + 1) & (DATA_RAM_SIZE - 1);
+        }
+
+        address += address_add;
+    }
+
+    if (!hold) {
+        if (write)
+            _wa0 = (address >> 2) & 0x01FFFFFF;
+        else
+            _ra0 = (address >> 2) & 0x01FFFFFF;
+    }
+
+    for (int page = 0; page < DATA_RAM_PAGES; page++) {
+        if (increment[page])
+            _ct[page] = (_ct[page] + 1) & (DATA_RAM_SIZE - 1);
+    }
+
+    /* The transfer starts once this instruction completes */
+    _dma_end_cycle = _statistics.cycles + 1 + cycles;
+    _dma_page = (ram <= 3) ? ram : -1;
+
+    _statistics.dma_transfers++;
+    _statistics.dma_longs += count;
+    _statistics.dma_busy_cycles += cycles;
+}
+
+void DSP::Simulator::_jump(uint32_t instr)
+{
+    if ((instr & (1 << 25)) != 0) {
+        const uint32_t condition = (instr >> 19) & 0x3F;
+
+        if (!_condition(condition))
+            return;
+
+        if ((condition & CONDITION_T0) != 0)
+            _statistics.t0_polls++;
+    }
+
+    _branch = true;
+    _branch_pc = instr & 0xFF;
+}
+
+void DSP::Simulator::_loop(uint32_t instr)
+{
+    if ((instr & (1 << 27)) != 0) {
+        /* LPS */
+        _repeat = true;
+
+        return;
+    }
+
+    /* BTM */
+    if (_lop == 0)
+        return;
+
+    _lop = (_lop - 1) & 0x0FFF;
+
+    _branch = true;
+    _branch_pc = _top;
+}
+
+int DSP::Simulator::_dma_long_cycles(uint32_t address)
+{
+    address &= 0x07FFFFFF;
+
+    if (address >= 0x06000000)
+        return DMA_WRAM_H_LONG_CYCLES;
+
+    if (address >= 0x05A00000)
+        return DMA_B_BUS_LONG_CYCLES;
+
+    return DMA_A_BUS_LONG_CYCLES;
+}
+
+void DSP::Simulator::dump_statistics(std::ostream &os) const
+{
+    const Statistics &s = _statistics;
+
+    const uint64_t stall_cycles = s.dma_stall_cycles + s.bank_stall_cycles;
+    const uint64_t poll_cycles = 2 * s.t0_polls;
+
+    os << "cycles:       " << s.cycles << std::endl
+       << "instructions: " << s.instructions << std::endl
+       << "stalls:       " << stall_cycles
+       << " (dma: " << s.dma_stall_cycles
+       << ", bank: " << s.bank_stall_cycles << ")" << std::endl
+       << "t0 polls:     " << s.t0_polls
+       << " (" << poll_cycles << " cycles)" << std::endl
+       << "dma:          " << s.dma_transfers << " transfers, "
+       << s.dma_longs << " longs, "
+       << s.dma_busy_cycles << " busy cycles" << std::endl;
+}
+
+void DSP::Simulator::dump_profile(std::ostream &os) const
+{
+    os << "pc  instr       count    stalls" << std::endl;
+
+    for (int pc = 0; pc < PROGRAM_RAM_SIZE; pc++) {
+        const Profile &profile = _profile[pc];
+
+        if (profile.count == 0)
+            continue;
+
+        os << std::hex << std::uppercase << std::setfill('0')
+           << std::setw(2) << pc << "  "
+           << std::setw(8) << _program[pc]
+           << std::dec << std::setfill(' ') << "  "
+           << std::setw(8) << profile.count << "  "
+           << std::setw(8) << profile.stall_cycles << std::endl;
+    }
+}
+
+bool DSP::Simulator::parse_words(const std::string &filename,
+                                 std::vector<uint32_t> &words)
+{
+    std::ifstream ifs(filename.c_str());
+
+    if (!ifs.is_open()) {
+        std::cerr << filename << ": Unable to open" << std::endl;
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+
+    std::string text;
+    text = ss.str();
+
+    /* Blank out comments (';', '#', and C style) and separators */
+    for (size_t i = 0; i < text.size(); i++) {
+        if ((text[i] == ';') || (text[i] == '#')) {
+            while ((i < text.size()) && (text[i] != '\n'))
+                text[i++] = ' ';
+        } else if (text.compare(i, 2, "/*") == 0) {
+            const size_t end = text.find("*/", i + 2);
+            const size_t last = (end == std::string::npos) ?
+                text.size() : (end + 2);
+
+            for (; i < last; i++) {
+                if (text[i] != '\n')
+                    text[i] = ' ';
+            }
+
+            i--;
+        } else if (text[i] == ',') {
+            text[i] = ' ';
+        }
+    }
+
+    std::istringstream iss(text);
+    std::string token;
+
+    while (iss >> token) {
+        char *end;
+        const unsigned long value = strtoul(token.c_str(), &end, 0);
+
+        if (*end != '\0') {
+            std::cerr << filename << ": Invalid word \"" << token << "\""
+                      << std::endl;
+            return false;
+        }
+
+        words.push_back((uint32_t)value);
+    }
+
+    return true;
+}
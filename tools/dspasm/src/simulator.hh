@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2012-2016 Israel Jacquez
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _SIMULATOR_HH_
+#define _SIMULATOR_HH_
+
+#include <stdint.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DSP {
+    /*
+     * Number of longs in program RAM and in each data RAM page.
+     */
+    const int PROGRAM_RAM_SIZE = 256;
+    const int DATA_RAM_SIZE = 64;
+    const int DATA_RAM_PAGES = 4;
+
+    struct Statistics {
+        uint64_t cycles;
+        uint64_t instructions;
+
+        /* Cycles the program was held back by a DMA instruction issued
+         * while the previous transfer was still in progress */
+        uint64_t dma_stall_cycles;
+        /* Cycles the program was held back by accessing the data RAM
+         * page a transfer was using */
+        uint64_t bank_stall_cycles;
+
+        uint64_t dma_transfers;
+        uint64_t dma_longs;
+        uint64_t dma_busy_cycles;
+
+        /* Taken jumps on T0, that is, cycles spent polling for the end
+         * of a transfer (each costs the jump and its delay slot) */
+        uint64_t t0_polls;
+    };
+
+    struct Profile {
+        uint64_t count;
+        uint64_t stall_cycles;
+    };
+
+    class Simulator {
+    public:
+        Simulator();
+
+        void reset();
+
+        bool load_program(const std::vector<uint32_t>&);
+        bool load_data(int, const std::vector<uint32_t>&);
+        void load_memory(uint32_t, const std::vector<uint32_t>&);
+
+        uint32_t data(int, int) const;
+        uint32_t memory(uint32_t) const;
+
+        /*
+         * Run until END/ENDI, or until the cycle limit is reached.
+         * Returns false in the latter case.
+         */
+        bool run(uint64_t);
+
+        const Statistics& statistics() const;
+        const Profile& profile(int) const;
+        uint32_t program(int) const;
+
+        void dump_statistics(std::ostream&) const;
+        void dump_profile(std::ostream&) const;
+
+        static bool parse_words(const std::string&, std::vector<uint32_t>&);
+
+    private:
+        /* Program RAM and data RAM */
+        uint32_t _program[PROGRAM_RAM_SIZE];
+        uint32_t _data[DATA_RAM_PAGES][DATA_RAM_SIZE];
+
+        /* External memory, as seen from the D0 bus, in longs */
+        std::map<uint32_t, uint32_t> _memory;
+
+        /* Registers */
+        uint8_t _pc;
+        uint8_t _ct[DATA_RAM_PAGES];
+        int32_t _rx;
+        int32_t _ry;
+        int64_t _p;
+        int64_t _a;
+        uint32_t _ra0;
+        uint32_t _wa0;
+        uint16_t _lop;
+        uint8_t _top;
+
+        /* Flags */
+        bool _z;
+        bool _s;
+        bool _c;
+        bool _v;
+        bool _end;
+
+        /* Pending branch (delay slot) */
+        bool _branch;
+        uint8_t _branch_pc;
+
+        /* Repeat the next instruction (LPS) */
+        bool _repeat;
+
+        /* DMA in progress */
+        uint64_t _dma_end_cycle;
+        int _dma_page;
+
+        Statistics _statistics;
+        Profile _profile[PROGRAM_RAM_SIZE];
+
+        bool _t0() const;
+        bool _condition(uint32_t) const;
+        int _pages_accessed(uint32_t) const;
+
+        uint32_t _source(uint32_t, bool *);
+        void _destination(uint32_t, uint32_t, bool *, bool *);
+
+        void _operation(uint32_t);
+        void _load_immediate(uint32_t);
+        void _dma(uint32_t);
+        void _jump(uint32_t);
+        void _loop(uint32_t);
+
+        static int _dma_long_cycles(uint32_t);
+    };
+}
+
+#endif /* !_SIMULATOR_HH_ */
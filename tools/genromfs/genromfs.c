@@ -56,6 +56,12 @@
  * -A N,/name force named file(s) (shell globbing applied against the filenames)
  *       to be aligned on N bytes boundary
  * In both cases, N must be a power of two.
+ * -c CODEC compress all regular files with CODEC (lz, lzb, prs or rle)
+ * -C CODEC,/name compress named file(s) with CODEC, or not at all with "none"
+ * A compressed file holds its data in a bcl container, and has bit 0 of its
+ * spec info set.  Files that don't get smaller are stored as is.
+ * -i add a hash table of the paths of all regular files, as the last file
+ *    of the root directory (see INDEX_NAME)
  */
 
 /*
@@ -92,6 +98,17 @@
 #    include <sys/sysmacros.h>
 #endif
 
+#include "bcl.h"
+
+/* Compressors, from the bcl tool */
+int LZ_Compress(unsigned char *, unsigned char *, unsigned int, unsigned long);
+int RLE_Compress(unsigned char *, unsigned char *, unsigned int);
+uint32_t lzb_compress(void *, void *, uint32_t);
+uint32_t prs_compress(void *, void *, uint32_t);
+
+/* Same as the bcl tool */
+#define LZ_MAX_OFFSET 100000
+
 struct romfh {
     int32_t nextfh;
     int32_t spec;
@@ -110,6 +127,21 @@ struct romfh {
 #define ROMFH_FIF 7
 #define ROMFH_EXEC 8
 
+/* Spec info of compressed regular files */
+#define ROMFH_SPEC_COMPRESSED 1
+
+/* Path index: a header, followed by a power of 2 number of entries (hash,
+ * offset of the file header, offset of the path in the index), followed by
+ * the paths.  Empty entries have an offset of zero.  All in big-endian */
+#define INDEX_NAME ".romfs-index"
+#define INDEX_MAGIC "-rom1ix-"
+#define INDEX_HEADER_SIZE 16
+#define INDEX_ENTRY_SIZE 12
+
+/* 32-bit FNV-1a */
+#define FNV_OFFSET 0x811C9DC5
+#define FNV_PRIME 0x01000193
+
 struct filenode;
 
 struct filehdr {
@@ -138,6 +170,9 @@ struct filenode {
     unsigned int offset;
     unsigned int size;
     unsigned int pad;
+    /* Data to store instead of the file's, or NULL */
+    unsigned char *data;
+    unsigned int spec;
 };
 
 struct aligns {
@@ -151,6 +186,26 @@ struct excludes {
     char pattern[0];
 };
 
+struct compresses {
+    struct compresses *next;
+    int codec;
+    char pattern[0];
+};
+
+struct codec {
+    const char *name;
+    int codec;
+};
+
+static const struct codec codecs[] = {
+    { "none", BCL_CODEC_NONE },
+    { "lz",   BCL_CODEC_LZ   },
+    { "lzb",  BCL_CODEC_LZB  },
+    { "prs",  BCL_CODEC_PRS  },
+    { "rle",  BCL_CODEC_RLE  },
+    { NULL,   0              }
+};
+
 void initlist(struct filehdr *fh, struct filenode *owner)
 {
     fh->head = (struct filenode *)&fh->tail;
@@ -205,6 +260,8 @@ static int atoffs = 0;
 static int align = 16;
 struct aligns *alignlist = NULL;
 struct excludes *excludelist = NULL;
+static int codec = BCL_CODEC_NONE;
+struct compresses *compresslist = NULL;
 int realbase;
 
 /* helper function to match an exclusion or align pattern */
@@ -247,6 +304,37 @@ int findalign(struct filenode *node)
     return i;
 }
 
+int findcodec(struct filenode *node)
+{
+    struct compresses *pc;
+    int i;
+
+    i = codec;
+
+    /* The last matching pattern wins */
+    for (pc = compresslist; pc; pc = pc->next) {
+        if (!nodematch(pc->pattern, node)) {
+            i = pc->codec;
+        }
+    }
+
+    return i;
+}
+
+int parsecodec(const char *name, size_t len)
+{
+    const struct codec *c;
+
+    for (c = codecs; c->name; c++) {
+        if (strlen(c->name) == len && !strncmp(c->name, name, len)) {
+            return c->codec;
+        }
+    }
+
+    fprintf(stderr, "Unknown codec '%.*s'\n", (int)len, name);
+    exit(1);
+}
+
 int romfs_checksum(void *data, int size)
 {
     int32_t sum, *ptr;
@@ -410,17 +498,26 @@ int dumpnode(struct filenode *node, FILE *f)
     else if (S_ISREG(node->modes)) {
         int offset, len, fd, max, avail;
         ri.nextfh |= htonl(ROMFH_REG);
-        dumpri(&ri, node, f);
         offset = 0;
         max = node->size;
-        /* XXX warn about size mismatch */
-        fd = open(node->realname, O_RDONLY
+
+        if (node->data) {
+            ri.spec = htonl(node->spec);
+            dumpri(&ri, node, f);
+            dumpdata(node->data, node->size, f);
+            offset = node->size;
+            fd = -1;
+        } else {
+            dumpri(&ri, node, f);
+            /* XXX warn about size mismatch */
+            fd = open(node->realname, O_RDONLY
 #ifdef O_BINARY
-                  | O_BINARY
+                      | O_BINARY
 #endif
-                 );
+                     );
+        }
 
-        if (fd) {
+        if (fd >= 0) {
             while (offset < max) {
                 avail = max - offset < sizeof(bigbuf) ? max - offset : sizeof(bigbuf);
                 len = read(fd, bigbuf, avail);
@@ -579,6 +676,8 @@ struct filenode *newnode(const char *base, const char *name, int curroffset)
     node->orig_link = NULL;
     node->offset = curroffset;
     node->pad = 0;
+    node->data = NULL;
+    node->spec = 0;
 
     return node;
 }
@@ -611,6 +710,120 @@ struct filenode *findnode(struct filenode *node, dev_t dev, ino_t ino)
     return NULL;
 }
 
+static void putbe32(unsigned char *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = value >> 16;
+    p[2] = value >> 8;
+    p[3] = value;
+}
+
+static uint32_t adler32(const unsigned char *data, unsigned int size)
+{
+    uint32_t a = 1, b = 0;
+    unsigned int i;
+
+    for (i = 0; i < size; i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+/* Compress a regular file ahead of time, as its size is needed to lay out
+ * the image */
+int compressnode(struct filenode *node)
+{
+    unsigned char *in, *out;
+    int c, fd, len;
+    unsigned int offset;
+
+    c = findcodec(node);
+
+    if (c == BCL_CODEC_NONE || node->size == 0) {
+        return 0;
+    }
+
+    in = malloc(node->size);
+    /* Enough for the worst case of every codec */
+    out = malloc(BCL_HEADER_SIZE + (node->size * 2) + 1024);
+
+    if (!in || !out) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    fd = open(node->realname, O_RDONLY
+#ifdef O_BINARY
+              | O_BINARY
+#endif
+             );
+
+    if (fd < 0) {
+        perror(node->realname);
+        return 1;
+    }
+
+    for (offset = 0; offset < node->size; offset += len) {
+        len = read(fd, in + offset, node->size - offset);
+
+        if (len <= 0) {
+            fprintf(stderr, "%s: short read\n", node->realname);
+            close(fd);
+            return 1;
+        }
+    }
+
+    close(fd);
+
+    switch (c) {
+    case BCL_CODEC_LZ:
+        len = LZ_Compress(in, out + BCL_HEADER_SIZE, node->size, LZ_MAX_OFFSET);
+        break;
+
+    case BCL_CODEC_LZB:
+        len = lzb_compress(in, out + BCL_HEADER_SIZE, node->size);
+        break;
+
+    case BCL_CODEC_PRS:
+        len = prs_compress(in, out + BCL_HEADER_SIZE, node->size);
+        break;
+
+    case BCL_CODEC_RLE:
+        len = RLE_Compress(in, out + BCL_HEADER_SIZE, node->size);
+        break;
+
+    default:
+        len = -1;
+        break;
+    }
+
+    /* Store the file as is unless it gets smaller */
+    if (len < 0 || BCL_HEADER_SIZE + (unsigned int)len >= node->size) {
+        free(in);
+        free(out);
+        return 0;
+    }
+
+    putbe32(out, BCL_HEADER_MAGIC);
+    out[4] = c;
+    out[5] = 0;
+    out[6] = 0;
+    out[7] = 0;
+    putbe32(out + 8, len);
+    putbe32(out + 12, node->size);
+    putbe32(out + 16, adler32(in, node->size));
+
+    free(in);
+
+    node->data = out;
+    node->spec = ROMFH_SPEC_COMPRESSED;
+    node->size = BCL_HEADER_SIZE + len;
+
+    return 0;
+}
+
 #define ALIGNUP16(x) (((x)+15)&~15)
 
 int spaceneeded(struct filenode *node)
@@ -634,6 +847,123 @@ int alignnode(struct filenode *node, int curroffset, int extraspace)
     return curroffset;
 }
 
+/* Call fn on every regular file, with its path from the root */
+void walkfiles(struct filenode *node, char *path, size_t len,
+               void (*fn)(struct filenode *, const char *, void *), void *arg)
+{
+    struct filenode *p;
+    size_t n;
+
+    for (p = node->dirlist.head; p->next; p = p->next) {
+        if (p->orig_link) {
+            continue;
+        }
+
+        n = strlen(p->name);
+
+        if (len + n + 2 > ROMFS_MAXFN * 8) {
+            fprintf(stderr, "%s: path too long\n", p->realname);
+            exit(1);
+        }
+
+        memcpy(path + len, p->name, n + 1);
+
+        if (S_ISREG(p->modes)) {
+            fn(p, path, arg);
+        } else if (S_ISDIR(p->modes)) {
+            path[len + n] = '/';
+            walkfiles(p, path, len + n + 1, fn, arg);
+        }
+    }
+}
+
+struct indexinfo {
+    unsigned int count;
+    unsigned int pathsize;
+    unsigned int buckets;
+    unsigned char *data;
+    unsigned int pathoffset;
+};
+
+static void indexcount(struct filenode *node, const char *path, void *arg)
+{
+    struct indexinfo *ii = arg;
+
+    ii->count++;
+    ii->pathsize += strlen(path) + 1;
+}
+
+static void indexadd(struct filenode *node, const char *path, void *arg)
+{
+    struct indexinfo *ii = arg;
+    unsigned char *entry;
+    uint32_t hash;
+    const char *p;
+    unsigned int i;
+
+    hash = FNV_OFFSET;
+
+    for (p = path; *p; p++) {
+        hash = (hash ^ (unsigned char)*p) * FNV_PRIME;
+    }
+
+    /* Linear probing */
+    for (i = hash & (ii->buckets - 1);; i = (i + 1) & (ii->buckets - 1)) {
+        entry = ii->data + INDEX_HEADER_SIZE + (i * INDEX_ENTRY_SIZE);
+
+        if (!entry[4] && !entry[5] && !entry[6] && !entry[7]) {
+            break;
+        }
+    }
+
+    putbe32(entry, hash);
+    putbe32(entry + 4, node->offset);
+    putbe32(entry + 8, ii->pathoffset);
+    strcpy((char *)ii->data + ii->pathoffset, path);
+    ii->pathoffset += strlen(path) + 1;
+}
+
+/* Add the path index as the last file of the root directory, once every
+ * other file has been laid out */
+int addindex(const char *base, struct filenode *root, int curroffset)
+{
+    static char path[ROMFS_MAXFN * 8];
+    struct indexinfo ii;
+    struct filenode *n;
+
+    memset(&ii, 0, sizeof(ii));
+    walkfiles(root, path, 0, indexcount, &ii);
+
+    /* At most half full, so that probing always ends */
+    for (ii.buckets = 1; ii.buckets < ii.count * 2; ii.buckets <<= 1)
+        ;
+
+    n = newnode(base, INDEX_NAME, curroffset);
+    n->modes = S_IFREG | 0444;
+
+    curroffset = alignnode(n, curroffset, spaceneeded(n));
+    n->size = INDEX_HEADER_SIZE + (ii.buckets * INDEX_ENTRY_SIZE) + ii.pathsize;
+    curroffset += spaceneeded(n);
+
+    ii.data = calloc(1, n->size);
+
+    if (!ii.data) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    memcpy(ii.data, INDEX_MAGIC, 8);
+    putbe32(ii.data + 8, ii.buckets);
+    ii.pathoffset = INDEX_HEADER_SIZE + (ii.buckets * INDEX_ENTRY_SIZE);
+    walkfiles(root, path, 0, indexadd, &ii);
+
+    /* Not before, as it would index itself */
+    append(&root->dirlist, n);
+    n->data = ii.data;
+
+    return curroffset;
+}
+
 int processdir(int level, const char *base, const char *dirname, struct stat *sb,
                struct filenode *dir, struct filenode *root, int curroffset)
 {
@@ -796,6 +1126,10 @@ int processdir(int level, const char *base, const char *dirname, struct stat *sb
         if (S_ISREG(sb->st_mode)) {
             curroffset = alignnode(n, curroffset, spaceneeded(n));
             n->size = sb->st_size;
+
+            if (compressnode(n)) {
+                return -1;
+            }
         } else {
             curroffset = alignnode(n, curroffset, 0);
         }
@@ -846,6 +1180,9 @@ void showhelp(const char *argv0)
     printf("  -a ALIGN               Align regular file data to ALIGN bytes\n");
     printf("  -A ALIGN,PATTERN       Align all objects matching pattern to at least ALIGN bytes\n");
     printf("  -x PATTERN             Exclude all objects matching pattern\n");
+    printf("  -c CODEC               Compress regular files with CODEC (none, lz, lzb, prs, rle)\n");
+    printf("  -C CODEC,PATTERN       Compress all files matching pattern with CODEC\n");
+    printf("  -i                     Add an index of the paths of all files\n");
     printf("  -h                     Show this help\n");
     printf("\n");
     printf("Report bugs to chexum@shadow.banki.hu\n");
@@ -858,6 +1195,7 @@ int main(int argc, char *argv[])
     char *outf = NULL;
     char *volname = NULL;
     int verbose = 0;
+    int index = 0;
     char buf[256];
     struct filenode *root;
     struct stat sb;
@@ -866,9 +1204,10 @@ int main(int argc, char *argv[])
     char *p;
     struct aligns *pa, *pa2;
     struct excludes *pe, *pe2;
+    struct compresses *pc, *pc2;
     FILE *f;
 
-    while ((c = getopt(argc, argv, "V:vd:f:ha:A:x:")) != EOF) {
+    while ((c = getopt(argc, argv, "V:vd:f:ha:A:x:c:C:i")) != EOF) {
         switch (c) {
         case 'd':
             dir = optarg;
@@ -946,6 +1285,39 @@ int main(int argc, char *argv[])
 
             break;
 
+        case 'c':
+            codec = parsecodec(optarg, strlen(optarg));
+            break;
+
+        case 'i':
+            index = 1;
+            break;
+
+        case 'C':
+            p = strchr(optarg, ',');
+
+            if (!p || !p[1]) {
+                fprintf(stderr, "-C takes CODEC,PATTERN format of argument\n");
+                exit(1);
+            }
+
+            /* strlen(p+1) + 1 eq strlen(p) */
+            pc = (struct compresses *)malloc(sizeof(*pc) + strlen(p));
+            pc->codec = parsecodec(optarg, p - optarg);
+            pc->next = NULL;
+            strcpy(pc->pattern, p + 1);
+
+            if (!compresslist) {
+                compresslist = pc;
+            } else {
+                for (pc2 = compresslist; pc2->next; pc2 = pc2->next)
+                    ;
+
+                pc2->next = pc;
+            }
+
+            break;
+
         default:
             exit(1);
         }
@@ -983,6 +1355,10 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (index) {
+        lastoff = addindex(dir, root, lastoff);
+    }
+
     if (verbose) {
         shownode(0, root, stderr);
     }
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _TESTS_INTERNAL_H_
+#define _TESTS_INTERNAL_H_
+
+#include <stdlib.h>
+
+/* Host stand-in for the libyaul allocator used by the romdisk driver */
+
+#define _internal_malloc        malloc
+#define _internal_free          free
+
+#endif /* !_TESTS_INTERNAL_H_ */
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#ifndef _TESTS_GENROMFS_SYS_CDEFS_H_
+#define _TESTS_GENROMFS_SYS_CDEFS_H_
+
+/* Adds the definitions the memory block pools expect to the stand-in of the
+ * bcl tool, which is next in the include path */
+
+#include_next <sys/cdefs.h>
+
+#ifndef __aligned
+#define __aligned(x) __attribute__ ((__aligned__(x)))
+#endif /* !__aligned */
+
+#ifndef __CONCAT1
+#define __CONCAT1(x, y) x ## y
+#endif /* !__CONCAT1 */
+
+#endif /* !_TESTS_GENROMFS_SYS_CDEFS_H_ */
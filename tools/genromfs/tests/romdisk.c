@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2016
+ * See LICENSE for details.
+ *
+ * Israel Jacquez <mrkotfw@gmail.com>
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fs/romdisk/romdisk.h>
+
+#include "romdisk.h"
+
+/*
+ * Mounts an image made by genromfs with the romdisk driver, and compares
+ * each of the given files against the file in the directory the image was
+ * made from.
+ *
+ * Each file is read in chunks of various sizes, read again after seeking,
+ * and viewed in place. Compressed files are decoded with the libbcl
+ * decoders.
+ */
+
+#define PROGNAME "romdisk"
+
+/* Number of handles in the pool of the romdisk driver */
+#define HANDLE_COUNT    16
+
+#define TYPE_MASK       0x00000007
+#define TYPE_DIRECTORY  0x00000001
+
+#define INDEX_NAME      ".romfs-index"
+
+static uint8_t *_file_read(const char *, uint32_t *);
+
+static uint32_t _be32_get(const uint8_t *);
+static void _be32_swap(uint8_t *);
+static void _image_swap(uint8_t *);
+static void _directory_swap(uint8_t *, uint32_t);
+
+static int _file_check(void *, const char *, const char *);
+static int _handles_check(void *, const char *);
+
+int
+main(int argc, char *argv[])
+{
+        if (argc < 4) {
+                fprintf(stderr, "usage: %s image.rom directory file...\n",
+                    PROGNAME);
+
+                return 1;
+        }
+
+        uint32_t image_size;
+        uint8_t * const image = _file_read(argv[1], &image_size);
+
+        if (image == NULL) {
+                return 1;
+        }
+
+        /* The driver reads the image natively, as the big-endian target
+         * does */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        _image_swap(image);
+#endif
+
+        romdisk_init();
+        bcl_romdisk_init();
+
+        void * const mnt = romdisk_mount("/", image);
+
+        if (mnt == NULL) {
+                fprintf(stderr, "%s: %s: Unable to mount\n", PROGNAME, argv[1]);
+
+                return 1;
+        }
+
+        int exit_code;
+        exit_code = 0;
+
+        for (int i = 3; i < argc; i++) {
+                if ((_file_check(mnt, argv[2], argv[i])) < 0) {
+                        fprintf(stderr, "%s: %s: %s: Mismatch\n", PROGNAME,
+                            argv[1], argv[i]);
+
+                        exit_code = 1;
+                }
+        }
+
+        if ((_handles_check(mnt, argv[3])) < 0) {
+                fprintf(stderr, "%s: %s: Handles mismatch\n", PROGNAME, argv[1]);
+
+                exit_code = 1;
+        }
+
+        free(image);
+
+        return exit_code;
+}
+
+static uint8_t *
+_file_read(const char *filepath, uint32_t *size)
+{
+        FILE *fp;
+
+        if ((fp = fopen(filepath, "rb")) == NULL) {
+                fprintf(stderr, "%s: %s: Unable to open\n", PROGNAME, filepath);
+
+                return NULL;
+        }
+
+        (void)fseek(fp, 0, SEEK_END);
+        *size = ftell(fp);
+        (void)fseek(fp, 0, SEEK_SET);
+
+        /* Never allocate zero bytes */
+        uint8_t * const buffer = malloc(*size + 1);
+
+        if ((fread(buffer, 1, *size, fp)) != *size) {
+                fprintf(stderr, "%s: %s: Unable to read\n", PROGNAME, filepath);
+
+                free(buffer);
+                (void)fclose(fp);
+
+                return NULL;
+        }
+
+        (void)fclose(fp);
+
+        return buffer;
+}
+
+static uint32_t
+_be32_get(const uint8_t *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+               ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void
+_be32_swap(uint8_t *p)
+{
+        const uint32_t value = _be32_get(p);
+
+        (void)memcpy(p, &value, sizeof(value));
+}
+
+/* Swap the fields of the headers, and of the path index, in place. The data
+ * of the files is left as is */
+static void
+_image_swap(uint8_t *image)
+{
+        /* Full size, and checksum */
+        _be32_swap(&image[8]);
+        _be32_swap(&image[12]);
+
+        const size_t volume_name_len = strlen((const char *)&image[16]);
+
+        _directory_swap(image, 16 + ((volume_name_len + 16) & ~15));
+}
+
+static void
+_directory_swap(uint8_t *image, uint32_t offset)
+{
+        while (offset != 0) {
+                uint8_t * const hdr = &image[offset];
+
+                const uint32_t next_header = _be32_get(&hdr[0]);
+                const uint32_t spec_info = _be32_get(&hdr[4]);
+
+                for (uint32_t i = 0; i < 16; i += 4) {
+                        _be32_swap(&hdr[i]);
+                }
+
+                const char * const name = (const char *)&hdr[16];
+                const size_t name_len = strlen(name);
+
+                if ((next_header & TYPE_MASK) == TYPE_DIRECTORY) {
+                        if ((strcmp(name, ".") != 0) && (strcmp(name, "..") != 0)) {
+                                _directory_swap(image, spec_info);
+                        }
+                } else if (strcmp(name, INDEX_NAME) == 0) {
+                        /* Magic, count, reserved, then the entries */
+                        uint8_t * const index = &hdr[16 + ((name_len + 16) & ~15)];
+
+                        const uint32_t count = _be32_get(&index[8]);
+
+                        _be32_swap(&index[8]);
+
+                        for (uint32_t i = 0; i < (count * 3); i++) {
+                                _be32_swap(&index[16 + (i * 4)]);
+                        }
+                }
+
+                offset = next_header & ~15;
+        }
+}
+
+static int
+_file_check(void *mnt, const char *directory, const char *path)
+{
+        char filepath[1024];
+
+        (void)snprintf(filepath, sizeof(filepath), "%s/%s", directory, path);
+
+        uint32_t expected_size;
+        uint8_t * const expected = _file_read(filepath, &expected_size);
+
+        if (expected == NULL) {
+                return -1;
+        }
+
+        /* Never allocate zero bytes */
+        uint8_t * const buffer = malloc(expected_size + 1);
+
+        int ret;
+        ret = -1;
+
+        void *fh;
+
+        if ((fh = romdisk_open(mnt, path)) == NULL) {
+                goto exit;
+        }
+
+        if ((romdisk_total(fh)) != expected_size) {
+                goto exit;
+        }
+
+        /* Read in order, in chunks of various sizes */
+        uint32_t read_size;
+        read_size = 0;
+
+        for (uint32_t i = 1; ; i++) {
+                const ssize_t amount = romdisk_read(fh, &buffer[read_size],
+                    ((i * 7919) % 20000) + 1);
+
+                if (amount < 0) {
+                        goto exit;
+                }
+
+                if (amount == 0) {
+                        break;
+                }
+
+                read_size += amount;
+        }
+
+        if ((read_size != expected_size) ||
+            ((memcmp(buffer, expected, expected_size)) != 0)) {
+                goto exit;
+        }
+
+        /* Seek back, and read the rest */
+        const uint32_t offset = expected_size / 3;
+
+        if ((romdisk_seek(fh, offset, SEEK_SET)) != (off_t)offset) {
+                goto exit;
+        }
+
+        if ((romdisk_read(fh, buffer, expected_size)) !=
+            (ssize_t)(expected_size - offset)) {
+                goto exit;
+        }
+
+        if ((memcmp(buffer, &expected[offset], expected_size - offset)) != 0) {
+                goto exit;
+        }
+
+        /* Views are bounded to the file */
+        romdisk_view_t view;
+
+        if ((romdisk_view(fh, 0, expected_size + 1, &view)) < 0) {
+                goto exit;
+        }
+
+        if ((view.size != expected_size) ||
+            ((memcmp(view.data, expected, expected_size)) != 0)) {
+                goto exit;
+        }
+
+        if ((romdisk_view(fh, offset, 5, &view)) < 0) {
+                goto exit;
+        }
+
+        const uint32_t view_size =
+            ((expected_size - offset) < 5) ? (expected_size - offset) : 5;
+
+        if ((view.size != view_size) ||
+            ((memcmp(view.data, &expected[offset], view_size)) != 0)) {
+                goto exit;
+        }
+
+        if ((romdisk_view(fh, expected_size + 1, 1, &view)) == 0) {
+                goto exit;
+        }
+
+        romdisk_close(fh);
+
+        /* Leading and repeated slashes are ignored */
+        (void)snprintf(filepath, sizeof(filepath), "//%s", path);
+
+        if ((fh = romdisk_open(mnt, filepath)) == NULL) {
+                goto exit;
+        }
+
+        ret = 0;
+
+exit:
+        romdisk_close(fh);
+
+        free(buffer);
+        free(expected);
+
+        return ret;
+}
+
+static int
+_handles_check(void *mnt, const char *path)
+{
+        void *fhs[HANDLE_COUNT + 1];
+
+        int ret;
+        ret = 0;
+
+        if ((romdisk_open(mnt, "missing")) != NULL) {
+                ret = -1;
+        }
+
+        /* Directories are not files */
+        if ((romdisk_open(mnt, "sub")) != NULL) {
+                ret = -1;
+        }
+
+        for (uint32_t i = 0; i <= HANDLE_COUNT; i++) {
+                fhs[i] = romdisk_open(mnt, path);
+
+                if ((fhs[i] == NULL) != (i == HANDLE_COUNT)) {
+                        ret = -1;
+                }
+        }
+
+        for (uint32_t i = 0; i < HANDLE_COUNT; i++) {
+                romdisk_close(fhs[i]);
+        }
+
+        /* All of the handles are free again */
+        for (uint32_t i = 0; i < HANDLE_COUNT; i++) {
+                if ((fhs[i] = romdisk_open(mnt, path)) == NULL) {
+                        ret = -1;
+                }
+        }
+
+        for (uint32_t i = 0; i < HANDLE_COUNT; i++) {
+                romdisk_close(fhs[i]);
+        }
+
+        return ret;
+}